@@ -0,0 +1,892 @@
+// Microbenchmarks of the parts of the renderer that run per pixel or per ray,
+//  each timed over batches of random inputs.
+// USAGE: ./bench [name]
+//  runs the benchmarks whose names contain `name`, or all of them.
+// Prints the time per operation (mean and standard deviation over the runs)
+//  and, where the kernel lets this process count them,
+//  CPU cycles and cache misses per operation.
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "glm/glm.hpp"
+
+#include "AABB.hpp"
+#include "BVH.hpp"
+#include "ColorBlocks.hpp"
+#include "Heights.hpp"
+#include "Orthographic.hpp"
+#include "Perspective.hpp"
+#include "Procedural.hpp"
+#include "Raster.hpp"
+#include "Ray.hpp"
+#include "Spherical.hpp"
+#include "Terrain.hpp"
+
+// Timed runs of each benchmark, after one to warm up
+#define BENCH_RUNS 10
+// Inputs generated for the benchmarks that cycle through them.
+// A power of 2 so that they are picked with a mask.
+#define BENCH_INPUTS 4096
+
+// Results are added to this so that the work is not optimized away
+volatile double sink = 0.0;
+
+//////////////////////////////////////////////////////////////////////////////
+// Helpers
+//////////////////////////////////////////////////////////////////////////////
+
+unsigned int random_state = 12345;
+
+// Uniform in [0, 1)
+static double Random() {
+	// xorshift32
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+
+	return random_state / 4294967296.0;
+}
+
+static double RandomIn(double low, double high) {
+	return low + (high - low) * Random();
+}
+
+static glm::dvec3 RandomDirection() {
+	const double z = RandomIn(-1.0, 1.0);
+	const double angle = RandomIn(0.0, 2.0 * M_PI);
+	const double r = std::sqrt(1.0 - z * z);
+
+	return glm::dvec3(r * std::cos(angle), r * std::sin(angle), z);
+}
+
+// Hardware counters of this thread, if the kernel allows them
+class Counters {
+public:
+	Counters() {
+		cycles = Open(PERF_COUNT_HW_CPU_CYCLES);
+		misses = Open(PERF_COUNT_HW_CACHE_MISSES);
+
+		if (cycles < 0 || misses < 0) {
+			error = std::strerror(errno);
+		}
+	}
+
+	~Counters() {
+		if (cycles >= 0) close(cycles);
+		if (misses >= 0) close(misses);
+	}
+
+	bool Available() const {
+		return cycles >= 0 && misses >= 0;
+	}
+
+	// Why they are not available
+	const std::string &Error() const {
+		return error;
+	}
+
+	void Start() {
+		if (!Available()) {
+			return;
+		}
+
+		ioctl(cycles, PERF_EVENT_IOC_RESET, 0);
+		ioctl(misses, PERF_EVENT_IOC_RESET, 0);
+		ioctl(cycles, PERF_EVENT_IOC_ENABLE, 0);
+		ioctl(misses, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	// Add the counts since Start to `*cycle_count` and `*miss_count`
+	void Stop(long long *cycle_count, long long *miss_count) {
+		if (!Available()) {
+			return;
+		}
+
+		ioctl(cycles, PERF_EVENT_IOC_DISABLE, 0);
+		ioctl(misses, PERF_EVENT_IOC_DISABLE, 0);
+
+		long long value;
+		if (read(cycles, &value, sizeof(value)) == sizeof(value)) {
+			*cycle_count += value;
+		}
+		if (read(misses, &value, sizeof(value)) == sizeof(value)) {
+			*miss_count += value;
+		}
+	}
+
+private:
+	static int Open(unsigned long long config) {
+		struct perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+
+	int cycles;
+	int misses;
+	std::string error;
+};
+
+// Something timed over many operations
+class Benchmark {
+public:
+	virtual ~Benchmark() {}
+
+	virtual std::string Name() const = 0;
+
+	// Operations that Run does
+	virtual int Ops() const = 0;
+
+	// Make the inputs. Not timed.
+	virtual void Setup() {}
+
+	// Do Ops() operations, returning something of their results
+	virtual double Run() = 0;
+
+	// What else to print after running, such as steps per ray
+	virtual std::string Note() const {
+		return "";
+	}
+};
+
+// Time `bench` and print a line of its results
+static void Measure(Benchmark *bench, Counters *counters) {
+	bench->Setup();
+	sink = sink + bench->Run();
+
+	double ns[BENCH_RUNS];
+	long long cycles = 0;
+	long long misses = 0;
+
+	for (int r = 0; r < BENCH_RUNS; ++r) {
+		counters->Start();
+		const double start = omp_get_wtime();
+
+		sink = sink + bench->Run();
+
+		const double seconds = omp_get_wtime() - start;
+		counters->Stop(&cycles, &misses);
+
+		ns[r] = seconds * 1e9 / bench->Ops();
+	}
+
+	double mean = 0.0;
+	for (int r = 0; r < BENCH_RUNS; ++r) {
+		mean += ns[r];
+	}
+	mean /= BENCH_RUNS;
+
+	double variance = 0.0;
+	for (int r = 0; r < BENCH_RUNS; ++r) {
+		variance += (ns[r] - mean) * (ns[r] - mean);
+	}
+	variance /= BENCH_RUNS - 1;
+
+	const double ops = (double)bench->Ops() * BENCH_RUNS;
+
+	std::cout
+		<< std::left << std::setw(28) << bench->Name() << std::right
+		<< std::fixed << std::setprecision(2)
+		<< std::setw(12) << mean
+		<< std::setw(10) << std::sqrt(variance);
+
+	if (counters->Available()) {
+		std::cout
+			<< std::setw(12) << (double)cycles / ops
+			<< std::setw(12) << std::setprecision(4) << (double)misses / ops;
+	}
+	else {
+		std::cout << std::setw(12) << "-" << std::setw(12) << "-";
+	}
+
+	std::cout << "  " << bench->Note() << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Ray-box tests
+//////////////////////////////////////////////////////////////////////////////
+
+// Random rays and boxes in a cube of side 100
+class BoxBench: public Benchmark {
+public:
+	void Setup() {
+		rays.resize(BENCH_INPUTS);
+		c0s.resize(BENCH_INPUTS);
+		c1s.resize(BENCH_INPUTS);
+
+		for (int i = 0; i < BENCH_INPUTS; ++i) {
+			rays[i].pos = glm::dvec3(
+				RandomIn(0.0, 100.0), RandomIn(0.0, 100.0),
+				RandomIn(0.0, 100.0));
+			rays[i].dir = RandomDirection();
+
+			const glm::dvec3 corner(
+				RandomIn(0.0, 100.0), RandomIn(0.0, 100.0),
+				RandomIn(0.0, 100.0));
+			const glm::dvec3 size(
+				RandomIn(1.0, 30.0), RandomIn(1.0, 30.0), RandomIn(1.0, 30.0));
+
+			c0s[i] = corner;
+			c1s[i] = corner + size;
+		}
+	}
+
+	int Ops() const {
+		return 1 << 20;
+	}
+
+protected:
+	std::vector<struct Ray> rays;
+	std::vector<glm::dvec3> c0s;
+	std::vector<glm::dvec3> c1s;
+};
+
+class DistanceBench: public BoxBench {
+public:
+	std::string Name() const {
+		return "aabb_distance";
+	}
+
+	double Run() {
+		double sum = 0.0;
+		int hits = 0;
+
+		for (int i = 0; i < Ops(); ++i) {
+			// Each pass over the rays meets the next boxes
+			const int r = i & (BENCH_INPUTS - 1);
+			const int b = (i + (i / BENCH_INPUTS)) & (BENCH_INPUTS - 1);
+			const double d = distance(rays[r], c0s[b], c1s[b]);
+
+			if (d != std::numeric_limits<double>::infinity()) {
+				sum += d;
+				hits += 1;
+			}
+		}
+
+		hit_rate = (double)hits / Ops();
+
+		return sum;
+	}
+
+	std::string Note() const {
+		std::stringstream ss;
+		ss << std::setprecision(3) << hit_rate * 100.0 << "% hit";
+		return ss.str();
+	}
+
+private:
+	double hit_rate;
+};
+
+class IntersectionBench: public BoxBench {
+public:
+	std::string Name() const {
+		return "aabb_intersection";
+	}
+
+	double Run() {
+		double sum = 0.0;
+
+		for (int i = 0; i < Ops(); ++i) {
+			const int r = i & (BENCH_INPUTS - 1);
+			const int b = (i + (i / BENCH_INPUTS)) & (BENCH_INPUTS - 1);
+			glm::dvec3 point;
+
+			if (intersection(&point, rays[r], c0s[b], c1s[b])) {
+				sum += point.x;
+			}
+		}
+
+		return sum;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Ray generation
+//////////////////////////////////////////////////////////////////////////////
+
+// GetRay of an image plane at random points of the screen
+class RayBench: public Benchmark {
+public:
+	RayBench(const std::string &n, ImagePlane *p): name(n), plane(p) {}
+
+	~RayBench() {
+		delete plane;
+	}
+
+	std::string Name() const {
+		return name;
+	}
+
+	int Ops() const {
+		return 1 << 20;
+	}
+
+	void Setup() {
+		ws.resize(BENCH_INPUTS);
+		hs.resize(BENCH_INPUTS);
+
+		for (int i = 0; i < BENCH_INPUTS; ++i) {
+			ws[i] = Random();
+			hs[i] = Random();
+		}
+	}
+
+	double Run() {
+		double sum = 0.0;
+
+		for (int i = 0; i < Ops(); ++i) {
+			const int k = i & (BENCH_INPUTS - 1);
+			const struct Ray ray = plane->GetRay(ws[k], hs[k]);
+
+			sum += ray.dir.x + ray.pos.y;
+		}
+
+		return sum;
+	}
+
+private:
+	std::string name;
+	ImagePlane *plane;
+	std::vector<double> ws;
+	std::vector<double> hs;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Heightmap conversion
+//////////////////////////////////////////////////////////////////////////////
+
+// ConvertHeights of a 2048x2048 image on one thread, per pixel
+class HeightsBench: public Benchmark {
+public:
+	std::string Name() const {
+		return "heights_convert";
+	}
+
+	int Ops() const {
+		return 2048 * 2048;
+	}
+
+	void Setup() {
+		rgb.resize((size_t)Ops() * 3);
+
+		for (size_t i = 0; i < rgb.size(); ++i) {
+			rgb[i] = (unsigned char)(Random() * 256.0);
+		}
+
+		heights.resize(Ops());
+
+		params.lum_r = 0.299;
+		params.lum_g = 0.587;
+		params.lum_b = 0.114;
+		params.min_height = 0.0;
+		params.max_height = 10.0;
+	}
+
+	double Run() {
+		ConvertHeights(&rgb[0], Ops(), params, &heights[0], false);
+		return heights[Ops() / 2];
+	}
+
+private:
+	std::vector<unsigned char> rgb;
+	std::vector<double> heights;
+	struct HeightParams params;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Marching
+//////////////////////////////////////////////////////////////////////////////
+
+#define MARCH_SIZE 1024
+#define MARCH_MAX_HEIGHT 100.0
+
+enum TerrainKind {
+	// Smooth fractal hills and flat lakes
+	TERRAIN_HILLS,
+	// A random height for each cell
+	TERRAIN_NOISE,
+	// The same height everywhere
+	TERRAIN_FLAT
+};
+
+static const char *TerrainName(TerrainKind kind) {
+	if (kind == TERRAIN_HILLS) return "hills";
+	if (kind == TERRAIN_NOISE) return "noise";
+	return "flat";
+}
+
+// March random rays from above a MARCH_SIZE x MARCH_SIZE terrain
+//  of grid width 1 down into it, per ray
+class MarchBench: public Benchmark {
+public:
+	MarchBench(TerrainKind k, const struct MarchParams &m): kind(k), march(m) {}
+
+	std::string Name() const {
+		std::stringstream ss;
+		ss << "march_" << TerrainName(kind) << "_";
+
+		if (march.adaptive) {
+			ss << "adaptive";
+		}
+		else {
+			ss << march.step_dist;
+		}
+
+		return ss.str();
+	}
+
+	int Ops() const {
+		return 2000;
+	}
+
+	void Setup() {
+		heights.resize((size_t)MARCH_SIZE * MARCH_SIZE);
+
+		if (kind == TERRAIN_HILLS) {
+			struct ProceduralParams params;
+			params.seed = 1;
+			params.octaves = 6;
+			params.feature_size = 200.0;
+			params.min_height = 0.0;
+			params.max_height = MARCH_MAX_HEIGHT;
+			params.tile_cells = MARCH_SIZE;
+			params.grid_width = 1.0;
+
+			struct ProceduralTile tile;
+			GenerateTile(params, 0, 0, MARCH_SIZE, &tile);
+			heights.swap(tile.heights);
+		}
+		else {
+			for (size_t i = 0; i < heights.size(); ++i) {
+				heights[i] = kind == TERRAIN_NOISE
+					? Random() * MARCH_MAX_HEIGHT
+					: MARCH_MAX_HEIGHT * 0.5;
+			}
+		}
+
+		mip.Build(&heights[0], MARCH_SIZE, MARCH_SIZE);
+
+		terrain.heights = &heights[0];
+		terrain.colors = NULL;
+		terrain.color_blocks = NULL;
+		terrain.mip = &mip;
+		terrain.light = NULL;
+		terrain.width = MARCH_SIZE;
+		terrain.height = MARCH_SIZE;
+		terrain.color_width = MARCH_SIZE;
+		terrain.color_height = MARCH_SIZE;
+		terrain.grid_width = 1.0;
+		SetTerrainBounds(&terrain, 0.0, 0.0, 0.0, MARCH_MAX_HEIGHT);
+
+		// From above the middle of the terrain,
+		//  looking down at 10 to 60 degrees below the horizon
+		rays.resize(Ops());
+
+		for (int i = 0; i < Ops(); ++i) {
+			const double hang = RandomIn(0.0, 2.0 * M_PI);
+			const double below = RandomIn(10.0, 60.0) * M_PI / 180.0;
+
+			rays[i].pos = glm::dvec3(
+				RandomIn(0.25, 0.75) * MARCH_SIZE,
+				-RandomIn(0.25, 0.75) * MARCH_SIZE,
+				MARCH_MAX_HEIGHT * 1.5);
+			rays[i].dir = glm::dvec3(
+				std::cos(below) * std::cos(hang),
+				std::cos(below) * std::sin(hang),
+				-std::sin(below));
+		}
+	}
+
+	double Run() {
+		double sum = 0.0;
+		long long skipped = 0;
+		long long steps = 0;
+		int hits = 0;
+
+		for (int i = 0; i < Ops(); ++i) {
+			const double entry = distance(rays[i], terrain.c0, terrain.c1);
+
+			if (entry == std::numeric_limits<double>::infinity()) {
+				continue;
+			}
+
+			struct TerrainHit hit;
+			if (MarchTerrain(terrain, rays[i], entry, entry, march,
+				std::numeric_limits<double>::infinity(), &hit,
+				&skipped, &steps))
+			{
+				sum += hit.t;
+				hits += 1;
+			}
+		}
+
+		steps_per_ray = (double)steps / Ops();
+		hit_rate = (double)hits / Ops();
+
+		return sum;
+	}
+
+	std::string Note() const {
+		std::stringstream ss;
+		ss
+			<< std::setprecision(4) << steps_per_ray << " steps/ray, "
+			<< std::setprecision(3) << hit_rate * 100.0 << "% hit";
+		return ss.str();
+	}
+
+private:
+	TerrainKind kind;
+	struct MarchParams march;
+	std::vector<double> heights;
+	MaxMip mip;
+	struct Terrain terrain;
+	std::vector<struct Ray> rays;
+	double steps_per_ray;
+	double hit_rate;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Colormap fetches
+//////////////////////////////////////////////////////////////////////////////
+
+#define COLOR_SIZE 4096
+
+// TerrainColor at random points of a COLOR_SIZE x COLOR_SIZE colormap,
+//  kept as RGBA or compressed, to weigh decoding against memory traffic
+class ColorBench: public Benchmark {
+public:
+	ColorBench(bool c, bool b): compressed(c), bilinear(b) {}
+
+	std::string Name() const {
+		return std::string("color_") + (compressed ? "blocks" : "rgba")
+			+ (bilinear ? "_bilinear" : "_nearest");
+	}
+
+	int Ops() const {
+		return 1 << 20;
+	}
+
+	void Setup() {
+		// Smooth gradients with some noise, like a photo
+		rgba.resize((size_t)COLOR_SIZE * COLOR_SIZE * 4);
+
+		for (int y = 0; y < COLOR_SIZE; ++y) {
+			for (int x = 0; x < COLOR_SIZE; ++x) {
+				unsigned char *const texel =
+					&rgba[((size_t)y * COLOR_SIZE + x) * 4];
+				const int grain = (int)(Random() * 16.0);
+
+				texel[0] = (unsigned char)((x >> 4) + grain);
+				texel[1] = (unsigned char)((y >> 4) + grain);
+				texel[2] = (unsigned char)(((x + y) >> 5) + grain);
+				texel[3] = 255;
+			}
+		}
+
+		if (compressed) {
+			blocks.Build(&rgba[0], COLOR_SIZE, COLOR_SIZE);
+			std::vector<unsigned char>().swap(rgba);
+		}
+
+		terrain.heights = NULL;
+		terrain.colors = compressed ? NULL : &rgba[0];
+		terrain.color_blocks = &blocks;
+		terrain.mip = NULL;
+		terrain.light = NULL;
+		terrain.width = COLOR_SIZE;
+		terrain.height = COLOR_SIZE;
+		terrain.color_width = COLOR_SIZE;
+		terrain.color_height = COLOR_SIZE;
+		terrain.grid_width = 1.0;
+		SetTerrainBounds(&terrain, 0.0, 0.0, 0.0, 1.0);
+
+		us.resize(BENCH_INPUTS);
+		vs.resize(BENCH_INPUTS);
+
+		for (int i = 0; i < BENCH_INPUTS; ++i) {
+			us[i] = Random() * COLOR_SIZE;
+			vs[i] = Random() * COLOR_SIZE;
+		}
+	}
+
+	double Run() {
+		double sum = 0.0;
+
+		for (int i = 0; i < Ops(); ++i) {
+			// Move the points along so that they do not stay in the cache
+			const int k = i & (BENCH_INPUTS - 1);
+			const double shift = (i >> 12) * 37.0;
+			const double u = std::fmod(us[k] + shift, (double)COLOR_SIZE);
+			const double v = std::fmod(vs[k] + shift * 3.0, (double)COLOR_SIZE);
+
+			unsigned char color[4];
+			TerrainColor(terrain, u, v, bilinear, color);
+
+			sum += color[0];
+		}
+
+		return sum;
+	}
+
+	std::string Note() const {
+		std::stringstream ss;
+		ss
+			<< (compressed ? blocks.Bytes() : rgba.size()) / (1024 * 1024)
+			<< " MiB of colors";
+		return ss.str();
+	}
+
+private:
+	bool compressed;
+	bool bilinear;
+	std::vector<unsigned char> rgba;
+	ColorBlocks blocks;
+	struct Terrain terrain;
+	std::vector<double> us;
+	std::vector<double> vs;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Whole views
+//////////////////////////////////////////////////////////////////////////////
+
+#define VIEW_WIDTH 256
+#define VIEW_HEIGHT 144
+
+// Find what every pixel of a perspective view of the hills sees,
+//  by rasterizing them or by marching each pixel's ray,
+//  with the camera `distance` from the terrain's center, per pixel.
+// Rasterizing draws fewer triangles as the terrain gets farther
+//  while marching takes about as many steps per ray,
+//  so which is faster depends on the distance.
+class ViewBench: public Benchmark {
+public:
+	// The camera is a placeholder until Setup
+	ViewBench(bool r, double d):
+		raster(r), distance(d),
+		camera(glm::dvec3(0.0), glm::dvec3(1.0, 0.0, 0.0),
+			glm::dvec3(0.0, 0.0, 1.0), 1.0, 1.0)
+	{}
+
+	std::string Name() const {
+		std::stringstream ss;
+		ss << "view_" << (raster ? "raster" : "march") << "_" << distance;
+		return ss.str();
+	}
+
+	int Ops() const {
+		return VIEW_WIDTH * VIEW_HEIGHT;
+	}
+
+	void Setup() {
+		struct ProceduralParams params;
+		params.seed = 1;
+		params.octaves = 6;
+		params.feature_size = 200.0;
+		params.min_height = 0.0;
+		params.max_height = MARCH_MAX_HEIGHT;
+		params.tile_cells = MARCH_SIZE;
+		params.grid_width = 1.0;
+
+		GenerateTile(params, 0, 0, MARCH_SIZE, &tile);
+
+		terrains.resize(1);
+		struct Terrain &terrain = terrains[0];
+		terrain.heights = &tile.heights[0];
+		terrain.colors = NULL;
+		terrain.color_blocks = NULL;
+		terrain.mip = &tile.mip;
+		terrain.light = &tile.light;
+		terrain.width = MARCH_SIZE;
+		terrain.height = MARCH_SIZE;
+		terrain.color_width = MARCH_SIZE;
+		terrain.color_height = MARCH_SIZE;
+		terrain.grid_width = 1.0;
+		SetTerrainBounds(&terrain, 0.0, 0.0, 0.0, MARCH_MAX_HEIGHT);
+		bvh.Build(terrains);
+
+		// Looking down at the center at 30 degrees from above the hills
+		const glm::dvec3 center(MARCH_SIZE * 0.5, -MARCH_SIZE * 0.5, 0.0);
+		const glm::dvec3 pos = center + distance * glm::dvec3(
+			-std::cos(M_PI / 6.0), 0.0, std::sin(M_PI / 6.0))
+			+ glm::dvec3(0.0, 0.0, MARCH_MAX_HEIGHT);
+		const glm::dvec3 look = glm::normalize(center - pos);
+		const glm::dvec3 right =
+			glm::normalize(glm::cross(look, glm::dvec3(0.0, 0.0, 1.0)));
+
+		camera = Perspective(pos, look, glm::cross(right, look),
+			M_PI / 2.0, (double)VIEW_WIDTH / VIEW_HEIGHT);
+
+		march.step_dist = 1.0;
+		march.adaptive = false;
+		march.step_min = 0.5;
+		march.step_growth = 0.005;
+		march.refine_iters = 5;
+
+		hit_terrain.resize(Ops());
+		hit_cell.resize(Ops());
+	}
+
+	double Run() {
+		if (raster) {
+			RasterTerrains(camera, terrains, 1.0, VIEW_WIDTH, VIEW_HEIGHT,
+				0, VIEW_HEIGHT, &hit_terrain[0], &hit_cell[0], &buffers);
+		}
+		else {
+			for (int h = 0; h < VIEW_HEIGHT; ++h) {
+				for (int w = 0; w < VIEW_WIDTH; ++w) {
+					const struct Ray ray = camera.GetRay(
+						(double)w / (VIEW_WIDTH - 1),
+						(double)h / (VIEW_HEIGHT - 1));
+					const int i = w + h * VIEW_WIDTH;
+
+					struct TerrainHit hit;
+					hit_terrain[i] = bvh.Trace(ray, march, &hit);
+					hit_cell[i] = hit.gridx + hit.gridy * MARCH_SIZE;
+				}
+			}
+		}
+
+		double sum = 0.0;
+		int hits = 0;
+
+		for (int i = 0; i < Ops(); ++i) {
+			if (hit_terrain[i] >= 0) {
+				sum += hit_cell[i];
+				hits += 1;
+			}
+		}
+
+		hit_rate = (double)hits / Ops();
+
+		return sum;
+	}
+
+	std::string Note() const {
+		std::stringstream ss;
+		ss << std::setprecision(3) << hit_rate * 100.0 << "% of pixels hit";
+		return ss.str();
+	}
+
+private:
+	bool raster;
+	double distance;
+	struct ProceduralTile tile;
+	std::vector<struct Terrain> terrains;
+	BVH bvh;
+	struct MarchParams march;
+	Perspective camera;
+	struct RasterBuffers buffers;
+	std::vector<int> hit_terrain;
+	std::vector<int> hit_cell;
+	double hit_rate;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// main
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+	const std::string filter = argc > 1 ? argv[1] : "";
+
+	// Kernels are timed on one thread
+	omp_set_num_threads(1);
+
+	std::vector<Benchmark*> benches;
+	benches.push_back(new DistanceBench());
+	benches.push_back(new IntersectionBench());
+
+	const glm::dvec3 cam_pos(0.0, 0.0, 10.0);
+	const glm::dvec3 look(0.6, 0.6, -0.5291502622129181);
+	const glm::dvec3 up(0.0, 0.0, 1.0);
+
+	benches.push_back(new RayBench("ray_perspective",
+		new Perspective(cam_pos, look, up, M_PI / 2.0, 16.0 / 9.0)));
+	benches.push_back(new RayBench("ray_spherical",
+		new Spherical(cam_pos, M_PI / 4.0, M_PI * 0.6, M_PI / 2.0,
+			16.0 / 9.0)));
+	benches.push_back(new RayBench("ray_orthographic",
+		new Orthographic(cam_pos, glm::vec3(look), glm::vec3(up), 0.05,
+			1920, 1080)));
+
+	benches.push_back(new HeightsBench());
+
+	const TerrainKind kinds[3] = {TERRAIN_HILLS, TERRAIN_NOISE, TERRAIN_FLAT};
+	const double step_dists[3] = {0.25, 1.0, 4.0};
+
+	for (int k = 0; k < 3; ++k) {
+		struct MarchParams march;
+		march.adaptive = false;
+		march.step_min = 0.5;
+		march.step_growth = 0.005;
+		march.refine_iters = 5;
+
+		for (int s = 0; s < 3; ++s) {
+			march.step_dist = step_dists[s];
+			benches.push_back(new MarchBench(kinds[k], march));
+		}
+
+		march.step_dist = 1.0;
+		march.adaptive = true;
+		benches.push_back(new MarchBench(kinds[k], march));
+	}
+
+	for (int c = 0; c < 2; ++c) {
+		benches.push_back(new ColorBench(c == 1, false));
+		benches.push_back(new ColorBench(c == 1, true));
+	}
+
+	// From above the hills to where they fill a small part of the view
+	const double distances[4] = {200.0, 800.0, 3200.0, 12800.0};
+
+	for (int d = 0; d < 4; ++d) {
+		benches.push_back(new ViewBench(true, distances[d]));
+		benches.push_back(new ViewBench(false, distances[d]));
+	}
+
+	Counters counters;
+
+	if (!counters.Available()) {
+		std::cout
+			<< "Performance counters are not available ("
+			<< counters.Error() << "), so they are not shown\n";
+	}
+
+	std::cout
+		<< std::left << std::setw(28) << "benchmark" << std::right
+		<< std::setw(12) << "ns/op" << std::setw(10) << "sd"
+		<< std::setw(12) << "cycles/op" << std::setw(12) << "misses/op"
+		<< "\n";
+
+	for (size_t i = 0; i < benches.size(); ++i) {
+		if (benches[i]->Name().find(filter) != std::string::npos) {
+			Measure(benches[i], &counters);
+		}
+
+		delete benches[i];
+	}
+
+	return 0;
+}
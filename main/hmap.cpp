@@ -1,1162 +1,6977 @@
-#include <climits>
-#include <cstdlib>
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-#include <iostream>
-#include <sstream>
-#include <string>
-
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
-
-#include "glm/glm.hpp"
-
-#include "stb_image.h"
-#include "stb_image_write.h"
-
-#include "AABB.hpp"
-#include "ImagePlane.hpp"
-#include "Perspective.hpp"
-#include "Spherical.hpp"
-#include "Orthographic.hpp"
-
-//////////////////////////////////////////////////////////////////////////////
-// Globals
-//////////////////////////////////////////////////////////////////////////////
-
-SDL_Window *window = NULL;
-
-// Window content dimensions (pixels)
-int screen_width = 800;
-int screen_height = 600;
-
-// Horizontal field of view (radians)
-double hfov = M_PI / 2.0;
-
-// Normalize heights in heightmap between these bounds
-double min_height = 0.0;
-double max_height = 10.0;
-
-// For each pixel in the given heightmap image with components RGB,
-// the pixel's heightmap value is (rR + gG + bB),
-// clamped to range [0.0, 255.0],
-// then scaled to range [min_height, max_height]
-double lum_r = 0.299;
-double lum_g = 0.587;
-double lum_b = 0.114;
-
-std::string heightmap_path;
-// BGR888 (R first component in buffer)
-const unsigned char *base_heightmap_buf = NULL;
-// Array of heights in range [min_height, max_height]
-double *heightmap_buf = NULL;
-int heightmap_width;
-int heightmap_height;
-
-std::string colormap_path;
-// Array of RGB unsigned char values
-const unsigned char *colormap_buf = NULL;
-int colormap_width;
-int colormap_height;
-
-// Width and height of grid cells of image heightmap
-// i.e. how far apart pixels from the image are in world space when rendered
-double grid_width = 0.05;
-
-// How far to step at a time when raymarching
-double step_dist = 5.0 * grid_width;
-
-// Draw a full image across `cycle_period` number of frames.
-int cycle_period = 47;
-int cycle = 0;
-
-// Position of camera
-glm::dvec3 cam_pos(-5.0, 5.0, 0.0);
-
-// Horizontal angle of camera (rads)
-// 0 is looking in direction of positive x axis
-// pi / 2 is looking in direction of positive y axis
-double hang = -M_PI / 4.0;
-
-// Vertical angle of camera (rads)
-// 0 is looking straight up (with positive z axis)
-// pi / 2 is looking parallel to xy plane
-double vang = M_PI / 2.0;
-
-// Horizontal and vertical mouse sensitivity
-double mouse_sens = 1.0;
-// Sensitivity when zooming in/out with scroll wheel.
-double scroll_sens = 1.0;
-
-// Unit is units/millisecond
-double move_speed = 0.05;
-
-bool fullscreen = false;
-
-// How far apart the orthographic rays are
-double ortho_width = 2.0 * grid_width;
-
-// The number of frames to render when recording
-// (saving frames out to image files).
-int recording_frame_count = 200;
-
-#define IMAGEPLANE_PERSPECTIVE  1
-#define IMAGEPLANE_SPHERICAL    2
-#define IMAGEPLANE_ORTHOGRAPHIC 3
-int image_plane = IMAGEPLANE_PERSPECTIVE;
-
-// Background color
-Uint8 bg_r = 0;
-Uint8 bg_g = 0;
-Uint8 bg_b = 0;
-
-//////////////////////////////////////////////////////////////////////////////
-// Helper/utility functions
-//////////////////////////////////////////////////////////////////////////////
-
-template<class T>
-static T Clamp(const T value, const T min, const T max) {
-	if (value < min) return min;
-	if (value > max) return max;
-
-	return value;
-}
-
-template<class T>
-static T Lerp(const double prop, T v0, T v1) {
-	return v0 + prop * (v1 - v0);
-}
-
-static double DegreesToRads(const double degrees) {
-	return (degrees / 180.0) * M_PI;
-}
-
-static double RadsToDegrees(const double rads) {
-	return (rads / M_PI) * 180.0;
-}
-
-static void SetPixel(
-	Uint8 *const framebuf,
-	const int x,
-	const int y,
-	const Uint8 r,
-	const Uint8 g,
-	const Uint8 b,
-	const Uint8 a)
-{
-	const size_t i = (x + y * screen_width) * 4;
-
-	framebuf[i + 0] = r;
-	framebuf[i + 1] = g;
-	framebuf[i + 2] = b;
-	framebuf[i + 3] = a;
-}
-
-// Save given RGBA frame buffer as .png image at given path.
-static void SavePNG(Uint8 *framebuf, std::string path) {
-	const int code = stbi_write_png(path.c_str(),
-		screen_width, screen_height, 4,
-		framebuf, screen_width * 4);
-
-	if (code == 0) {
-		std::cerr << "Failed to write screenshot to " << path << "\n";
-	}
-	else {
-		std::cout << "Saved screenshot at " << path << "\n";
-	}
-}
-
-// Update `heightmap_buf` using the current global parameters.
-static void UpdateHeightmap() {
-	const int num_pixels = heightmap_width * heightmap_height;
-	delete[] heightmap_buf;
-	heightmap_buf = new double[num_pixels];
-
-	int p = 0;
-	for (int i = 0; i < num_pixels * 3; i += 3) {
-		const unsigned char r = base_heightmap_buf[i + 0];
-		const unsigned char g = base_heightmap_buf[i + 1];
-		const unsigned char b = base_heightmap_buf[i + 2];
-
-		const double value = Clamp<double>(
-			(lum_r * r) + (lum_g * g) + (lum_b * b),
-			0.0, 255.0
-		);
-
-		heightmap_buf[p] = (value / 255.0)
-		                   * (max_height - min_height) + min_height;
-		p += 1;
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////////
-// Trivial printing functions
-//////////////////////////////////////////////////////////////////////////////
-
-static void PrintHeightmap() {
-	std::cout << "heightmap " << heightmap_path << "\n";
-}
-
-static void PrintColormap() {
-	std::cout << "colormap " << colormap_path << "\n";
-}
-
-static void PrintResolution() {
-	std::cout
-		<< "resolution " << screen_width  << " " << screen_height << "\n";
-}
-
-static void PrintHfov() {
-	std::cout << "hfov " << RadsToDegrees(hfov) << "\n";
-}
-
-static void PrintHang() {
-	std::cout << "hang " << RadsToDegrees(hang) << "\n";
-}
-
-static void PrintVang() {
-	std::cout << "vang " << RadsToDegrees(vang) << "\n";
-}
-
-static void PrintPos() {
-	std::cout
-		<< "pos "
-		<< cam_pos.x << " " << cam_pos.y << " " << cam_pos.z << "\n";
-}
-
-static void PrintMinHeight() {
-	std::cout << "min_height " << min_height << "\n";
-}
-
-static void PrintMaxHeight() {
-	std::cout << "max_height " << max_height << "\n";
-}
-
-static void PrintLum() {
-	std::cout << "lum " << lum_r << " " << lum_g << " " << lum_b << "\n";
-}
-
-static void PrintGridWidth() {
-	std::cout << "grid_width " << grid_width << "\n";
-}
-
-static void PrintOrthoWidth() {
-	std::cout << "ortho_width " << ortho_width << "\n";
-}
-
-static void PrintStepDist() {
-	std::cout << "step_dist " << step_dist << "\n";
-}
-
-static void PrintBgColor() {
-	// Need casts because
-	//  stream does not print Uint8 as ASCII decimal as expected.
-	std::cout
-		<< "bg_color "
-		<< ((int)bg_r) << " "
-		<< ((int)bg_g) << " "
-		<< ((int)bg_b) << "\n";
-}
-
-static void PrintCycle() {
-	std::cout << "cycle " << cycle_period << "\n";
-}
-
-static void PrintMouseSens() {
-	std::cout << "mouse_sens " << mouse_sens << "\n";
-}
-
-static void PrintScrollSens() {
-	std::cout << "scroll_sens " << scroll_sens << "\n";
-}
-
-static void PrintMove() {
-	std::cout << "move " << move_speed << "\n";
-}
-
-static void PrintRecordingFrameCount() {
-	std::cout << "recording_frame_count " << recording_frame_count << "\n";
-}
-
-static void PrintAllOptions() {
-	PrintHeightmap();
-	PrintColormap();
-	PrintResolution();
-	PrintHfov();
-	PrintHang();
-	PrintVang();
-	PrintPos();
-	PrintMinHeight();
-	PrintMaxHeight();
-	PrintLum();
-	PrintGridWidth();
-	PrintOrthoWidth();
-	PrintStepDist();
-	PrintBgColor();
-	PrintCycle();
-	PrintMouseSens();
-	PrintScrollSens();
-	PrintMove();
-	PrintRecordingFrameCount();
-}
-
-//////////////////////////////////////////////////////////////////////////////
-// More file-local functions
-//////////////////////////////////////////////////////////////////////////////
-
-// Read stream until end and update config values
-static void ConsumeConfigStream(std::istream &input) {
-	bool should_update_heightmap = false;
-
-	std::string next;
-	while (input >> next) {
-		if (next == "heightmap") {
-			input >> heightmap_path;
-
-			{
-				int n;
-				stbi_image_free((void*)base_heightmap_buf);
-				base_heightmap_buf = stbi_load(heightmap_path.c_str(),
-					&heightmap_width, &heightmap_height, &n, 3);
-			}
-
-			if (base_heightmap_buf == NULL) {
-				std::cerr
-					<< "Failed to load image for heightmap from "
-					<< heightmap_path << "\n";
-				std::exit(1);
-			}
-
-			should_update_heightmap = true;
-
-			PrintHeightmap();
-		}
-		else if (next == "colormap") {
-			input >> colormap_path;
-
-			{
-				int n;
-				stbi_image_free((void*)colormap_buf);
-				colormap_buf = stbi_load(colormap_path.c_str(),
-					&colormap_width, &colormap_height, &n, 4);
-			}
-
-			if (colormap_buf == NULL) {
-				std::cerr
-					<< "Failed to load image for colormap from "
-					<< colormap_path << "\n";
-				std::exit(1);
-			}
-
-			PrintColormap();
-		}
-		else if (next == "print") {
-			std::cout << "print\n";
-			PrintAllOptions();
-		}
-		else if (next == "resolution") {
-			input >> screen_width >> screen_height;
-
-			if (window != NULL) {
-				SDL_SetWindowSize(window, screen_width, screen_height);
-			}
-
-			PrintResolution();
-		}
-		else if (next == "hfov") {
-			double deg;
-			input >> deg;
-			hfov = DegreesToRads(deg);
-			PrintHfov();
-		}
-		else if (next == "hang") {
-			double deg;
-			input >> deg;
-			hang = DegreesToRads(deg);
-			PrintHang();
-		}
-		else if (next == "vang") {
-			double deg;
-			input >> deg;
-			vang = DegreesToRads(deg);
-			PrintVang();
-		}
-		else if (next == "pos") {
-			input >> cam_pos.x >> cam_pos.y >> cam_pos.z;
-			PrintPos();
-		}
-		else if (next == "pos_x") {
-			input >> cam_pos.x;
-			std::cout << "pos_x " << cam_pos.x << "\n";
-		}
-		else if (next == "pos_y") {
-			input >> cam_pos.y;
-			std::cout << "pos_y " << cam_pos.y << "\n";
-		}
-		else if (next == "pos_z") {
-			input >> cam_pos.z;
-			std::cout << "pos_z " << cam_pos.z << "\n";
-		}
-		else if (next == "min_height") {
-			input >> min_height;
-			should_update_heightmap = true;
-			PrintMinHeight();
-		}
-		else if (next == "max_height") {
-			input >> max_height;
-			should_update_heightmap = true;
-			PrintMaxHeight();
-		}
-		else if (next == "lum") {
-			input >> lum_r >> lum_g >> lum_b;
-			should_update_heightmap = true;
-			PrintLum();
-		}
-		else if (next == "lum_norm") {
-			double r, g, b;
-			input >> r >> g >> b;
-			const double total = r + g + b;
-			lum_r = r / total;
-			lum_g = g / total;
-			lum_b = b / total;
-			should_update_heightmap = true;
-			PrintLum();
-		}
-		else if (next == "lum_r") {
-			input >> lum_r;
-			should_update_heightmap = true;
-			std::cout << "lum_r " << lum_r << "\n";
-		}
-		else if (next == "lum_g") {
-			input >> lum_g;
-			should_update_heightmap = true;
-			std::cout << "lum_g " << lum_g << "\n";
-		}
-		else if (next == "lum_b") {
-			input >> lum_b;
-			should_update_heightmap = true;
-			std::cout << "lum_b " << lum_b << "\n";
-		}
-		else if (next == "grid_width") {
-			input >> grid_width;
-			PrintGridWidth();
-		}
-		else if (next == "ortho_width") {
-			input >> ortho_width;
-			PrintOrthoWidth();
-		}
-		else if (next == "step_dist") {
-			input >> step_dist;
-			PrintStepDist();
-		}
-		else if (next == "bg_color") {
-			// Read into int intermediaries because
-			//  stream does not properly read directly to Uint8.
-			int r, g, b;
-			input >> r >> g >> b;
-
-			bg_r = (Uint8)r;
-			bg_g = (Uint8)g;
-			bg_b = (Uint8)b;
-
-			PrintBgColor();
-		}
-		else if (next == "cycle") {
-			input >> cycle_period;
-			cycle = 0;
-			PrintCycle();
-		}
-		else if (next == "mouse_sens") {
-			input >> mouse_sens;
-			PrintMouseSens();
-		}
-		else if (next == "scroll_sens") {
-			input >> scroll_sens;
-			PrintScrollSens();
-		}
-		else if (next == "move") {
-			input >> move_speed;
-			PrintMove();
-		}
-		else if (next == "recording_frame_count") {
-			input >> recording_frame_count;
-			PrintRecordingFrameCount();
-		}
-		else {
-			std::cerr << "WARNING: Unknown identifier: " << next << "\n";
-		}
-	}
-
-	// Some validation
-
-	if (base_heightmap_buf == NULL) {
-		std::cerr << "Must specify heightmap in config\n";
-		std::exit(1);
-	}
-
-	if (colormap_buf == NULL) {
-		std::cerr << "Must specify colormap in config\n";
-		std::exit(1);
-	}
-
-	const bool dimensions_conflict =
-		(heightmap_width  != colormap_width) ||
-		(heightmap_height != colormap_height);
-
-	if (dimensions_conflict) {
-		std::cerr
-			<< "heightmap dimensions (" << heightmap_width
-			<< "x" << heightmap_height
-			<<  ") must match colormap dimensions ("
-			<< colormap_width << "x" << colormap_height << ")\n";
-
-		std::exit(1);
-	}
-
-	if (should_update_heightmap) {
-		UpdateHeightmap();
-	}
-}
-
-//////////////////////////////////////////////////////////////////////////////
-// main
-//////////////////////////////////////////////////////////////////////////////
-
-int main(int argc, char *argv[]) {
-	if (argc != 2) {
-		std::cerr << "USAGE: hmap.exe path/to/config.txt\n";
-		std::exit(1);
-	}
-
-	// Parse input file
-
-	std::ifstream input;
-	input.open(argv[1]);
-
-	if (!input.is_open()) {
-		std::cerr << "Failed to open input file: " << argv[1] << "\n";
-		std::exit(1);
-	}
-
-	ConsumeConfigStream(input);
-
-	input.close();
-
-	// Initialize libraries
-
-	class ManageSDL {
-	public:
-		ManageSDL() {
-			if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-				std::cerr << "SDL_Init failed: " << SDL_GetError() << "\n";
-				std::exit(1);
-			}
-		}
-
-		~ManageSDL() { SDL_Quit(); }
-	};
-	const ManageSDL manage_sdl;
-
-	class ManageTTF {
-	public:
-		ManageTTF() {
-			if (TTF_Init() != 0) {
-				std::cerr << "TTF_Init failed: " << TTF_GetError() << "\n";
-				std::exit(1);
-			}
-		}
-
-		~ManageTTF() { TTF_Quit(); }
-	};
-	const ManageTTF manage_ttf;
-
-	const char font_path[] = "fonts/NotoSansMono-Regular.ttf";
-	TTF_Font *const font = TTF_OpenFont(font_path, 12);
-
-	if (font == NULL) {
-		std::cerr << "Failed to open font at: " << font_path << "\n";
-		std::exit(1);
-	}
-
-	window = SDL_CreateWindow(
-		"Heightmap Ray Marcher",
-		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-		screen_width, screen_height,
-		SDL_WINDOW_RESIZABLE);
-
-	if (window == NULL) {
-		std::cerr << "SDL_CreateWindow failed: " << SDL_GetError() << "\n";
-		std::exit(1);
-	}
-
-	SDL_Renderer *renderer =
-		SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-
-	if (renderer == NULL) {
-		std::cerr << "Failed to create renderer: " << SDL_GetError() << "\n";
-		exit(1);
-	}
-
-	SDL_Texture *tex = SDL_CreateTexture(
-		renderer,
-		SDL_PIXELFORMAT_ABGR8888,
-		SDL_TEXTUREACCESS_STREAMING,
-		screen_width, screen_height);
-
-	if (tex == NULL) {
-		std::cerr << "Failed to create texture: " << SDL_GetError() << "\n";
-		std::exit(1);
-	}
-
-	Uint8 *framebuf = new Uint8[screen_width * screen_height * 4];
-
-	std::srand((unsigned)std::time(NULL));
-
-	bool quit = false;
-	bool show_fps = false;
-
-	SDL_Surface *fps_surface = NULL;
-	SDL_Surface *console_surface = NULL;
-
-	// To avoid the text changing too frequently to be readable,
-	//  update the text only every X ms.
-	const Uint32 text_surface_rerender_period_ms = 200;
-	Uint32 text_surface_rerender_timer_ms = text_surface_rerender_period_ms + 1;
-
-	bool console_active = false;
-	std::string console_buf;
-	console_buf.assign(" ");
-
-	Uint32 old_time = SDL_GetTicks();// milliseconds
-	Uint32 new_time;
-	Uint32 delta;
-	double ddelta;
-
-	if (SDL_SetRelativeMouseMode(SDL_TRUE)) {
-		std::cerr << "Initial SDL_SetRelativeMouseMode failed: "
-		          << SDL_GetError() << "\n";
-		std::exit(1);
-	}
-
-	bool recording = false;
-	// Auto-generated identifier (currently, unix epoch in seconds)
-	// that will differ from id of any existing recordings,
-	// so that frames can be written to image files
-	// without overwriting any files.
-	std::time_t recording_id;
-	// Current frame number while recording. Frame 0 is first frame.
-	int recording_frame_num = 0;
-
-	while (!quit) {
-		new_time = SDL_GetTicks();
-		delta = new_time - old_time;
-		ddelta = (double)delta;
-		old_time = new_time;
-
-		text_surface_rerender_timer_ms += delta;
-
-		// Converting spherical coordinates to a vector
-		// r = 1 so not shown and no need to normalize the vector
-		glm::dvec3 look(
-			sin(vang) * cos(hang),
-			sin(vang) * sin(hang),
-			cos(vang)
-		);
-
-		double up_vang = vang - (M_PI / 2.0);
-		glm::dvec3 up(
-			sin(up_vang) * cos(hang),
-			sin(up_vang) * sin(hang),
-			cos(up_vang)
-		);
-
-		glm::dvec3 forward(
-			cos(hang),
-			sin(hang),
-			0.0
-		);
-
-		double right_hang = hang - (M_PI / 2.0);
-		glm::dvec3 right(
-			cos(right_hang),
-			sin(right_hang),
-			0.0
-		);
-
-		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
-			if (event.type == SDL_QUIT) {
-				quit = true;
-			}
-			else if (event.type == SDL_WINDOWEVENT) {
-				if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-					// Maybe different call if high DPI allowed
-					//  when window created
-					SDL_GetWindowSize(window, &screen_width, &screen_height);
-
-					delete[] framebuf;
-					framebuf = new Uint8[screen_width * screen_height * 4];
-
-					SDL_DestroyTexture(tex);
-					tex = SDL_CreateTexture(
-						renderer,
-						SDL_PIXELFORMAT_ABGR8888,
-						SDL_TEXTUREACCESS_STREAMING,
-						screen_width, screen_height);
-
-					if (tex == NULL) {
-						std::cerr << "Failed to recreate texture: "
-						          << SDL_GetError() << "\n";
-						std::exit(1);
-					}
-				}
-				else if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
-					if (SDL_SetRelativeMouseMode(SDL_TRUE)) {
-						std::cerr
-							<< "FOCUS_GAINED SDL_SetRelativeMouseMode failed: "
-							<< SDL_GetError() << "\n";
-					}
-				}
-				else if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
-					if (SDL_SetRelativeMouseMode(SDL_FALSE)) {
-						std::cerr
-							<< "FOCUS_LOST SDL_SetRelativeMouseMode failed: "
-							<< SDL_GetError() << "\n";
-					}
-				}
-			}
-			else if (event.type == SDL_MOUSEMOTION) {
-				hang -= mouse_sens * 0.00025 * event.motion.xrel * ddelta;
-				vang += mouse_sens * 0.00025 * event.motion.yrel * ddelta;
-
-				if (vang < 0.0) {
-					vang = 0.0;
-				}
-				else if (vang > M_PI) {
-					vang = M_PI;
-				}
-			}
-			else if (event.type == SDL_MOUSEWHEEL) {
-				if (image_plane == IMAGEPLANE_PERSPECTIVE ||
-					image_plane == IMAGEPLANE_SPHERICAL)
-				{
-					const double new_hfov =
-						hfov - (scroll_sens * 0.03 * event.wheel.y);
-
-					if (new_hfov > 0.0 && new_hfov < M_PI) {
-						hfov = new_hfov;
-					}
-				}
-				else if (image_plane == IMAGEPLANE_ORTHOGRAPHIC) {
-					const double new_ortho_width =
-						ortho_width - (scroll_sens * 0.0075 * event.wheel.y);
-
-					if (new_ortho_width > 0.0) {
-						ortho_width = new_ortho_width;
-					}
-				}
-			}
-			else if (event.type == SDL_TEXTINPUT && console_active) {
-				console_buf.append(event.text.text);
-			}
-			else if (event.type == SDL_KEYUP) {
-				const SDL_Keymod mod_state = SDL_GetModState();
-
-				switch (event.key.keysym.sym) {
-				case SDLK_q:
-				{
-					if (mod_state & KMOD_CTRL) {
-						quit = true;
-					}
-
-					break;
-				}
-				case SDLK_BACKQUOTE:
-				{
-					console_active = !console_active;
-
-					if (console_active) {
-						console_buf.assign(" ");
-					}
-
-					break;
-				}
-				case SDLK_BACKSPACE:
-				{
-					// Do not permit deleting the leading space
-					if (console_active && console_buf.length() > 1) {
-						console_buf.erase(console_buf.length() - 1, 1);
-					}
-
-					break;
-				}
-				case SDLK_RETURN:
-				{
-					if (console_active) {
-						console_active = false;
-						std::istringstream iss(console_buf);
-						ConsumeConfigStream(iss);
-						console_buf.assign(" ");
-					}
-
-					break;
-				}
-				case SDLK_F1:
-				{
-					show_fps = !show_fps;
-					break;
-				}
-				case SDLK_F11:
-					// Ignore F11 press
-					//  if any of Alt, Shift, Ctrl, etc. are down
-					if (mod_state != KMOD_NONE) {
-						break;
-					}
-
-					fullscreen = !fullscreen;
-
-					if (fullscreen) {
-						SDL_SetWindowFullscreen(
-							window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-					}
-					else {
-						SDL_SetWindowFullscreen(window, 0);
-					}
-
-					break;
-				case SDLK_F12:
-				{
-					if (mod_state != KMOD_NONE) {
-						break;
-					}
-
-					std::time_t seconds = std::time(NULL);
-
-					if (seconds == (std::time_t)(-1)) {
-						std::cerr
-							<< "Failed to get time for screenshot. "
-							<< "Screenshot NOT saved.\n";
-					}
-					else {
-						std::stringstream ss;
-						ss << "screenshots/hmap_" << seconds << ".png";
-						std::string path = ss.str();
-
-						SavePNG(framebuf, path);
-					}
-
-					break;
-				}
-				case SDLK_1:
-					if (!console_active) {
-						image_plane = IMAGEPLANE_PERSPECTIVE;
-					}
-
-					break;
-				case SDLK_2:
-					if (!console_active) {
-						image_plane = IMAGEPLANE_SPHERICAL;
-					}
-
-					break;
-				case SDLK_3:
-					if (!console_active) {
-						image_plane = IMAGEPLANE_ORTHOGRAPHIC;
-					}
-
-					break;
-				case SDLK_r:
-				{
-					const bool ctrl_and_shift = (mod_state & KMOD_CTRL) &&
-					                            (mod_state & KMOD_SHIFT);
-
-					if (!console_active && ctrl_and_shift) {
-						if (!recording) {
-							recording = true;
-							recording_frame_num = 0;
-
-							recording_id = std::time(NULL);
-
-							// move_speed = 0.0;
-							// mouse_sens = 0.0;
-							// scroll_sens = 0.0;
-							// cycle_period = 1;
-
-							if (recording_id == (std::time_t)(-1)) {
-								std::cerr
-									<< "Failed to get time for recording. "
-									<< "Recording NOT started.\n";
-
-								recording = false;
-							}
-						}
-						else {
-							recording = !recording;
-						}
-					}
-
-					break;
-				}
-				default:
-					break;
-				}
-			}
-		}
-
-		// If you do not intend to manually move the camera while recording,
-		// before starting the recording, consider setting in the console:
-		//     move 0
-		//     mouse_sens 0
-		//     scroll_sens 0
-		//
-		// Also consider `cycle 1` so that frames are complete images.
-		//
-		// For a programmatic animation, alter this block and recompile.
-		if (recording)
-		{
-			// const double t =
-			// 	((double)recording_frame_num) / recording_frame_count;
-			//
-			// // Change some global parameters.
-			//
-			// // We need to update the heightmap if we have changed any
-			// // global parameters that have an effect on it.
-			// UpdateHeightmap();
-		}
-
-		const Uint8 *const kb_state = SDL_GetKeyboardState(NULL);
-		const SDL_Keymod mod_state = SDL_GetModState();
-
-		if (!console_active && mod_state == KMOD_NONE) {
-			if (kb_state[SDL_SCANCODE_W]) {
-				cam_pos += ddelta * move_speed * forward;
-			}
-			if (kb_state[SDL_SCANCODE_S]) {
-				cam_pos -= ddelta * move_speed * forward;
-			}
-			if (kb_state[SDL_SCANCODE_D]) {
-				cam_pos += ddelta * move_speed * right;
-			}
-			if (kb_state[SDL_SCANCODE_A]) {
-				cam_pos -= ddelta * move_speed * right;
-			}
-			if (kb_state[SDL_SCANCODE_SPACE]) {
-				cam_pos.z += ddelta * move_speed;
-			}
-			if (kb_state[SDL_SCANCODE_Q]) {
-				cam_pos.z -= ddelta * move_speed;
-			}
-		}
-
-		ImagePlane *ip;
-
-		if (image_plane == IMAGEPLANE_PERSPECTIVE) {
-			ip = new Perspective(cam_pos, look, up, hfov,
-				(double)screen_width / screen_height);
-		}
-		else if (image_plane == IMAGEPLANE_SPHERICAL) {
-			ip = new Spherical(cam_pos, hang, vang, hfov,
-				(double)screen_width / screen_height);
-		}
-		else {
-			ip = new Orthographic(cam_pos, look, up, ortho_width,
-				screen_width, screen_height);
-		}
-
-		// Upper left bottom corner of the heightmap
-		glm::dvec3 hmap_c0(0.0, 0.0, min_height);
-		// Lower right top corner of the heightmap
-		glm::dvec3 hmap_c1(
-			hmap_c0.x + heightmap_width * grid_width,
-			hmap_c0.y - heightmap_height * grid_width,
-			max_height
-		);
-
-		cycle = (cycle + 1) % cycle_period;
-
-		#pragma omp parallel for
-		for (int p = cycle; p < screen_width * screen_height;
-		     p += cycle_period)
-		{
-			int w = p % screen_width;
-			int h = p / screen_width;
-
-			struct Ray ray = ip->GetRay(
-				(double)w / (screen_width - 1),
-				(double)h / (screen_height - 1)
-			);
-
-			glm::dvec3 int_point;
-			bool hit = intersection(&int_point, ray, hmap_c0, hmap_c1);
-
-			// Did the ray hit the actual heightmap and
-			//  not just the bounding box?
-			bool real_hit = false;
-
-			if (hit) {
-				int_point += grid_width * 0.01 * ray.dir;
-
-				while (true) {
-					int gridx =
-						(int)( (int_point.x - hmap_c0.x) / grid_width);
-					int gridy =
-						(int)(-(int_point.y - hmap_c0.y) / grid_width);
-
-					if (gridx < 0 || gridy < 0
-						|| gridx >= heightmap_width
-						|| gridy >= heightmap_height)
-					{
-						break;
-					}
-
-					double heightmap_z =
-						heightmap_buf[gridx + gridy * heightmap_width];
-
-					if (int_point.z < heightmap_z + hmap_c0.z) {
-						// Draw
-						int red_index = (gridx + gridy * colormap_width) * 4;
-
-						if (colormap_buf[red_index + 3] == 0) {
-							SetPixel(framebuf, w, h,
-								bg_r, bg_g, bg_b,
-								255);
-						}
-						else {
-							SetPixel(framebuf, w, h,
-								colormap_buf[red_index + 0],
-								colormap_buf[red_index + 1],
-								colormap_buf[red_index + 2],
-								255);
-						}
-
-						real_hit = true;
-						break;
-					}
-
-					int_point += step_dist * ray.dir;
-				}
-			}
-
-			if (!real_hit) {
-				// Sky-like effect
-				if (ray.dir.z > 0.0) {
-					const double r_ = 220.0 * std::pow(ray.dir.z, 2) + bg_r;
-					const double g_ = 240.0 * std::pow(ray.dir.z, 2) + bg_g;
-					const double b_ = 255.0 * ray.dir.z              + bg_b;
-
-					SetPixel(framebuf, w, h,
-						(Uint8)std::floor(Clamp<double>(r_, 0.0, 255.0)),
-						(Uint8)std::floor(Clamp<double>(g_, 0.0, 255.0)),
-						(Uint8)std::floor(Clamp<double>(b_, 0.0, 255.0)),
-						255);
-				}
-				else {
-					SetPixel(framebuf, w, h, bg_r, bg_g, bg_b, 255);
-				}
-			}
-		}
-
-		if (text_surface_rerender_timer_ms >= text_surface_rerender_period_ms)
-		{
-			text_surface_rerender_timer_ms = 0;
-
-			SDL_Color fg = {255, 255, 255, 255};
-			SDL_Color bg = {0, 0, 0, 255};
-
-			const double fps = 1000.0 / ddelta;
-
-			std::stringstream ss;
-			ss << "FPS: " << std::fixed << std::setprecision(1) << fps;
-
-			SDL_FreeSurface(fps_surface);
-			fps_surface = TTF_RenderUTF8_Shaded(font, ss.str().c_str(), fg, bg);
-
-			bg = (SDL_Color){50, 100, 250, 255};
-
-			SDL_FreeSurface(console_surface);
-			console_surface = TTF_RenderUTF8_Shaded(
-				font, console_buf.c_str(), fg, bg);
-		}
-
-		SDL_UpdateTexture(tex, NULL, framebuf, screen_width * 4);
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, tex, NULL, NULL);
-
-		// fps_surface and console_surface will not appear in screenshots
-		//  and recordings because they are sent 'straight to the renderer'
-		//  rather than being put into `framebuf`
-
-		if (show_fps && fps_surface != NULL) {
-			SDL_Texture *const ftex =
-				SDL_CreateTextureFromSurface(renderer, fps_surface);
-
-			if (ftex == NULL) {
-				std::cerr
-					<< "Failed to create texture from fps_surface: "
-					<< SDL_GetError() << "\n";
-				break;
-			}
-
-			SDL_Rect dst_rect = {5, 2, fps_surface->w, fps_surface->h};
-			SDL_RenderCopy(renderer, ftex, NULL, &dst_rect);
-
-			SDL_DestroyTexture(ftex);
-		}
-
-		if (console_active && console_surface != NULL) {
-			SDL_Texture *const ftex =
-				SDL_CreateTextureFromSurface(renderer, console_surface);
-
-			if (ftex == NULL) {
-				std::cerr
-					<< "Failed to create texture from console_surface: "
-					<< SDL_GetError() << "\n";
-				break;
-			}
-
-			SDL_Rect dst_rect = {
-				0, screen_height - console_surface->h - 10,
-				console_surface->w, console_surface->h
-			};
-			SDL_RenderCopy(renderer, ftex, NULL, &dst_rect);
-
-			SDL_DestroyTexture(ftex);
-		}
-
-		SDL_RenderPresent(renderer);
-
-		delete ip;
-
-		if (recording) {
-			std::stringstream ss;
-			ss << "screenshots/hmap_" << recording_id << "_"
-			   << recording_frame_num << ".png";
-
-			SavePNG(framebuf, ss.str());
-
-			recording_frame_num += 1;
-
-			if (recording_frame_num == recording_frame_count) {
-				recording = false;
-				std::cout << "Done recording.\n";
-			}
-		}
-	} // while (!quit)
-
-	SDL_DestroyWindow(window);
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyTexture(tex);
-	SDL_FreeSurface(fps_surface);
-	SDL_FreeSurface(console_surface);
-
-	TTF_CloseFont(font);
-
-	stbi_image_free((void*)base_heightmap_buf);
-	delete[] heightmap_buf;
-	stbi_image_free((void*)colormap_buf);
-
-	delete[] framebuf;
-
-	return 0;
-}
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <omp.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include "glm/glm.hpp"
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+#include "AABB.hpp"
+#include "AllocCount.hpp"
+#include "BVH.hpp"
+#include "Beam.hpp"
+#include "ColorBlocks.hpp"
+#include "Heights.hpp"
+#include "Hud.hpp"
+#include "ImageDiff.hpp"
+#include "ImagePlane.hpp"
+#include "Light.hpp"
+#include "MaxMip.hpp"
+#include "Perspective.hpp"
+#include "Process.hpp"
+#include "Procedural.hpp"
+#include "Raster.hpp"
+#include "Socket.hpp"
+#include "Spherical.hpp"
+#include "Splat.hpp"
+#include "Orthographic.hpp"
+#include "Terrain.hpp"
+
+//////////////////////////////////////////////////////////////////////////////
+// Globals
+//////////////////////////////////////////////////////////////////////////////
+
+SDL_Window *window = NULL;
+
+// Window content dimensions (pixels)
+int screen_width = 800;
+int screen_height = 600;
+
+// Horizontal field of view (radians)
+double hfov = M_PI / 2.0;
+
+// Normalize heights in heightmap between these bounds
+double min_height = 0.0;
+double max_height = 10.0;
+
+// For each pixel in the given heightmap image with components RGB,
+// the pixel's heightmap value is (rR + gG + bB),
+// clamped to range [0.0, 255.0],
+// then scaled to range [min_height, max_height]
+double lum_r = 0.299;
+double lum_g = 0.587;
+double lum_b = 0.114;
+
+std::string heightmap_path;
+// BGR888 (R first component in buffer)
+const unsigned char *base_heightmap_buf = NULL;
+// Array of heights in range [min_height, max_height].
+// Reused by UpdateHeightmap() while the dimensions stay the same,
+//  so set to NULL (after delete[]) when `base_heightmap_buf` is replaced.
+double *heightmap_buf = NULL;
+// Parameters that `heightmap_buf` was converted with
+struct HeightParams heightmap_params;
+// Max mip of `heightmap_buf`, built whenever it is converted
+//  so that beams, rasterizing and adaptive marches can use it.
+// Loaded heightmaps come with theirs, built by the thread that loaded them.
+MaxMip *heightmap_mip = NULL;
+// Light of `heightmap_buf`, also baked by the thread that loaded it
+//  if `lighting` was on then, and otherwise empty until first needed
+TerrainLight *heightmap_light = NULL;
+int heightmap_width;
+int heightmap_height;
+
+std::string colormap_path;
+// Array of RGB unsigned char values,
+//  NULL while the colormap is kept compressed in `colormap_blocks`
+const unsigned char *colormap_buf = NULL;
+ColorBlocks colormap_blocks;
+// Need not match the heightmap's dimensions:
+//  the colors are resampled over the same area
+int colormap_width;
+int colormap_height;
+// Whether to blend the 4 nearest colors of the colormap
+//  instead of taking the nearest (`colormap_filter` option)
+bool colormap_bilinear = false;
+// Whether to keep the colormaps compressed to 4 bits per texel
+//  instead of as RGBA (`colormap_compress` option).
+// They are compressed or loaded back when `terrains` are updated.
+bool colormap_compress = false;
+
+// Width and height of grid cells of image heightmap
+// i.e. how far apart pixels from the image are in world space when rendered
+double grid_width = 0.05;
+
+// Additional heightmaps placed in the world with the `instance` option.
+// The heightmap from the `heightmap`/`colormap` options is always at (0, 0).
+struct TerrainInstance {
+	std::string heightmap_path;
+	std::string colormap_path;
+
+	// Upper left corner in world space
+	double x;
+	double y;
+	double grid_width;
+	double min_height;
+	double max_height;
+
+	// Same layouts and rules as the globals of the same names
+	const unsigned char *base_heightmap_buf;
+	double *heightmap_buf;
+	struct HeightParams heightmap_params;
+	MaxMip *mip;
+	TerrainLight *light;
+	const unsigned char *colormap_buf;
+	int width;
+	int height;
+	int color_width;
+	int color_height;
+	ColorBlocks color_blocks;
+};
+std::vector<struct TerrainInstance> instances;
+
+// Endless terrain generated in tiles around the camera
+//  (`procedural` and `procedural_tiles` options),
+//  drawn along with the heightmap and instances
+bool procedural_enabled = false;
+struct ProceduralParams procedural_params = {1, 6, 20.0, 0.0, 3.0, 128, 0.05};
+// Tiles within this distance of the camera are drawn
+double procedural_range = 40.0;
+// Most tiles kept in memory, at least those drawn
+int procedural_cache_tiles = 512;
+
+// Tiles of the procedural terrain and the thread generating them
+struct ProceduralTerrain {
+	struct ProceduralParams params;
+
+	// Guards the members up to `thread`
+	SDL_mutex *mutex;
+	// Signalled when tiles are requested
+	SDL_cond *changed;
+	// Tiles to generate at full detail, the nearest last
+	std::vector<std::pair<int, int> > requests;
+	// Whether to bake the light of the tiles too, with `sun`
+	bool lighting;
+	struct Sun sun;
+	// Tile being generated, if `generating`
+	std::pair<int, int> current;
+	bool generating;
+	// Tiles generated but not yet taken by the main thread
+	std::vector<struct ProceduralTile*> finished;
+	// Set to end the thread
+	bool stop;
+	// Generation stats
+	int generated;
+	double generate_ms_total;
+
+	// Started when first needed, so NULL while only rendering
+	//  with every tile generated up front
+	SDL_Thread *thread;
+
+	// Used by the main thread only
+	bool thread_failed;
+	ProceduralCache cache;
+	// Tiles drawn after the heightmap and instances, in order
+	std::vector<struct ProceduralTile*> shown;
+	// Counts updates, for the cache to know which tiles are in use
+	long long now;
+	int coarse_generated;
+	// Reused between updates
+	std::vector<std::pair<int, int> > in_range;
+	std::vector<std::pair<int, int> > missing;
+	std::vector<std::pair<int, int> > stale;
+	std::vector<struct ProceduralTile*> tiles;
+};
+
+// The procedural terrain if enabled, or NULL
+struct ProceduralTerrain *procedural = NULL;
+
+// The heightmap followed by the instances and the procedural tiles,
+//  rebuilt along with the BVH after config changes
+std::vector<struct Terrain> terrains;
+BVH terrain_bvh;
+// Index in `terrains` of the first procedural tile
+size_t procedural_first = 0;
+
+// Whether to write the depth and texel of each pixel
+//  next to screenshots (`gbuffer_dump` option)
+bool gbuffer_dump = false;
+
+// Whether to shade the terrains with the light baked from their heights
+//  (`lighting` option), and where it comes from
+bool use_lighting = false;
+double sun_azimuth = M_PI / 4.0;
+double sun_elevation = M_PI / 6.0;
+double ambient = 0.4;
+
+// Counts changes to `terrains` and their heights,
+//  so that what is worked out from them can be kept until they change
+long long terrain_version = 0;
+
+// Whether to trace a beam for each BEAM_TILE x BEAM_TILE pixels
+//  to find how far along its rays the marches can start (`beam` option)
+bool use_beams = false;
+#define BEAM_TILE 8
+// Rays traced with beams and the steps skipped thanks to them
+//  since the last `beam_stats`
+long long beam_rays = 0;
+long long beam_steps_skipped = 0;
+
+// How far to step at a time when raymarching
+double step_dist = 5.0 * grid_width;
+
+// Whether marches take adaptive steps (`step_mode`) of at least `step_min`
+//  (or if 0, half the grid width of the terrain marched)
+//  growing by `step_growth` per unit of distance along the ray,
+//  refining where they cross the surface with `refine_iters` bisections
+bool step_adaptive = false;
+double step_min = 0.0;
+double step_growth = 0.005;
+int refine_iters = 5;
+
+// Draw a full image across `cycle_period` number of frames.
+int cycle_period = 47;
+int cycle = 0;
+
+// Position of camera
+glm::dvec3 cam_pos(-5.0, 5.0, 0.0);
+
+// Horizontal angle of camera (rads)
+// 0 is looking in direction of positive x axis
+// pi / 2 is looking in direction of positive y axis
+double hang = -M_PI / 4.0;
+
+// Vertical angle of camera (rads)
+// 0 is looking straight up (with positive z axis)
+// pi / 2 is looking parallel to xy plane
+double vang = M_PI / 2.0;
+
+// Horizontal and vertical mouse sensitivity
+double mouse_sens = 1.0;
+// Sensitivity when zooming in/out with scroll wheel.
+double scroll_sens = 1.0;
+
+// Unit is units/millisecond
+double move_speed = 0.05;
+
+bool fullscreen = false;
+
+// How far apart the orthographic rays are
+double ortho_width = 2.0 * grid_width;
+
+// The number of frames to render when recording
+// (saving frames out to image files).
+int recording_frame_count = 200;
+
+#define IMAGEPLANE_PERSPECTIVE  1
+#define IMAGEPLANE_SPHERICAL    2
+#define IMAGEPLANE_ORTHOGRAPHIC 3
+int image_plane = IMAGEPLANE_PERSPECTIVE;
+
+// How pixels find the terrain they see.
+// Splatting is only done for orthographic views looking down
+//  and rasterizing for perspective views; other views are marched.
+#define ENGINE_MARCH  1
+#define ENGINE_SPLAT  2
+#define ENGINE_RASTER 3
+int render_engine = ENGINE_MARCH;
+
+// Pixels across that the rasterizer's triangles may grow to
+//  before it draws a part of the terrain with fewer of them
+double raster_lod = 1.0;
+
+// Extra jittered rays cast through each pixel on an edge
+//  in the window, and in screenshots, recordings and batches.
+// 0 turns anti-aliasing off.
+#define AA_MAX_SAMPLES 16
+int aa_samples = 0;
+int aa_capture_samples = 0;
+
+// Most extra rays as a percent of the pixels rendered.
+// When there are more edges than that allows, each gets fewer rays.
+double aa_budget = 30.0;
+
+// Since the last `aa_stats`
+long long aa_pixels = 0;
+long long aa_edge_pixels = 0;
+long long aa_rays = 0;
+
+// Variable-rate shading of the window (`vrs` option):
+//  pixels within `vrs_full` of the point of interest get a ray each,
+//  those within `vrs_half` one per 2x2 and the rest one per 4x4,
+//  with the pixels in between interpolated unless they are on an edge.
+// Distances are in half screen widths.
+#define VRS_BLOCK 4
+bool use_vrs = false;
+// Point of interest as a proportion of the screen's width and height
+double vrs_x = 0.5;
+double vrs_y = 0.5;
+double vrs_full = 0.5;
+double vrs_half = 1.0;
+// Whether to tint the pixels by their rate
+bool vrs_overlay = false;
+
+// Since the last `vrs_stats`
+long long vrs_pixels = 0;
+long long vrs_rays = 0;
+
+// Rows rendered and written at a time by `poster`
+int poster_band = 64;
+
+// Allocations while drawing frames of the window (see AllocCount),
+//  to check with `alloc_stats` that a frame does not allocate
+//  once the buffers it reuses are big enough.
+// Since the last `alloc_stats`
+long long frame_allocs = 0;
+long long alloc_frames = 0;
+// Times `alloc_check` found a frame that allocates
+int alloc_check_failed = 0;
+
+// Heads-up display of how the frames of the window went
+//  (toggled with F1 or `hud`)
+bool show_hud = false;
+// Whether the HUD is drawn into the frames themselves,
+//  so that recordings and screenshots have it
+bool hud_record = false;
+Hud hud;
+// Rays marched for whole pixels of the window and the steps they took
+//  since the HUD last took them
+long long hud_march_rays = 0;
+long long hud_steps = 0;
+
+// Most percent of pixels that `engine_compare` allows
+//  to differ between the engine and marching.
+// Pixels differ if a channel differs by more than the threshold,
+//  so that shading a neighboring cell of a smooth colormap does not count.
+#define ENGINE_COMPARE_THRESHOLD 16
+double engine_tolerance = 2.0;
+// Comparisons over the tolerance, which make --batch exit with status 1
+int engine_compare_failed = 0;
+
+// How many times shorter the steps that `step_compare`
+//  compares the fixed and adaptive steps against are
+#define STEP_COMPARE_FINE 8
+
+// How much a `--golden` frame may differ from its reference image:
+//  the percent of pixels with a channel that differs by more than
+//  golden_threshold, and the lowest structural similarity (SSIM)
+int golden_threshold = 16;
+double golden_percent = 0.5;
+double golden_ssim = 0.98;
+
+// Background color
+Uint8 bg_r = 0;
+Uint8 bg_g = 0;
+Uint8 bg_b = 0;
+
+// Brush for editing the heightmap (toggled with B key)
+#define BRUSH_RAISE  1
+#define BRUSH_LOWER  2
+#define BRUSH_SMOOTH 3
+bool brush_active = false;
+// World space radius
+double brush_radius = 1.0;
+// World space height per second at the center of the brush.
+// For smoothing, how much per second to blend toward the neighbors.
+double brush_strength = 2.0;
+
+// Camera and output parameters of a single frame.
+// Taken from the globals of the same names
+//  so that frames can be rendered while the globals change.
+struct View {
+	glm::dvec3 cam_pos;
+	double hang;
+	double vang;
+	double hfov;
+	double ortho_width;
+	int image_plane;
+
+	int width;
+	int height;
+
+	struct MarchParams march;
+	Uint8 bg_r;
+	Uint8 bg_g;
+	Uint8 bg_b;
+	bool beams;
+	bool lighting;
+	int engine;
+	double raster_lod;
+	int aa_samples;
+	double aa_budget;
+	bool vrs;
+	double vrs_x;
+	double vrs_y;
+	double vrs_full;
+	double vrs_half;
+	bool vrs_overlay;
+	bool colormap_bilinear;
+};
+
+// What a pixel's ray hit, as kept in the G-buffer
+//  from which the pixels' colors are resolved
+//  and the edges between pixels are found
+struct PixelHit {
+	// Index into `terrains`, -1 for none
+	int terrain;
+	int gridx;
+	int gridy;
+	// Distance along the ray, 0 if not known
+	double t;
+	// March steps taken, 0 if the engine did not march
+	int steps;
+};
+
+// Beam parameters of the tiles of a view, from which the marches
+//  of the rays in each tile can start
+struct BeamTiles {
+	int columns;
+	// Negative for the tiles not traced yet
+	std::vector<double> starts;
+
+	// What the tiles were traced for.
+	// They are kept while neither the camera nor the terrains change,
+	//  so that interlaced frames of a still camera trace each tile once.
+	struct View view;
+	long long terrain_version;
+};
+
+// What is worked out once per view before rendering its pixels
+struct ViewPrep {
+	// Only columns [span_first[h], span_last[h]] of row h
+	//  can see a terrain's bounding box. The rest are sky.
+	// Empty if the projection cannot tell.
+	std::vector<int> span_first;
+	std::vector<int> span_last;
+
+	// Whether `tiles` is used
+	bool beams;
+	struct BeamTiles tiles;
+
+	// Whether the engine found what the pixels of rows [found_y0, ...) see,
+	//  in found_terrain and found_cell as written by SplatTerrains
+	bool found;
+	int found_y0;
+	std::vector<int> found_terrain;
+	std::vector<int> found_cell;
+
+	// Scratch space of the engines and of RefineEdges,
+	//  kept so that preparing a view like the last one does not allocate
+	std::vector<double> found_depth;
+	struct RasterBuffers raster;
+	std::vector<int> edges;
+};
+
+// An image plane of each projection, kept from frame to frame
+//  so that setting up the camera of a frame does not allocate
+struct Cameras {
+	Perspective perspective;
+	Spherical spherical;
+	Orthographic orthographic;
+
+	// Placeholders until SetImagePlane
+	Cameras():
+		perspective(glm::dvec3(0.0), glm::dvec3(1.0, 0.0, 0.0),
+			glm::dvec3(0.0, 0.0, 1.0), 1.0, 1.0),
+		spherical(glm::dvec3(0.0), 0.0, M_PI / 2.0, 1.0, 1.0),
+		orthographic(glm::dvec3(0.0), glm::vec3(1.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), 1.0, 1, 1)
+	{}
+};
+
+// A line of text drawn over the window,
+//  rendered again only when the text changes
+struct TextOverlay {
+	std::string text;
+	// NULL if there is no text
+	SDL_Texture *tex;
+	int w;
+	int h;
+};
+
+// Images loaded by a background thread for the console
+//  `heightmap` and `colormap` options.
+// An empty path means keep the current image.
+struct AssetLoad {
+	std::string heightmap_path;
+	std::string colormap_path;
+
+	// Parameters that `heightmap_buf` is converted with
+	struct HeightParams params;
+	// Whether to bake `heightmap_light`, and with what
+	bool lighting;
+	double grid_width;
+	struct Sun sun;
+
+	// Results, owned by this until swapped in
+	const unsigned char *base_heightmap_buf;
+	double *heightmap_buf;
+	MaxMip *heightmap_mip;
+	TerrainLight *heightmap_light;
+	int heightmap_width;
+	int heightmap_height;
+	const unsigned char *colormap_buf;
+	int colormap_width;
+	int colormap_height;
+
+	// Empty unless the load failed
+	std::string error;
+
+	// Percent done, for the overlay
+	SDL_atomic_t progress;
+	// Nonzero when the thread is finished with this
+	SDL_atomic_t done;
+};
+
+// Whether `heightmap` and `colormap` are loaded in the background.
+// Set once the window is open. The config file is loaded before then.
+bool load_assets_async = false;
+// Where config statements that fail to load an image report why,
+//  keeping what was loaded before, or NULL to exit instead.
+// Set while serving so that a client's typo does not stop the server.
+std::string *config_error = NULL;
+// The load in progress and its thread, or NULL
+struct AssetLoad *asset_load = NULL;
+SDL_Thread *asset_load_thread = NULL;
+// Paths requested while a load was in progress.
+// Loaded when it finishes.
+std::string queued_heightmap_path;
+std::string queued_colormap_path;
+// Shown on the overlay until `asset_status_until_ms`
+std::string asset_status;
+Uint32 asset_status_until_ms = 0;
+
+// A frame of a heightmap sequence, decoded and converted
+//  by the sequence thread.
+struct SequenceFrame {
+	// Position in playback order. Keeps counting past the number
+	//  of paths as the sequence loops.
+	int index;
+
+	// Same layouts as the globals of the same names.
+	// NULL if the image failed to load.
+	const unsigned char *base_heightmap_buf;
+	double *heightmap_buf;
+	MaxMip *mip;
+	TerrainLight *light;
+	int width;
+	int height;
+
+	// Parameters that `heightmap_buf` is converted with
+	struct HeightParams params;
+};
+
+// Heightmaps played back in place of the heightmap
+//  with the `heightmap_sequence` option.
+struct HeightmapSequence {
+	std::string source;
+	std::vector<std::string> paths;
+
+	// Guards the members up to `thread`
+	SDL_mutex *mutex;
+	// Signalled when a frame is added to or taken from `ring`
+	SDL_cond *changed;
+	// Frames decoded ahead, in index order, at most `prefetch` of them
+	std::deque<struct SequenceFrame> ring;
+	int prefetch;
+	// Parameters to convert the next frames with
+	//  and to bake their light with if `lighting`
+	struct HeightParams params;
+	bool lighting;
+	double grid_width;
+	struct Sun sun;
+	// Index of the frame due now. Frames before it are not decoded.
+	int due;
+	// Set to end the thread
+	bool stop;
+	// Decoding stats
+	int decoded;
+	double decode_ms_total;
+	double decode_ms_max;
+	int skipped;
+
+	SDL_Thread *thread;
+
+	// Used by the main thread only
+	// Playback position in frames
+	double position;
+	// Index of the frame swapped in last, or -1
+	int shown;
+	// Rendered frames where the due frame was not decoded yet
+	int late;
+	int max_lag;
+	// Frames that failed to load
+	int rejected;
+};
+
+// The sequence playing, or NULL
+struct HeightmapSequence *sequence = NULL;
+// Source requested with `heightmap_sequence` ("none" to stop),
+//  started or stopped by the main loop.
+std::string sequence_source = "none";
+bool sequence_source_changed = false;
+// Playback rate in frames per second
+double sequence_fps = 10.0;
+// How many frames to decode ahead
+int sequence_prefetch = 8;
+
+// Local worker processes that render tiles in --batch mode with --workers.
+// Empty when rendering in this process only.
+std::vector<struct ChildProcess> workers;
+// Config statements that changed the terrain since the config file,
+//  replayed to replacement workers.
+std::string worker_statements;
+// How many times dead workers may be replaced
+int worker_respawns_left = 0;
+
+// argv[0] and argv[1]
+std::string program_name;
+std::string config_path;
+
+// Messages from coordinator to worker.
+// Each is an int type followed by the type's payload.
+#define WORKER_MSG_CONFIG 1 // int length, then that many chars of config
+#define WORKER_MSG_TILE   2 // struct TileJob
+
+// Rows per tile handed to a worker
+#define WORKER_TILE_ROWS 16
+
+// Rows [y0, y0 + rows) of a frame
+struct TileJob {
+	int frame;
+	int y0;
+	int rows;
+	struct View view;
+};
+
+// Sent back by a worker, followed by rows * width RGBA pixels
+struct TileResult {
+	int frame;
+	int y0;
+	int rows;
+	int width;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Helper/utility functions
+//////////////////////////////////////////////////////////////////////////////
+
+template<class T>
+static T Clamp(const T value, const T min, const T max) {
+	if (value < min) return min;
+	if (value > max) return max;
+
+	return value;
+}
+
+template<class T>
+static T Lerp(const double prop, T v0, T v1) {
+	return v0 + prop * (v1 - v0);
+}
+
+static double DegreesToRads(const double degrees) {
+	return (degrees / 180.0) * M_PI;
+}
+
+static double RadsToDegrees(const double rads) {
+	return (rads / M_PI) * 180.0;
+}
+
+static void SetPixel(
+	Uint8 *const pixel,
+	const Uint8 r,
+	const Uint8 g,
+	const Uint8 b,
+	const Uint8 a)
+{
+	pixel[0] = r;
+	pixel[1] = g;
+	pixel[2] = b;
+	pixel[3] = a;
+}
+
+// Save given RGBA frame buffer as .png image at given path.
+static void SavePNG(
+	Uint8 *framebuf,
+	const int width,
+	const int height,
+	std::string path)
+{
+	const int code = stbi_write_png(path.c_str(),
+		width, height, 4,
+		framebuf, width * 4);
+
+	if (code == 0) {
+		std::cerr << "Failed to write screenshot to " << path << "\n";
+	}
+	else {
+		std::cout << "Saved screenshot at " << path << "\n";
+	}
+}
+
+// Write raw native-endian 32-bit floats to `path`
+static void SaveFloats(const std::vector<float> &values, const std::string &path) {
+	std::FILE *const file = std::fopen(path.c_str(), "wb");
+
+	if (file == NULL
+		|| std::fwrite(&values[0], sizeof(float), values.size(), file)
+		   != values.size())
+	{
+		std::cerr << "Failed to write G-buffer to " << path << "\n";
+	}
+	else {
+		std::cout << "Saved G-buffer at " << path << "\n";
+	}
+
+	if (file != NULL) {
+		std::fclose(file);
+	}
+}
+
+// Write the depth and texel of each pixel in the G-buffer
+//  next to the screenshot at `path` (which ends in .png):
+//  one float per pixel to _depth.raw
+//  (the distance along the ray, infinity for none and 0 if not known)
+//  and three to _texel.raw
+//  (the terrain's index, gridx and gridy, all -1 for none),
+//  row by row from the top.
+static void SaveGBuffer(
+	const struct PixelHit *gbuffer,
+	const int width,
+	const int height,
+	const std::string &path)
+{
+	const size_t count = (size_t)width * height;
+	const std::string base = path.substr(0, path.size() - 4);
+
+	std::vector<float> depth(count);
+	std::vector<float> texel(count * 3);
+
+	for (size_t i = 0; i < count; ++i) {
+		const struct PixelHit &hit = gbuffer[i];
+
+		if (hit.terrain >= 0) {
+			depth[i] = (float)hit.t;
+			texel[i * 3 + 0] = (float)hit.terrain;
+			texel[i * 3 + 1] = (float)hit.gridx;
+			texel[i * 3 + 2] = (float)hit.gridy;
+		}
+		else {
+			depth[i] = std::numeric_limits<float>::infinity();
+			texel[i * 3 + 0] = -1.0f;
+			texel[i * 3 + 1] = -1.0f;
+			texel[i * 3 + 2] = -1.0f;
+		}
+	}
+
+	SaveFloats(depth, base + "_depth.raw");
+	SaveFloats(texel, base + "_texel.raw");
+}
+
+// The global parameters for converting heightmap pixels to heights
+static struct HeightParams CurrentHeightParams() {
+	struct HeightParams params;
+
+	params.lum_r = lum_r;
+	params.lum_g = lum_g;
+	params.lum_b = lum_b;
+	params.min_height = min_height;
+	params.max_height = max_height;
+
+	return params;
+}
+
+// The global parameters of the sun
+static struct Sun CurrentSun() {
+	struct Sun sun;
+
+	sun.azimuth = sun_azimuth;
+	sun.elevation = sun_elevation;
+	sun.ambient = ambient;
+
+	return sun;
+}
+
+// Convert the `width` x `height` pixels of `base` into `*heights`
+//  and build their max mip `*mip`, allocating them if NULL,
+//  unless they are already converted with `params`.
+// Their light `*light` is allocated empty if NULL,
+//  and emptied if they are converted again.
+static void RefreshHeights(
+	const unsigned char *const base,
+	const int width,
+	const int height,
+	const struct HeightParams &params,
+	double **const heights,
+	struct HeightParams *const heights_params,
+	MaxMip **const mip,
+	TerrainLight **const light)
+{
+	if (*light == NULL) {
+		*light = new TerrainLight;
+	}
+
+	if (*heights == NULL) {
+		*heights = new double[width * height];
+	}
+	else if (*heights_params == params && *mip != NULL) {
+		return;
+	}
+
+	if (*mip == NULL) {
+		*mip = new MaxMip;
+	}
+
+	ConvertHeights(base, width * height, params, *heights, true);
+	*heights_params = params;
+	(*mip)->Build(*heights, width, height);
+	(*light)->Clear();
+	terrain_version += 1;
+}
+
+static void UpdateInstanceHeightmap(struct TerrainInstance *inst) {
+	struct HeightParams params = CurrentHeightParams();
+	params.min_height = inst->min_height;
+	params.max_height = inst->max_height;
+
+	RefreshHeights(inst->base_heightmap_buf, inst->width, inst->height,
+		params, &inst->heightmap_buf, &inst->heightmap_params,
+		&inst->mip, &inst->light);
+}
+
+// Update `heightmap_buf` and those of the instances
+//  using the current global parameters.
+// Cheap when the parameters have not changed, so it can be called
+//  every frame while animating them.
+static void UpdateHeightmap() {
+	RefreshHeights(base_heightmap_buf, heightmap_width, heightmap_height,
+		CurrentHeightParams(), &heightmap_buf, &heightmap_params,
+		&heightmap_mip, &heightmap_light);
+
+	for (size_t i = 0; i < instances.size(); ++i) {
+		UpdateInstanceHeightmap(&instances[i]);
+	}
+}
+
+// Replace the procedural tiles at the end of `terrains`
+//  with those `procedural` shows, if any, and rebuild the BVH
+static void ShowProceduralTiles() {
+	terrains.resize(procedural_first);
+
+	if (procedural != NULL) {
+		const struct ProceduralParams &params = procedural->params;
+		const double tile_size = params.tile_cells * params.grid_width;
+
+		for (size_t i = 0; i < procedural->shown.size(); ++i) {
+			struct ProceduralTile &tile = *procedural->shown[i];
+
+			struct Terrain t;
+			t.heights = &tile.heights[0];
+			t.colors = &tile.colors[0];
+			t.color_blocks = NULL;
+			t.mip = &tile.mip;
+			t.light = &tile.light;
+			t.width = tile.cells;
+			t.height = tile.cells;
+			t.color_width = tile.cells;
+			t.color_height = tile.cells;
+			t.grid_width = tile_size / tile.cells;
+			SetTerrainBounds(&t, tile.x * tile_size, -tile.y * tile_size,
+				params.min_height, tile.max_z);
+			terrains.push_back(t);
+		}
+	}
+
+	terrain_bvh.Build(terrains);
+	terrain_version += 1;
+}
+
+// Compress the colors `*buf` (loaded from `path`) into `*blocks`
+//  or load them back, as `colormap_compress` says
+static void UpdateColorStorage(
+	const std::string &path,
+	const int width,
+	const int height,
+	const unsigned char **const buf,
+	ColorBlocks *const blocks)
+{
+	if (colormap_compress && *buf != NULL) {
+		blocks->Build(*buf, width, height);
+		stbi_image_free((void*)*buf);
+		*buf = NULL;
+	}
+	else if (!colormap_compress && *buf == NULL && !blocks->Empty()) {
+		int w;
+		int h;
+		int n;
+		unsigned char *rgba = stbi_load(path.c_str(), &w, &h, &n, 4);
+
+		if (rgba == NULL || w != width || h != height) {
+			std::cerr
+				<< "WARNING: Failed to load colormap back from " << path
+				<< ", using its compressed colors\n";
+			stbi_image_free(rgba);
+
+			// Freed with stbi_image_free() like a loaded image
+			rgba = (unsigned char*)std::malloc((size_t)width * height * 4);
+			blocks->Decode(rgba);
+		}
+
+		*buf = rgba;
+		blocks->Clear();
+	}
+}
+
+// Rebuild `terrains` and `terrain_bvh` from the current global parameters.
+static void UpdateTerrains() {
+	UpdateColorStorage(colormap_path, colormap_width, colormap_height,
+		&colormap_buf, &colormap_blocks);
+
+	for (size_t i = 0; i < instances.size(); ++i) {
+		struct TerrainInstance &inst = instances[i];
+
+		UpdateColorStorage(inst.colormap_path,
+			inst.color_width, inst.color_height,
+			&inst.colormap_buf, &inst.color_blocks);
+	}
+
+	terrains.clear();
+
+	struct Terrain t;
+	t.heights = heightmap_buf;
+	t.colors = colormap_buf;
+	t.color_blocks = &colormap_blocks;
+	t.mip = heightmap_mip;
+	t.light = heightmap_light;
+	t.width = heightmap_width;
+	t.height = heightmap_height;
+	t.color_width = colormap_width;
+	t.color_height = colormap_height;
+	t.grid_width = grid_width;
+	SetTerrainBounds(&t, 0.0, 0.0, min_height, max_height);
+	terrains.push_back(t);
+
+	for (size_t i = 0; i < instances.size(); ++i) {
+		const struct TerrainInstance &inst = instances[i];
+
+		t.heights = inst.heightmap_buf;
+		t.colors = inst.colormap_buf;
+		t.color_blocks = &inst.color_blocks;
+		t.mip = inst.mip;
+		t.light = inst.light;
+		t.width = inst.width;
+		t.height = inst.height;
+		t.color_width = inst.color_width;
+		t.color_height = inst.color_height;
+		t.grid_width = inst.grid_width;
+		SetTerrainBounds(&t, inst.x, inst.y, inst.min_height, inst.max_height);
+		terrains.push_back(t);
+	}
+
+	procedural_first = terrains.size();
+	ShowProceduralTiles();
+}
+
+// Bake the light of the terrains that do not have it yet,
+//  such as when lighting was just turned on,
+//  or rebake what depends on the sun if it moved.
+// Loaded terrains come with their light baked if lighting was on.
+static void EnsureTerrainLights() {
+	const struct Sun sun = CurrentSun();
+
+	for (size_t i = 0; i < terrains.size(); ++i) {
+		const struct Terrain &t = terrains[i];
+
+		if (t.light->BuiltFor(t.heights, t.width, t.height, t.grid_width)) {
+			t.light->SetSun(sun);
+		}
+		else {
+			t.light->Build(t.heights, t.width, t.height, t.grid_width, sun);
+		}
+	}
+}
+
+static void FreeInstances() {
+	for (size_t i = 0; i < instances.size(); ++i) {
+		stbi_image_free((void*)instances[i].base_heightmap_buf);
+		delete[] instances[i].heightmap_buf;
+		delete instances[i].mip;
+		delete instances[i].light;
+		stbi_image_free((void*)instances[i].colormap_buf);
+	}
+
+	instances.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Rendering
+//////////////////////////////////////////////////////////////////////////////
+
+// View of the current global parameters
+static struct View CurrentView() {
+	struct View view;
+
+	view.cam_pos = cam_pos;
+	view.hang = hang;
+	view.vang = vang;
+	view.hfov = hfov;
+	view.ortho_width = ortho_width;
+	view.image_plane = image_plane;
+	view.width = screen_width;
+	view.height = screen_height;
+	view.march.step_dist = step_dist;
+	view.march.adaptive = step_adaptive;
+	view.march.step_min = step_min;
+	view.march.step_growth = step_growth;
+	view.march.refine_iters = refine_iters;
+	view.bg_r = bg_r;
+	view.bg_g = bg_g;
+	view.bg_b = bg_b;
+	view.beams = use_beams;
+	view.lighting = use_lighting;
+	view.engine = render_engine;
+	view.raster_lod = raster_lod;
+	view.aa_samples = aa_samples;
+	view.aa_budget = aa_budget;
+	view.vrs = use_vrs;
+	view.vrs_x = vrs_x;
+	view.vrs_y = vrs_y;
+	view.vrs_full = vrs_full;
+	view.vrs_half = vrs_half;
+	view.vrs_overlay = vrs_overlay;
+	view.colormap_bilinear = colormap_bilinear;
+
+	return view;
+}
+
+// View of the current global parameters for saving to a file
+static struct View CaptureView() {
+	struct View view = CurrentView();
+
+	view.aa_samples = aa_capture_samples;
+	view.vrs = false;
+
+	return view;
+}
+
+// Interpolate the camera between two views.
+// Everything else is taken from v1.
+static struct View LerpView(
+	const double prop,
+	const struct View &v0,
+	const struct View &v1)
+{
+	struct View view = v1;
+
+	view.cam_pos = Lerp(prop, v0.cam_pos, v1.cam_pos);
+	view.hang = Lerp(prop, v0.hang, v1.hang);
+	view.vang = Lerp(prop, v0.vang, v1.vang);
+	view.hfov = Lerp(prop, v0.hfov, v1.hfov);
+	view.ortho_width = Lerp(prop, v0.ortho_width, v1.ortho_width);
+
+	return view;
+}
+
+// Set `look` and `up` to the directions of the view's camera
+static void ViewAxes(
+	const struct View &view,
+	glm::dvec3 *const look,
+	glm::dvec3 *const up)
+{
+	// Converting spherical coordinates to a vector
+	// r = 1 so not shown and no need to normalize the vector
+	*look = glm::dvec3(
+		sin(view.vang) * cos(view.hang),
+		sin(view.vang) * sin(view.hang),
+		cos(view.vang)
+	);
+
+	double up_vang = view.vang - (M_PI / 2.0);
+	*up = glm::dvec3(
+		sin(up_vang) * cos(view.hang),
+		sin(up_vang) * sin(view.hang),
+		cos(up_vang)
+	);
+}
+
+// Caller must `delete` the returned ImagePlane.
+static ImagePlane *NewImagePlane(const struct View &view) {
+	glm::dvec3 look;
+	glm::dvec3 up;
+	ViewAxes(view, &look, &up);
+
+	if (view.image_plane == IMAGEPLANE_PERSPECTIVE) {
+		return new Perspective(view.cam_pos, look, up, view.hfov,
+			(double)view.width / view.height);
+	}
+	else if (view.image_plane == IMAGEPLANE_SPHERICAL) {
+		return new Spherical(view.cam_pos, view.hang, view.vang, view.hfov,
+			(double)view.width / view.height);
+	}
+	else {
+		return new Orthographic(view.cam_pos, look, up, view.ortho_width,
+			view.width, view.height);
+	}
+}
+
+// Like NewImagePlane, but sets up the camera of `cameras`
+//  for the view's projection and returns it
+static ImagePlane *SetImagePlane(
+	const struct View &view,
+	struct Cameras *const cameras)
+{
+	glm::dvec3 look;
+	glm::dvec3 up;
+	ViewAxes(view, &look, &up);
+
+	if (view.image_plane == IMAGEPLANE_PERSPECTIVE) {
+		cameras->perspective = Perspective(view.cam_pos, look, up, view.hfov,
+			(double)view.width / view.height);
+		return &cameras->perspective;
+	}
+	else if (view.image_plane == IMAGEPLANE_SPHERICAL) {
+		cameras->spherical = Spherical(view.cam_pos, view.hang, view.vang,
+			view.hfov, (double)view.width / view.height);
+		return &cameras->spherical;
+	}
+	else {
+		cameras->orthographic = Orthographic(view.cam_pos, look, up,
+			view.ortho_width, view.width, view.height);
+		return &cameras->orthographic;
+	}
+}
+
+// Whether the views have the same camera and steps,
+//  and so the same beams
+static bool SameBeams(const struct View &a, const struct View &b) {
+	return a.cam_pos == b.cam_pos
+		&& a.hang == b.hang
+		&& a.vang == b.vang
+		&& a.hfov == b.hfov
+		&& a.ortho_width == b.ortho_width
+		&& a.image_plane == b.image_plane
+		&& a.width == b.width
+		&& a.height == b.height
+		&& a.march.step_dist == b.march.step_dist;
+}
+
+// Whether any pixel of columns [w0, w1] of rows [h0, h1] of the view
+//  has an index that is `phase` modulo `period`
+static bool TileRendered(
+	const struct View &view,
+	const int w0,
+	const int h0,
+	const int w1,
+	const int h1,
+	const int period,
+	const int phase)
+{
+	for (int h = h0; h <= h1; ++h) {
+		const int first = w0
+			+ ((phase - (w0 + h * view.width)) % period + period) % period;
+
+		if (first <= w1) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Trace the beams of the tiles covering rows [y0, y0 + rows) of the view
+//  that have pixels whose index is `phase` modulo `period`,
+//  unless they were traced for the same view and terrains before.
+// Returns false if the view's projection does not support beams.
+static bool TraceBeams(
+	const struct View &view,
+	ImagePlane *const ip,
+	const int y0,
+	const int rows,
+	const int period,
+	const int phase,
+	struct BeamTiles *const tiles)
+{
+	struct Beam beam;
+	if (!ip->GetBeam(0.0, 0.0, 0.0, 0.0, &beam)) {
+		return false;
+	}
+
+	const int columns = (view.width + BEAM_TILE - 1) / BEAM_TILE;
+	const int tile_rows = (view.height + BEAM_TILE - 1) / BEAM_TILE;
+	const int ty0 = y0 / BEAM_TILE;
+	const int ty1 = std::min((y0 + rows - 1) / BEAM_TILE, tile_rows - 1);
+
+	if (tiles->starts.size() != (size_t)columns * tile_rows
+		|| tiles->terrain_version != terrain_version
+		|| !SameBeams(tiles->view, view))
+	{
+		tiles->columns = columns;
+		tiles->starts.assign((size_t)columns * tile_rows, -1.0);
+		tiles->view = view;
+		tiles->terrain_version = terrain_version;
+	}
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = ty0 * columns; i < (ty1 + 1) * columns; ++i) {
+		if (tiles->starts[i] >= 0.0) {
+			continue;
+		}
+
+		const int tx = i % columns;
+		const int ty = i / columns;
+
+		const int w0 = tx * BEAM_TILE;
+		const int h0 = ty * BEAM_TILE;
+		const int w1 = std::min(w0 + BEAM_TILE, view.width) - 1;
+		const int h1 = std::min(h0 + BEAM_TILE, view.height) - 1;
+
+		if (period > 1
+			&& !TileRendered(view, w0, h0, w1, h1, period, phase))
+		{
+			continue;
+		}
+
+		struct Beam tile_beam;
+		ip->GetBeam(
+			(double)w0 / (view.width - 1), (double)h0 / (view.height - 1),
+			(double)w1 / (view.width - 1), (double)h1 / (view.height - 1),
+			&tile_beam);
+
+		tiles->starts[i] =
+			BeamStart(tile_beam, terrains, view.march.step_dist);
+	}
+
+	return true;
+}
+
+// Find the columns of each row that can see a terrain's bounding box
+//  by projecting the boxes into the view.
+static void FindSpans(
+	const struct View &view,
+	ImagePlane *const ip,
+	std::vector<int> *const span_first,
+	std::vector<int> *const span_last)
+{
+	span_first->assign(view.height, view.width);
+	span_last->assign(view.height, -1);
+
+	for (size_t i = 0; i < terrains.size(); ++i) {
+		double w0;
+		double h0;
+		double w1;
+		double h1;
+
+		if (!ip->ScreenBounds(terrains[i].c0, terrains[i].c1,
+			&w0, &h0, &w1, &h1))
+		{
+			span_first->clear();
+			span_last->clear();
+			return;
+		}
+
+		if (w0 > w1 || h0 > h1) {
+			continue;
+		}
+
+		// To pixels, with a pixel to spare for rounding,
+		//  clamped before converting so that huge values do not overflow
+		const double max_x = view.width - 1;
+		const double max_y = view.height - 1;
+		const int x0 = (int)Clamp<double>(
+			std::floor(w0 * max_x) - 1.0, 0.0, max_x);
+		const int x1 = (int)Clamp<double>(
+			std::ceil(w1 * max_x) + 1.0, -1.0, max_x);
+		const int y0 = (int)Clamp<double>(
+			std::floor(h0 * max_y) - 1.0, 0.0, max_y);
+		const int y1 = (int)Clamp<double>(
+			std::ceil(h1 * max_y) + 1.0, -1.0, max_y);
+
+		for (int y = y0; y <= y1; ++y) {
+			(*span_first)[y] = std::min((*span_first)[y], x0);
+			(*span_last)[y] = std::max((*span_last)[y], x1);
+		}
+	}
+}
+
+// Work out what is needed to render rows [y0, y0 + rows) of the view,
+//  or only their pixels whose index is `phase` modulo `period`
+//  where that saves work
+static void PrepareView(
+	const struct View &view,
+	ImagePlane *const ip,
+	const int y0,
+	const int rows,
+	struct ViewPrep *const prep,
+	const int period = 1,
+	const int phase = 0)
+{
+	prep->found = false;
+
+	if (view.lighting) {
+		EnsureTerrainLights();
+	}
+
+	const bool splat = view.engine == ENGINE_SPLAT
+		&& view.image_plane == IMAGEPLANE_ORTHOGRAPHIC;
+	const bool raster = view.engine == ENGINE_RASTER
+		&& view.image_plane == IMAGEPLANE_PERSPECTIVE;
+
+	if (splat || raster) {
+		prep->found_y0 = y0;
+		prep->found_terrain.resize(rows * view.width);
+		prep->found_cell.resize(rows * view.width);
+	}
+
+	if (splat) {
+		prep->found_depth.resize(rows * view.width);
+
+		prep->found = SplatTerrains(*static_cast<Orthographic*>(ip),
+			terrains, view.width, view.height, y0, rows,
+			&prep->found_terrain[0], &prep->found_cell[0],
+			&prep->found_depth[0]);
+	}
+	else if (raster) {
+		RasterTerrains(*static_cast<Perspective*>(ip),
+			terrains, view.raster_lod,
+			view.width, view.height, y0, rows,
+			&prep->found_terrain[0], &prep->found_cell[0], &prep->raster);
+		prep->found = true;
+	}
+
+	// Nothing left to trace
+	if (prep->found) {
+		prep->span_first.clear();
+		prep->span_last.clear();
+		prep->beams = false;
+		return;
+	}
+
+	FindSpans(view, ip, &prep->span_first, &prep->span_last);
+
+	prep->beams = view.beams
+		&& TraceBeams(view, ip, y0, rows, period, phase, &prep->tiles);
+}
+
+// Whether the terrain's color of a cell is simply the cell's texel
+//  of its colormap, so that where in the cell a ray hits does not matter
+static bool ColorsMatchHeights(
+	const struct Terrain &terrain,
+	const struct View &view)
+{
+	return !view.colormap_bilinear
+		&& terrain.colors != NULL
+		&& terrain.color_width == terrain.width
+		&& terrain.color_height == terrain.height;
+}
+
+// Write to `*u` and `*v` the grid coordinates of the point at distance `t`
+//  along the ray, which hit cell (gridx, gridy) of the terrain there,
+//  or of the cell's center if `t` is 0 (not known)
+static void HitGridCoords(
+	const struct Terrain &terrain,
+	const struct Ray &ray,
+	const int gridx,
+	const int gridy,
+	const double t,
+	double *const u,
+	double *const v)
+{
+	if (t <= 0.0) {
+		*u = gridx + 0.5;
+		*v = gridy + 0.5;
+		return;
+	}
+
+	const glm::dvec3 p = ray.pos + t * ray.dir;
+
+	// Kept in the cell in case the distance is a step past it
+	*u = Clamp<double>(
+		(p.x - terrain.c0.x) / terrain.grid_width, gridx, gridx + 1.0);
+	*v = Clamp<double>(
+		(terrain.c0.y - p.y) / terrain.grid_width, gridy, gridy + 1.0);
+}
+
+// Write to `pixel` the RGBA color of a ray hitting cell `cell`
+//  of terrain `terrain` at grid coordinates (u, v), or if -1, of the sky
+//  seen by a ray whose direction has z component `dir_z`.
+static void ShadeHit(
+	Uint8 *const pixel,
+	const struct View &view,
+	const int terrain,
+	const int cell,
+	const double u,
+	const double v,
+	const double dir_z)
+{
+	if (terrain >= 0) {
+		const struct Terrain &hit = terrains[terrain];
+
+		// Resampled only when the colormap's grid differs
+		Uint8 sample[4];
+		const unsigned char *color = hit.colors + cell * 4;
+
+		if (!ColorsMatchHeights(hit, view)) {
+			TerrainColor(hit, u, v, view.colormap_bilinear, sample);
+			color = sample;
+		}
+
+		// Draw
+		if (color[3] == 0) {
+			SetPixel(pixel,
+				view.bg_r, view.bg_g, view.bg_b,
+				255);
+		}
+		else if (view.lighting) {
+			const int light = hit.light->Level(cell);
+
+			SetPixel(pixel,
+				(Uint8)((color[0] * light + 127) / 255),
+				(Uint8)((color[1] * light + 127) / 255),
+				(Uint8)((color[2] * light + 127) / 255),
+				255);
+		}
+		else {
+			SetPixel(pixel,
+				color[0],
+				color[1],
+				color[2],
+				255);
+		}
+	}
+	else {
+		// Sky-like effect
+		if (dir_z > 0.0) {
+			const double r_ = 220.0 * std::pow(dir_z, 2) + view.bg_r;
+			const double g_ = 240.0 * std::pow(dir_z, 2) + view.bg_g;
+			const double b_ = 255.0 * dir_z              + view.bg_b;
+
+			SetPixel(pixel,
+				(Uint8)std::floor(Clamp<double>(r_, 0.0, 255.0)),
+				(Uint8)std::floor(Clamp<double>(g_, 0.0, 255.0)),
+				(Uint8)std::floor(Clamp<double>(b_, 0.0, 255.0)),
+				255);
+		}
+		else {
+			SetPixel(pixel,
+				view.bg_r, view.bg_g, view.bg_b, 255);
+		}
+	}
+}
+
+// Cast the ray for pixel (w, h) of the view (or look up what the engine found)
+//  and write what it hit to `*pixel_hit`.
+// The steps saved by the pixel's tile's beam are added to `*skipped`.
+static void MarchPixel(
+	const struct View &view,
+	ImagePlane *const ip,
+	const int w,
+	const int h,
+	const struct ViewPrep &prep,
+	long long *const skipped,
+	struct PixelHit *const pixel_hit)
+{
+	struct Ray ray = ip->GetRay(
+		(double)w / (view.width - 1),
+		(double)h / (view.height - 1)
+	);
+
+	const bool may_hit = prep.span_first.empty()
+		|| (w >= prep.span_first[h] && w <= prep.span_last[h]);
+
+	pixel_hit->terrain = -1;
+	pixel_hit->gridx = 0;
+	pixel_hit->gridy = 0;
+	pixel_hit->t = 0.0;
+	pixel_hit->steps = 0;
+
+	if (prep.found) {
+		const size_t i = (size_t)(h - prep.found_y0) * view.width + w;
+		const int terrain = prep.found_terrain[i];
+
+		if (terrain < 0) {
+			return;
+		}
+
+		const struct Terrain &found = terrains[terrain];
+		const int cell = prep.found_cell[i];
+		const int gridx = cell % found.width;
+		const int gridy = cell / found.width;
+
+		// Where the ray enters the cell's column
+		const double gw = found.grid_width;
+		const glm::dvec3 c0(
+			found.c0.x + gridx * gw, found.c0.y - gridy * gw, found.c0.z);
+		const glm::dvec3 c1(
+			c0.x + gw, c0.y - gw, found.c0.z + found.heights[cell]);
+		const double t = distance(ray, c0, c1);
+
+		pixel_hit->terrain = terrain;
+		pixel_hit->gridx = gridx;
+		pixel_hit->gridy = gridy;
+
+		if (t > 0.0 && t < HUGE_VAL) {
+			pixel_hit->t = t;
+		}
+	}
+	else if (may_hit) {
+		double start = 0.0;
+		if (prep.beams) {
+			const double tile_start = prep.tiles.starts[
+				(h / BEAM_TILE) * prep.tiles.columns + w / BEAM_TILE];
+
+			// Untraced tiles have no pixels to render
+			if (tile_start >= 0.0) {
+				start = ip->BeamDistance(ray, tile_start);
+			}
+		}
+
+		struct TerrainHit hit;
+		long long steps = 0;
+		const int terrain = terrain_bvh.Trace(
+			ray, start, view.march, &hit, skipped, &steps);
+
+		pixel_hit->steps = (int)steps;
+
+		if (terrain >= 0) {
+			pixel_hit->terrain = terrain;
+			pixel_hit->gridx = hit.gridx;
+			pixel_hit->gridy = hit.gridy;
+			pixel_hit->t = hit.t;
+		}
+	}
+}
+
+// Write to `pixel` the RGBA color of pixel (w, h) of the view
+//  from what it hit
+static void ResolvePixel(
+	Uint8 *const pixel,
+	const struct PixelHit &hit,
+	const struct View &view,
+	ImagePlane *const ip,
+	const int w,
+	const int h)
+{
+	if (hit.terrain >= 0) {
+		const struct Terrain &terrain = terrains[hit.terrain];
+		double u = 0.0;
+		double v = 0.0;
+
+		// Only needed to resample the colors
+		if (!ColorsMatchHeights(terrain, view)) {
+			const struct Ray ray = ip->GetRay(
+				(double)w / (view.width - 1),
+				(double)h / (view.height - 1));
+
+			HitGridCoords(terrain, ray, hit.gridx, hit.gridy, hit.t, &u, &v);
+		}
+
+		ShadeHit(pixel, view, hit.terrain,
+			hit.gridx + hit.gridy * terrain.width, u, v, 0.0);
+	}
+	else {
+		const struct Ray ray = ip->GetRay(
+			(double)w / (view.width - 1),
+			(double)h / (view.height - 1));
+
+		ShadeHit(pixel, view, -1, 0, 0.0, 0.0, ray.dir.z);
+	}
+}
+
+// Write to `buf` the RGBA colors of the pixels of rows [y0, y0 + rows)
+//  of the view from what they hit in `gbuffer`,
+//  going through both in order.
+// Only the pixels whose index in the view is `phase` modulo `period`
+//  are resolved.
+static void ResolveRows(
+	Uint8 *const buf,
+	const struct PixelHit *const gbuffer,
+	const struct View &view,
+	ImagePlane *const ip,
+	const int y0,
+	const int rows,
+	const int period,
+	const int phase)
+{
+	const int width = view.width;
+
+	#pragma omp parallel for schedule(static)
+	for (int r = 0; r < rows; ++r) {
+		const int h = y0 + r;
+		int w = ((phase - h * width) % period + period) % period;
+
+		for (; w < width; w += period) {
+			const int i = r * width + w;
+
+			ResolvePixel(buf + i * 4, gbuffer[i], view, ip, w, h);
+		}
+	}
+}
+
+// Element i of the Halton sequence of the base, in [0, 1)
+static double Halton(int i, const int base) {
+	double value = 0.0;
+	double scale = 1.0 / base;
+
+	while (i > 0) {
+		value += scale * (i % base);
+		i /= base;
+		scale /= base;
+	}
+
+	return value;
+}
+
+// Whether neighboring pixels a and b are on different sides of an edge:
+//  different terrains, a big change in color,
+//  or a jump in the grid cell hit with a jump in distance
+//  (so that cells smaller than pixels far away do not count).
+static bool OnEdge(
+	const Uint8 *const a,
+	const struct PixelHit &hit_a,
+	const Uint8 *const b,
+	const struct PixelHit &hit_b)
+{
+	if (hit_a.terrain != hit_b.terrain) {
+		return true;
+	}
+
+	for (int c = 0; c < 3; ++c) {
+		if (std::abs(a[c] - b[c]) > 48) {
+			return true;
+		}
+	}
+
+	if (hit_a.terrain < 0) {
+		return false;
+	}
+
+	if (std::abs(hit_a.gridx - hit_b.gridx) <= 1
+		&& std::abs(hit_a.gridy - hit_b.gridy) <= 1)
+	{
+		return false;
+	}
+
+	if (hit_a.t <= 0.0 || hit_b.t <= 0.0) {
+		return true;
+	}
+
+	return std::fabs(hit_a.t - hit_b.t)
+		> 0.05 * std::min(hit_a.t, hit_b.t);
+}
+
+// Anti-alias the pixels of rows [y0, y0 + rows) of the view in `buf`
+//  (with what they hit in `hits`) that are on edges,
+//  by averaging in extra jittered rays.
+// Only the pixels of rows [first, last) whose index in the view
+//  is `phase` modulo `period` are considered;
+//  the other rows are only used as neighbors.
+// `edges` is scratch space.
+static void RefineEdges(
+	Uint8 *const buf,
+	const struct PixelHit *const hits,
+	const struct View &view,
+	ImagePlane *const ip,
+	const int y0,
+	const int rows,
+	const int first,
+	const int last,
+	const int period,
+	const int phase,
+	std::vector<int> *const edge_buf)
+{
+	const int width = view.width;
+	std::vector<int> &edges = *edge_buf;
+	edges.clear();
+	long long pixels = 0;
+
+	for (int h = first; h < last; ++h) {
+		const int p0 = h * width;
+		int w = ((phase - p0) % period + period) % period;
+
+		for (; w < width; w += period) {
+			const int i = (h - y0) * width + w;
+			const int neighbors[4] = {
+				w > 0 ? i - 1 : -1,
+				w + 1 < width ? i + 1 : -1,
+				h > y0 ? i - width : -1,
+				h + 1 < y0 + rows ? i + width : -1
+			};
+
+			pixels += 1;
+
+			for (int n = 0; n < 4; ++n) {
+				const int j = neighbors[n];
+
+				if (j >= 0 && OnEdge(buf + i * 4, hits[i], buf + j * 4, hits[j])) {
+					edges.push_back(i);
+					break;
+				}
+			}
+		}
+	}
+
+	const int count = (int)edges.size();
+
+	// Spread the budget evenly if the edges need more
+	long long budget = (long long)(view.aa_budget / 100.0 * (double)pixels);
+	budget = std::min(budget, (long long)count * view.aa_samples);
+	long long rays = 0;
+
+	#pragma omp parallel for schedule(dynamic) reduction(+:rays)
+	for (int e = 0; e < count; ++e) {
+		const int samples = (int)(std::min<long long>(AA_MAX_SAMPLES,
+			(e + 1) * budget / count - e * budget / count));
+
+		if (samples <= 0) {
+			continue;
+		}
+
+		const int i = edges[e];
+		const int w = i % width;
+		const int h = y0 + i / width;
+		Uint8 *const pixel = buf + i * 4;
+
+		// Rotate the sequence differently for every pixel
+		const unsigned int hash =
+			(unsigned int)w * 73856093u ^ (unsigned int)h * 19349663u;
+		const double rotate_x = (hash & 0xffff) / 65536.0;
+		const double rotate_y = ((hash >> 16) & 0xffff) / 65536.0;
+
+		int sum[3] = {pixel[0], pixel[1], pixel[2]};
+
+		for (int k = 0; k < samples; ++k) {
+			const double x = Halton(k + 1, 2) + rotate_x;
+			const double y = Halton(k + 1, 3) + rotate_y;
+
+			const struct Ray ray = ip->GetRay(
+				(w + x - std::floor(x) - 0.5) / (view.width - 1),
+				(h + y - std::floor(y) - 0.5) / (view.height - 1));
+
+			struct TerrainHit hit;
+			const int terrain = terrain_bvh.Trace(ray, view.march, &hit);
+
+			int cell = 0;
+			double u = 0.0;
+			double v = 0.0;
+			if (terrain >= 0) {
+				cell = hit.gridx + hit.gridy * terrains[terrain].width;
+				HitGridCoords(terrains[terrain], ray,
+					hit.gridx, hit.gridy, hit.t, &u, &v);
+			}
+
+			Uint8 color[4];
+			ShadeHit(color, view, terrain, cell, u, v, ray.dir.z);
+
+			for (int c = 0; c < 3; ++c) {
+				sum[c] += color[c];
+			}
+		}
+
+		for (int c = 0; c < 3; ++c) {
+			pixel[c] = (Uint8)((sum[c] + (samples + 1) / 2) / (samples + 1));
+		}
+
+		rays += samples;
+	}
+
+	#pragma omp atomic
+	aa_pixels += pixels;
+	#pragma omp atomic
+	aa_edge_pixels += count;
+	#pragma omp atomic
+	aa_rays += rays;
+}
+
+// Pixels per ray across (1, 2 or 4) of the VRS_BLOCK x VRS_BLOCK pixels
+//  that pixel (w, h) of the view is in
+static int ShadingRate(const struct View &view, const int w, const int h) {
+	const double half_width = 0.5 * view.width;
+	const double x = (w / VRS_BLOCK + 0.5) * VRS_BLOCK - view.vrs_x * view.width;
+	const double y = (h / VRS_BLOCK + 0.5) * VRS_BLOCK - view.vrs_y * view.height;
+	const double distance = std::sqrt(x * x + y * y) / half_width;
+
+	if (distance <= view.vrs_full) {
+		return 1;
+	}
+	else if (distance <= view.vrs_half) {
+		return 2;
+	}
+	else {
+		return 4;
+	}
+}
+
+// Whether pixel (w, h) is marched at its shading rate.
+// The last row and column are, so every other pixel lies
+//  between marched ones.
+static bool MarchedAtRate(
+	const struct View &view,
+	const int w,
+	const int h,
+	const int rate)
+{
+	return (w % rate == 0 || w == view.width - 1)
+		&& (h % rate == 0 || h == view.height - 1);
+}
+
+// Whether pixel (w, h) is marched rather than interpolated.
+// Besides those at its own rate, the pixels on the first column
+//  or row of a block are marched at the rate of the block
+//  to the left or above, since they are corners of its pixels too.
+static bool MarchedVariableRate(
+	const struct View &view,
+	const int w,
+	const int h)
+{
+	if (MarchedAtRate(view, w, h, ShadingRate(view, w, h))) {
+		return true;
+	}
+
+	if (w > 0 && w % VRS_BLOCK == 0
+		&& MarchedAtRate(view, w, h, ShadingRate(view, w - 1, h)))
+	{
+		return true;
+	}
+
+	return h > 0 && h % VRS_BLOCK == 0
+		&& MarchedAtRate(view, w, h, ShadingRate(view, w, h - 1));
+}
+
+// Render the whole view into `buf` and its G-buffer into `gbuffer`
+//  with fewer rays away from the point of interest (see `use_vrs`).
+// Pixels between marched ones are interpolated from them
+//  unless the marched ones are on different sides of an edge,
+//  in which case they are marched too.
+// The steps saved by the beams are added to `*skipped`.
+static void RenderVariableRate(
+	Uint8 *const buf,
+	struct PixelHit *const gbuffer,
+	const struct View &view,
+	ImagePlane *const ip,
+	const struct ViewPrep &prep,
+	long long *const skipped)
+{
+	const int width = view.width;
+	const int height = view.height;
+	long long skipped_sum = 0;
+	long long rays = 0;
+	long long steps = 0;
+
+	// March and resolve the pixels at the corners of the rates' blocks
+	#pragma omp parallel for schedule(dynamic) \
+		reduction(+:skipped_sum,rays,steps)
+	for (int h = 0; h < height; ++h) {
+		for (int w = 0; w < width; ++w) {
+			if (MarchedVariableRate(view, w, h)) {
+				MarchPixel(view, ip, w, h, prep, &skipped_sum,
+					&gbuffer[h * width + w]);
+				rays += 1;
+				steps += gbuffer[h * width + w].steps;
+			}
+		}
+
+		for (int w = 0; w < width; ++w) {
+			const int i = h * width + w;
+
+			if (MarchedVariableRate(view, w, h)) {
+				ResolvePixel(buf + i * 4, gbuffer[i], view, ip, w, h);
+			}
+		}
+	}
+
+	// Fill in the rest.
+	// The corners of a pixel are in its block or on the first row or column
+	//  of the blocks after it, all of which the pass above marched,
+	//  so this pass only reads pixels it does not write.
+	#pragma omp parallel for schedule(dynamic) \
+		reduction(+:skipped_sum,rays,steps)
+	for (int h = 0; h < height; ++h) {
+		for (int w = 0; w < width; ++w) {
+			if (MarchedVariableRate(view, w, h)) {
+				continue;
+			}
+
+			const int rate = ShadingRate(view, w, h);
+
+			const int x0 = w - w % rate;
+			const int y0 = h - h % rate;
+			const int x1 = std::min(x0 + rate, width - 1);
+			const int y1 = std::min(y0 + rate, height - 1);
+
+			const int corners[4] = {
+				y0 * width + x0, y0 * width + x1,
+				y1 * width + x0, y1 * width + x1
+			};
+
+			bool edge = false;
+			for (int a = 0; a < 4 && !edge; ++a) {
+				for (int b = a + 1; b < 4 && !edge; ++b) {
+					edge = OnEdge(buf + corners[a] * 4, gbuffer[corners[a]],
+						buf + corners[b] * 4, gbuffer[corners[b]]);
+				}
+			}
+
+			const int i = h * width + w;
+
+			if (edge) {
+				MarchPixel(view, ip, w, h, prep, &skipped_sum, &gbuffer[i]);
+				ResolvePixel(buf + i * 4, gbuffer[i], view, ip, w, h);
+				rays += 1;
+				steps += gbuffer[i].steps;
+
+				continue;
+			}
+
+			const double fx = (double)(w - x0) / (x1 - x0);
+			const double fy = (double)(h - y0) / (y1 - y0);
+			const double weights[4] = {
+				(1.0 - fx) * (1.0 - fy), fx * (1.0 - fy),
+				(1.0 - fx) * fy, fx * fy
+			};
+
+			for (int c = 0; c < 4; ++c) {
+				double value = 0.0;
+
+				for (int k = 0; k < 4; ++k) {
+					value += weights[k] * buf[corners[k] * 4 + c];
+				}
+
+				buf[i * 4 + c] = (Uint8)(value + 0.5);
+			}
+
+			gbuffer[i] = gbuffer[corners[(fy < 0.5 ? 0 : 2) + (fx < 0.5 ? 0 : 1)]];
+		}
+	}
+
+	*skipped += skipped_sum;
+
+	#pragma omp atomic
+	vrs_pixels += (long long)width * height;
+	#pragma omp atomic
+	vrs_rays += rays;
+	#pragma omp atomic
+	hud_march_rays += rays;
+	#pragma omp atomic
+	hud_steps += steps;
+}
+
+// Tint the pixels of the view in `buf` by their shading rate
+static void DrawRateOverlay(Uint8 *const buf, const struct View &view) {
+	#pragma omp parallel for
+	for (int h = 0; h < view.height; ++h) {
+		for (int w = 0; w < view.width; ++w) {
+			const int rate = ShadingRate(view, w, h);
+
+			if (rate == 1) {
+				continue;
+			}
+
+			// Green for 2x2, red for 4x4
+			Uint8 *const pixel = buf + (h * view.width + w) * 4;
+			const int tint_r = rate == 4 ? 255 : 0;
+			const int tint_g = rate == 2 ? 255 : 0;
+
+			SetPixel(pixel,
+				(Uint8)((pixel[0] * 3 + tint_r) / 4),
+				(Uint8)((pixel[1] * 3 + tint_g) / 4),
+				(Uint8)((pixel[2] * 3) / 4),
+				255);
+		}
+	}
+}
+
+// Render a frame of the window's view into `framebuf`,
+//  or with interlacing only its pixels whose index is `phase`
+//  modulo `period`, the rest keeping those of earlier frames.
+// `cameras`, `prep` and `gbuffer` are kept from frame to frame
+//  so that a frame like the last one does not allocate.
+// Sets `*busy` as FrameStats does.
+static void RenderFrame(
+	Uint8 *const framebuf,
+	const struct View &view,
+	const int period,
+	const int phase,
+	struct Cameras *const cameras,
+	struct ViewPrep *const prep,
+	std::vector<struct PixelHit> *const gbuffer,
+	double *const busy)
+{
+	*busy = -1.0;
+
+	ImagePlane *const ip = SetImagePlane(view, cameras);
+
+	PrepareView(view, ip, 0, view.height, prep, period, phase);
+	long long skipped = 0;
+
+	gbuffer->resize((size_t)view.width * view.height);
+	struct PixelHit *const hits = &(*gbuffer)[0];
+
+	// Interlacing already renders fewer pixels
+	if (view.vrs && period == 1) {
+		RenderVariableRate(framebuf, hits, view, ip, *prep, &skipped);
+	}
+	else {
+		long long steps = 0;
+		double busy_seconds = 0.0;
+		int threads = 1;
+		const double loop_start = omp_get_wtime();
+
+		#pragma omp parallel reduction(+:skipped,steps,busy_seconds)
+		{
+			const double thread_start = omp_get_wtime();
+
+			#pragma omp for nowait
+			for (int p = phase; p < view.width * view.height;
+			     p += period)
+			{
+				MarchPixel(view, ip, p % view.width, p / view.width,
+					*prep, &skipped, &hits[p]);
+				steps += hits[p].steps;
+			}
+
+			busy_seconds += omp_get_wtime() - thread_start;
+
+			if (omp_get_thread_num() == 0) {
+				threads = omp_get_num_threads();
+			}
+		}
+
+		const double loop_seconds = omp_get_wtime() - loop_start;
+
+		if (loop_seconds > 0.0) {
+			*busy = busy_seconds / (threads * loop_seconds);
+		}
+
+		hud_march_rays +=
+			(view.width * view.height - phase + period - 1)
+			/ period;
+		hud_steps += steps;
+
+		ResolveRows(framebuf, hits, view, ip,
+			0, view.height, period, phase);
+	}
+
+	if (view.aa_samples > 0) {
+		RefineEdges(framebuf, hits, view, ip,
+			0, view.height, 0, view.height, period, phase,
+			&prep->edges);
+	}
+
+	if (view.vrs && view.vrs_overlay && period == 1) {
+		DrawRateOverlay(framebuf, view);
+	}
+
+	if (prep->beams) {
+		beam_rays +=
+			(view.width * view.height - phase + period - 1)
+			/ period;
+		beam_steps_skipped += skipped;
+	}
+}
+
+static const char *EngineName(const int engine) {
+	if (engine == ENGINE_SPLAT) {
+		return "splat";
+	}
+	else if (engine == ENGINE_RASTER) {
+		return "raster";
+	}
+	else {
+		return "march";
+	}
+}
+
+// Render the whole view into `buf` and its G-buffer into `gbuffer`,
+//  writing how long it took to `*seconds`.
+// Returns whether the view's engine was used rather than marching.
+static bool RenderTimed(
+	Uint8 *const buf,
+	struct PixelHit *const gbuffer,
+	const struct View &view,
+	double *const seconds)
+{
+	const double start = omp_get_wtime();
+
+	ImagePlane *const ip = NewImagePlane(view);
+
+	struct ViewPrep prep;
+	PrepareView(view, ip, 0, view.height, &prep);
+	long long skipped = 0;
+
+	#pragma omp parallel for schedule(dynamic) reduction(+:skipped)
+	for (int h = 0; h < view.height; ++h) {
+		for (int w = 0; w < view.width; ++w) {
+			MarchPixel(view, ip, w, h, prep, &skipped,
+				&gbuffer[(size_t)h * view.width + w]);
+		}
+	}
+
+	ResolveRows(buf, gbuffer, view, ip, 0, view.height, 1, 0);
+
+	if (view.aa_samples > 0) {
+		RefineEdges(buf, gbuffer, view, ip,
+			0, view.height, 0, view.height, 1, 0, &prep.edges);
+	}
+
+	delete ip;
+
+	*seconds = omp_get_wtime() - start;
+
+	return view.engine == ENGINE_MARCH || prep.found;
+}
+
+// Render the current view with the current engine and by marching
+//  and print how much the images differ
+static void CompareEngines() {
+	struct View view = CurrentView();
+	const size_t size = (size_t)view.width * view.height * 4;
+
+	std::vector<Uint8> engine_image(size);
+	std::vector<Uint8> march_image(size);
+	std::vector<struct PixelHit> gbuffer(size / 4);
+
+	double engine_seconds;
+	double march_seconds;
+	const bool used =
+		RenderTimed(&engine_image[0], &gbuffer[0], view, &engine_seconds);
+
+	view.engine = ENGINE_MARCH;
+	RenderTimed(&march_image[0], &gbuffer[0], view, &march_seconds);
+
+	struct ImageDifference difference;
+	CompareImages(&engine_image[0], &march_image[0], view.width, view.height,
+		ENGINE_COMPARE_THRESHOLD, &difference);
+
+	const double percent =
+		100.0 * difference.differing / ((double)view.width * view.height);
+
+	std::cout
+		<< "engine_compare " << EngineName(render_engine)
+		<< (used ? "" : " (not used for this view)")
+		<< " " << engine_seconds * 1000.0 << " ms, march "
+		<< march_seconds * 1000.0 << " ms, "
+		<< percent << "% of pixels differ by more than "
+		<< ENGINE_COMPARE_THRESHOLD
+		<< " (at most " << difference.max_difference << ")\n";
+
+	if (percent > engine_tolerance) {
+		std::cerr
+			<< "WARNING: engine_compare is over the tolerance of "
+			<< engine_tolerance << "%\n";
+		engine_compare_failed += 1;
+	}
+}
+
+// Render the current view the way the window draws its frames,
+//  a whole interlacing cycle to size the buffers and then another,
+//  and print how many allocations the second one made
+static void CheckFrameAllocs() {
+	const struct View view = CurrentView();
+
+	std::vector<Uint8> framebuf((size_t)view.width * view.height * 4);
+	struct Cameras cameras;
+	struct ViewPrep prep;
+	std::vector<struct PixelHit> gbuffer;
+
+	long long allocs = 0;
+
+	for (int pass = 0; pass < 2; ++pass) {
+		const long long allocs_before = AllocCount();
+
+		for (int phase = 0; phase < cycle_period; ++phase) {
+			double busy;
+			RenderFrame(&framebuf[0], view, cycle_period, phase,
+				&cameras, &prep, &gbuffer, &busy);
+		}
+
+		allocs = AllocCount() - allocs_before;
+	}
+
+	// Not rays of the window's frames
+	hud_march_rays = 0;
+	hud_steps = 0;
+
+	std::cout
+		<< "alloc_check " << allocs << " allocations in "
+		<< cycle_period << " frames like the " << cycle_period
+		<< " before them\n";
+
+	if (allocs > 0) {
+		std::cerr << "WARNING: alloc_check found frames that allocate\n";
+		alloc_check_failed += 1;
+	}
+}
+
+// Render the current view by marching with fixed steps, adaptive steps
+//  and fixed steps STEP_COMPARE_FINE times shorter than either,
+//  and print how long the first two took, how many samples per pixel
+//  and how many pixels differ from the finest one
+static void CompareSteps() {
+	struct View view = CurrentView();
+	view.engine = ENGINE_MARCH;
+
+	const size_t size = (size_t)view.width * view.height * 4;
+	const double pixels = (double)view.width * view.height;
+
+	std::vector<Uint8> reference(size);
+	std::vector<Uint8> image(size);
+	std::vector<struct PixelHit> gbuffer(size / 4);
+
+	double seconds;
+	// Finer than the shortest adaptive step on any terrain
+	double finest = step_min;
+	if (finest <= 0.0) {
+		finest = HUGE_VAL;
+
+		for (size_t i = 0; i < terrains.size(); ++i) {
+			finest = std::min(finest, 0.5 * terrains[i].grid_width);
+		}
+	}
+
+	view.march.adaptive = false;
+	view.march.step_dist =
+		std::min(step_dist, finest) / STEP_COMPARE_FINE;
+	RenderTimed(&reference[0], &gbuffer[0], view, &seconds);
+
+	for (int adaptive = 0; adaptive < 2; ++adaptive) {
+		view.march.adaptive = adaptive != 0;
+		view.march.step_dist = step_dist;
+		RenderTimed(&image[0], &gbuffer[0], view, &seconds);
+
+		long long steps = 0;
+		for (size_t i = 0; i < gbuffer.size(); ++i) {
+			steps += gbuffer[i].steps;
+		}
+
+		struct ImageDifference difference;
+		CompareImages(&reference[0], &image[0], view.width, view.height,
+			ENGINE_COMPARE_THRESHOLD, &difference);
+
+		std::cout
+			<< "step_compare " << (adaptive ? "adaptive " : "fixed ")
+			<< seconds * 1000.0 << " ms, "
+			<< (double)steps / pixels << " samples per pixel, "
+			<< 100.0 * difference.differing / pixels
+			<< "% of pixels differ from fine steps by more than "
+			<< ENGINE_COMPARE_THRESHOLD
+			<< " (at most " << difference.max_difference << ")\n";
+	}
+}
+
+// Render rows [y0, y0 + rows) of the view into `buf`.
+// With anti-aliasing, the rows just above and below are rendered too
+//  so that edges between the rows of different workers are found.
+static void RenderRows(
+	Uint8 *const buf,
+	const struct View &view,
+	const int y0,
+	const int rows)
+{
+	ImagePlane *const ip = NewImagePlane(view);
+
+	int first = y0;
+	int last = y0 + rows;
+	if (view.aa_samples > 0) {
+		first = std::max(0, y0 - 1);
+		last = std::min(view.height, y0 + rows + 1);
+	}
+
+	struct ViewPrep prep;
+	PrepareView(view, ip, first, last - first, &prep);
+
+	const size_t row_size = (size_t)view.width * 4;
+	std::vector<Uint8> all_rows((size_t)(last - first) * row_size);
+	std::vector<struct PixelHit> gbuffer((size_t)(last - first) * view.width);
+
+	long long skipped = 0;
+
+	#pragma omp parallel for schedule(dynamic) reduction(+:skipped)
+	for (int r = 0; r < last - first; ++r) {
+		for (int w = 0; w < view.width; ++w) {
+			MarchPixel(view, ip, w, first + r, prep, &skipped,
+				&gbuffer[(size_t)r * view.width + w]);
+		}
+	}
+
+	ResolveRows(&all_rows[0], &gbuffer[0], view, ip,
+		first, last - first, 1, 0);
+
+	if (view.aa_samples > 0) {
+		RefineEdges(&all_rows[0], &gbuffer[0], view, ip,
+			first, last - first, y0, y0 + rows, 1, 0, &prep.edges);
+	}
+
+	std::memcpy(buf, &all_rows[(y0 - first) * row_size], rows * row_size);
+
+	if (prep.beams) {
+		beam_rays += (last - first) * view.width;
+		beam_steps_skipped += skipped;
+	}
+
+	delete ip;
+}
+
+// Render the current view for saving at `width` x `height`
+//  to a binary PPM image at `path`, `poster_band` rows at a time,
+//  writing each band as soon as it is done
+//  so that only one band is in memory at once.
+static void RenderPoster(
+	const int width,
+	const int height,
+	const std::string &path)
+{
+	if (width < 2 || height < 2) {
+		std::cerr << "WARNING: poster must be at least 2x2 pixels\n";
+		return;
+	}
+
+	std::FILE *const file = std::fopen(path.c_str(), "wb");
+
+	if (file == NULL) {
+		std::cerr << "Failed to open poster file: " << path << "\n";
+		return;
+	}
+
+	struct View view = CaptureView();
+	view.width = width;
+	view.height = height;
+
+	std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	const int band = std::min(std::max(poster_band, 1), height);
+	std::vector<Uint8> rgba((size_t)band * width * 4);
+	std::vector<Uint8> rgb((size_t)band * width * 3);
+
+	const double start = omp_get_wtime();
+	bool ok = true;
+
+	for (int y0 = 0; y0 < height && ok; y0 += band) {
+		const int rows = std::min(band, height - y0);
+		const size_t pixels = (size_t)rows * width;
+
+		RenderRows(&rgba[0], view, y0, rows);
+
+		for (size_t i = 0; i < pixels; ++i) {
+			rgb[i * 3 + 0] = rgba[i * 4 + 0];
+			rgb[i * 3 + 1] = rgba[i * 4 + 1];
+			rgb[i * 3 + 2] = rgba[i * 4 + 2];
+		}
+
+		ok = std::fwrite(&rgb[0], 3, pixels, file) == pixels;
+
+		const double seconds = omp_get_wtime() - start;
+		const double done = (double)(y0 + rows) / height;
+
+		std::cout
+			<< "poster " << (y0 + rows) << " of " << height << " rows, "
+			<< seconds << " s, about " << (seconds / done - seconds)
+			<< " s left\n";
+	}
+
+	if (std::fclose(file) != 0 || !ok) {
+		std::cerr << "Failed to write poster to " << path << "\n";
+	}
+	else {
+		std::cout << "Saved poster at " << path << "\n";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Heightmap editing
+//////////////////////////////////////////////////////////////////////////////
+
+// Find the `heightmap_buf` texel seen at pixel (x, y) of the view.
+// Returns false if the ray does not hit that heightmap (e.g. an instance).
+static bool PickHeightmap(
+	const struct View &view,
+	const int x,
+	const int y,
+	int *const gridx,
+	int *const gridy)
+{
+	ImagePlane *const ip = NewImagePlane(view);
+
+	struct Ray ray = ip->GetRay(
+		(double)x / (view.width - 1),
+		(double)y / (view.height - 1)
+	);
+
+	delete ip;
+
+	struct TerrainHit hit;
+
+	// The heightmap is always the first terrain
+	if (terrain_bvh.Trace(ray, view.march, &hit) != 0) {
+		return false;
+	}
+
+	*gridx = hit.gridx;
+	*gridy = hit.gridy;
+
+	return true;
+}
+
+// Update what depends on the texels of `heightmap_buf`
+//  in columns [x0, x1] and rows [y0, y1] after they have been edited.
+static void HeightmapEdited(
+	const int x0,
+	const int y0,
+	const int x1,
+	const int y1)
+{
+	heightmap_mip->Update(x0, y0, x1, y1);
+	terrain_version += 1;
+
+	if (!heightmap_light->Empty()) {
+		heightmap_light->Update(x0, y0, x1, y1);
+	}
+
+	// Write the heights back to the image as grey
+	//  so that edits survive UpdateHeightmap and can be saved.
+	const double lum_sum = lum_r + lum_g + lum_b;
+	const double range = max_height - min_height;
+
+	if (lum_sum <= 0.0 || range <= 0.0) {
+		return;
+	}
+
+	unsigned char *const base = (unsigned char*)base_heightmap_buf;
+
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			const int i = x + y * heightmap_width;
+			const double value =
+				(heightmap_buf[i] - min_height) / range * 255.0;
+			const unsigned char grey = (unsigned char)Clamp<double>(
+				std::floor(value / lum_sum + 0.5), 0.0, 255.0);
+
+			base[i * 3 + 0] = grey;
+			base[i * 3 + 1] = grey;
+			base[i * 3 + 2] = grey;
+		}
+	}
+}
+
+// Apply the brush centered on texel (cx, cy) of `heightmap_buf`
+//  for the given time.
+// Only the texels under the brush are changed.
+static void ApplyBrush(
+	const int mode,
+	const int cx,
+	const int cy,
+	const double seconds)
+{
+	const int r = (int)std::ceil(brush_radius / grid_width);
+
+	const int x0 = std::max(cx - r, 0);
+	const int y0 = std::max(cy - r, 0);
+	const int x1 = std::min(cx + r, heightmap_width - 1);
+	const int y1 = std::min(cy + r, heightmap_height - 1);
+
+	if (x0 > x1 || y0 > y1) {
+		return;
+	}
+
+	// Heights before this application, with a border of 1 texel,
+	//  so that smoothing does not depend on the order of texels
+	const int sx0 = std::max(x0 - 1, 0);
+	const int sy0 = std::max(y0 - 1, 0);
+	const int sx1 = std::min(x1 + 1, heightmap_width - 1);
+	const int sy1 = std::min(y1 + 1, heightmap_height - 1);
+	const int sw = sx1 - sx0 + 1;
+	std::vector<double> src;
+
+	if (mode == BRUSH_SMOOTH) {
+		src.resize((size_t)sw * (sy1 - sy0 + 1));
+
+		for (int y = sy0; y <= sy1; ++y) {
+			for (int x = sx0; x <= sx1; ++x) {
+				src[(x - sx0) + (y - sy0) * sw] =
+					heightmap_buf[x + y * heightmap_width];
+			}
+		}
+	}
+
+	const double amount = brush_strength * seconds;
+
+	#pragma omp parallel for
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			const double dx = (x - cx) * grid_width;
+			const double dy = (y - cy) * grid_width;
+			const double d2 =
+				(dx * dx + dy * dy) / (brush_radius * brush_radius);
+
+			if (d2 >= 1.0) {
+				continue;
+			}
+
+			const double falloff = (1.0 - d2) * (1.0 - d2);
+			double &height = heightmap_buf[x + y * heightmap_width];
+
+			if (mode == BRUSH_RAISE) {
+				height += amount * falloff;
+			}
+			else if (mode == BRUSH_LOWER) {
+				height -= amount * falloff;
+			}
+			else {
+				const int nx0 = std::max(x - 1, sx0);
+				const int ny0 = std::max(y - 1, sy0);
+				const int nx1 = std::min(x + 1, sx1);
+				const int ny1 = std::min(y + 1, sy1);
+
+				double sum = 0.0;
+				int count = 0;
+
+				for (int ny = ny0; ny <= ny1; ++ny) {
+					for (int nx = nx0; nx <= nx1; ++nx) {
+						sum += src[(nx - sx0) + (ny - sy0) * sw];
+						count += 1;
+					}
+				}
+
+				const double blend = std::min(1.0, amount * falloff);
+				height += blend * (sum / count - height);
+			}
+
+			// Stay inside the bounding box
+			height = Clamp<double>(height, min_height, max_height);
+		}
+	}
+
+	HeightmapEdited(x0, y0, x1, y1);
+}
+
+// Save the heightmap image (including any edits) as .png at given path.
+static void SaveHeightmap(const std::string &path) {
+	const int code = stbi_write_png(path.c_str(),
+		heightmap_width, heightmap_height, 3,
+		base_heightmap_buf, heightmap_width * 3);
+
+	if (code == 0) {
+		std::cerr << "Failed to write heightmap to " << path << "\n";
+	}
+	else {
+		std::cout << "Saved heightmap at " << path << "\n";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Trivial printing functions
+//////////////////////////////////////////////////////////////////////////////
+
+static void PrintHeightmap() {
+	std::cout << "heightmap " << heightmap_path << "\n";
+}
+
+static void PrintColormap() {
+	std::cout << "colormap " << colormap_path << "\n";
+}
+
+static void PrintColormapFilter() {
+	std::cout
+		<< "colormap_filter "
+		<< (colormap_bilinear ? "bilinear" : "nearest") << "\n";
+}
+
+static void PrintColormapCompress() {
+	std::cout
+		<< "colormap_compress " << (colormap_compress ? "on" : "off") << "\n";
+}
+
+// Print how much memory the colors of each terrain take
+static void PrintColormapStats() {
+	for (size_t i = 0; i < terrains.size(); ++i) {
+		const struct Terrain &t = terrains[i];
+		const size_t rgba_bytes = (size_t)t.color_width * t.color_height * 4;
+
+		std::cout
+			<< "colormap_stats terrain " << i << ": "
+			<< t.color_width << "x" << t.color_height << ", ";
+
+		if (t.colors != NULL) {
+			std::cout << rgba_bytes << " bytes as RGBA\n";
+		}
+		else {
+			std::cout
+				<< t.color_blocks->Bytes() << " bytes compressed, "
+				<< (double)rgba_bytes / (double)t.color_blocks->Bytes()
+				<< " times smaller than RGBA\n";
+		}
+	}
+}
+
+static void PrintResolution() {
+	std::cout
+		<< "resolution " << screen_width  << " " << screen_height << "\n";
+}
+
+static void PrintHfov() {
+	std::cout << "hfov " << RadsToDegrees(hfov) << "\n";
+}
+
+static void PrintHang() {
+	std::cout << "hang " << RadsToDegrees(hang) << "\n";
+}
+
+static void PrintVang() {
+	std::cout << "vang " << RadsToDegrees(vang) << "\n";
+}
+
+static void PrintPos() {
+	std::cout
+		<< "pos "
+		<< cam_pos.x << " " << cam_pos.y << " " << cam_pos.z << "\n";
+}
+
+static void PrintMinHeight() {
+	std::cout << "min_height " << min_height << "\n";
+}
+
+static void PrintMaxHeight() {
+	std::cout << "max_height " << max_height << "\n";
+}
+
+static void PrintLum() {
+	std::cout << "lum " << lum_r << " " << lum_g << " " << lum_b << "\n";
+}
+
+static void PrintGridWidth() {
+	std::cout << "grid_width " << grid_width << "\n";
+}
+
+static void PrintOrthoWidth() {
+	std::cout << "ortho_width " << ortho_width << "\n";
+}
+
+static void PrintStepDist() {
+	std::cout << "step_dist " << step_dist << "\n";
+}
+
+static void PrintStepMode() {
+	std::cout << "step_mode " << (step_adaptive ? "adaptive" : "fixed") << "\n";
+}
+
+static void PrintStepMin() {
+	std::cout << "step_min " << step_min << "\n";
+}
+
+static void PrintStepGrowth() {
+	std::cout << "step_growth " << step_growth << "\n";
+}
+
+static void PrintRefineIters() {
+	std::cout << "refine_iters " << refine_iters << "\n";
+}
+
+static void PrintBgColor() {
+	// Need casts because
+	//  stream does not print Uint8 as ASCII decimal as expected.
+	std::cout
+		<< "bg_color "
+		<< ((int)bg_r) << " "
+		<< ((int)bg_g) << " "
+		<< ((int)bg_b) << "\n";
+}
+
+static void PrintCycle() {
+	std::cout << "cycle " << cycle_period << "\n";
+}
+
+static void PrintMouseSens() {
+	std::cout << "mouse_sens " << mouse_sens << "\n";
+}
+
+static void PrintScrollSens() {
+	std::cout << "scroll_sens " << scroll_sens << "\n";
+}
+
+static void PrintMove() {
+	std::cout << "move " << move_speed << "\n";
+}
+
+static void PrintBeam() {
+	std::cout << "beam " << (use_beams ? "on" : "off") << "\n";
+}
+
+// Print how many march steps the beams saved and start counting again
+static void PrintBeamStats() {
+	std::cout << "beam_stats " << beam_rays << " rays, ";
+
+	if (beam_rays > 0) {
+		std::cout
+			<< (double)beam_steps_skipped / (double)beam_rays
+			<< " steps saved per ray\n";
+	}
+	else {
+		std::cout << "no steps saved\n";
+	}
+
+	beam_rays = 0;
+	beam_steps_skipped = 0;
+}
+
+static void PrintEngine() {
+	std::cout << "engine " << EngineName(render_engine) << "\n";
+}
+
+static void PrintRasterLod() {
+	std::cout << "raster_lod " << raster_lod << "\n";
+}
+
+static void PrintPosterBand() {
+	std::cout << "poster_band " << poster_band << "\n";
+}
+
+static void PrintGoldenTolerance() {
+	std::cout
+		<< "golden_tolerance " << golden_threshold << " " << golden_percent
+		<< " " << golden_ssim << "\n";
+}
+
+static void PrintEngineTolerance() {
+	std::cout << "engine_tolerance " << engine_tolerance << "\n";
+}
+
+static void PrintLighting() {
+	std::cout << "lighting " << (use_lighting ? "on" : "off") << "\n";
+}
+
+static void PrintSun() {
+	std::cout
+		<< "sun "
+		<< RadsToDegrees(sun_azimuth) << " "
+		<< RadsToDegrees(sun_elevation) << "\n";
+}
+
+static void PrintAmbient() {
+	std::cout << "ambient " << ambient << "\n";
+}
+
+static void PrintVrs() {
+	std::cout << "vrs " << (use_vrs ? "on" : "off") << "\n";
+}
+
+static void PrintVrsCenter() {
+	std::cout << "vrs_center " << vrs_x << " " << vrs_y << "\n";
+}
+
+static void PrintVrsZones() {
+	std::cout << "vrs_zones " << vrs_full << " " << vrs_half << "\n";
+}
+
+static void PrintVrsOverlay() {
+	std::cout << "vrs_overlay " << (vrs_overlay ? "on" : "off") << "\n";
+}
+
+// Print how many rays the pixels of the window took with `vrs`
+//  and start counting again
+static void PrintVrsStats() {
+	std::cout << "vrs_stats " << vrs_pixels << " pixels, ";
+
+	if (vrs_pixels > 0) {
+		std::cout
+			<< (double)vrs_rays / (double)vrs_pixels << " rays per pixel\n";
+	}
+	else {
+		std::cout << "no rays\n";
+	}
+
+	vrs_pixels = 0;
+	vrs_rays = 0;
+}
+
+static void PrintHud() {
+	std::cout << "hud " << (show_hud ? "on" : "off") << "\n";
+}
+
+static void PrintHudRecord() {
+	std::cout << "hud_record " << (hud_record ? "on" : "off") << "\n";
+}
+
+// Print how many allocations the frames of the window made
+//  and start counting again
+static void PrintAllocStats() {
+	std::cout << "alloc_stats " << frame_allocs << " allocations in "
+		<< alloc_frames << " frames";
+
+	if (alloc_frames > 0) {
+		std::cout << ", " << (double)frame_allocs / (double)alloc_frames
+			<< " per frame";
+	}
+
+	std::cout << "\n";
+
+	frame_allocs = 0;
+	alloc_frames = 0;
+}
+
+static void PrintGBufferDump() {
+	std::cout << "gbuffer_dump " << (gbuffer_dump ? "on" : "off") << "\n";
+}
+
+static void PrintAa() {
+	std::cout << "aa " << aa_samples << "\n";
+}
+
+static void PrintAaCapture() {
+	std::cout << "aa_capture " << aa_capture_samples << "\n";
+}
+
+static void PrintAaBudget() {
+	std::cout << "aa_budget " << aa_budget << "\n";
+}
+
+// Print how many pixels were on edges and how many extra rays they took
+//  and start counting again
+static void PrintAaStats() {
+	std::cout << "aa_stats " << aa_pixels << " pixels, ";
+
+	if (aa_pixels > 0) {
+		std::cout
+			<< (100.0 * (double)aa_edge_pixels / (double)aa_pixels) << "% on edges, "
+			<< (100.0 * (double)aa_rays / (double)aa_pixels) << "% extra rays\n";
+	}
+	else {
+		std::cout << "no edges\n";
+	}
+
+	aa_pixels = 0;
+	aa_edge_pixels = 0;
+	aa_rays = 0;
+}
+
+static void PrintProjection() {
+	std::cout << "projection ";
+
+	if (image_plane == IMAGEPLANE_PERSPECTIVE) {
+		std::cout << "perspective\n";
+	}
+	else if (image_plane == IMAGEPLANE_SPHERICAL) {
+		std::cout << "spherical\n";
+	}
+	else {
+		std::cout << "orthographic\n";
+	}
+}
+
+static void PrintBrushRadius() {
+	std::cout << "brush_radius " << brush_radius << "\n";
+}
+
+static void PrintBrushStrength() {
+	std::cout << "brush_strength " << brush_strength << "\n";
+}
+
+static void PrintSequence() {
+	std::cout << "heightmap_sequence " << sequence_source << "\n";
+}
+
+static void PrintSequenceFps() {
+	std::cout << "sequence_fps " << sequence_fps << "\n";
+}
+
+static void PrintSequencePrefetch() {
+	std::cout << "sequence_prefetch " << sequence_prefetch << "\n";
+}
+
+static void PrintProcedural() {
+	std::cout << "procedural ";
+
+	if (!procedural_enabled) {
+		std::cout << "none\n";
+		return;
+	}
+
+	std::cout
+		<< procedural_params.seed << " " << procedural_params.octaves << " "
+		<< procedural_params.feature_size << " "
+		<< procedural_params.min_height << " "
+		<< procedural_params.max_height << "\n";
+}
+
+static void PrintProceduralTiles() {
+	std::cout
+		<< "procedural_tiles "
+		<< procedural_params.tile_cells << " "
+		<< procedural_params.grid_width << " "
+		<< procedural_range << " " << procedural_cache_tiles << "\n";
+}
+
+static void PrintRecordingFrameCount() {
+	std::cout << "recording_frame_count " << recording_frame_count << "\n";
+}
+
+static void PrintInstance(const struct TerrainInstance &inst) {
+	std::cout
+		<< "instance "
+		<< inst.heightmap_path << " " << inst.colormap_path << " "
+		<< inst.x << " " << inst.y << " " << inst.grid_width << " "
+		<< inst.min_height << " " << inst.max_height << "\n";
+}
+
+static void PrintInstances() {
+	for (size_t i = 0; i < instances.size(); ++i) {
+		PrintInstance(instances[i]);
+	}
+}
+
+static void PrintAllOptions() {
+	PrintHeightmap();
+	PrintColormap();
+	PrintColormapFilter();
+	PrintColormapCompress();
+	PrintResolution();
+	PrintHfov();
+	PrintProjection();
+	PrintHang();
+	PrintVang();
+	PrintPos();
+	PrintMinHeight();
+	PrintMaxHeight();
+	PrintLum();
+	PrintGridWidth();
+	PrintOrthoWidth();
+	PrintStepDist();
+	PrintStepMode();
+	PrintStepMin();
+	PrintStepGrowth();
+	PrintRefineIters();
+	PrintBgColor();
+	PrintCycle();
+	PrintMouseSens();
+	PrintScrollSens();
+	PrintMove();
+	PrintRecordingFrameCount();
+	PrintBrushRadius();
+	PrintBrushStrength();
+	PrintBeam();
+	PrintLighting();
+	PrintSun();
+	PrintAmbient();
+	PrintEngine();
+	PrintRasterLod();
+	PrintEngineTolerance();
+	PrintGoldenTolerance();
+	PrintPosterBand();
+	PrintAa();
+	PrintAaCapture();
+	PrintAaBudget();
+	PrintGBufferDump();
+	PrintVrs();
+	PrintVrsCenter();
+	PrintVrsZones();
+	PrintVrsOverlay();
+	PrintSequence();
+	PrintSequenceFps();
+	PrintSequencePrefetch();
+	PrintInstances();
+	PrintProcedural();
+	PrintProceduralTiles();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// More file-local functions
+//////////////////////////////////////////////////////////////////////////////
+
+// Reads a file for stbi_load_from_callbacks,
+//  setting progress from how much of the file has been read.
+struct ProgressFile {
+	std::FILE *file;
+	long size;
+	long read;
+
+	SDL_atomic_t *progress;
+	// Progress goes from `progress_base` to `progress_base + progress_span`
+	int progress_base;
+	int progress_span;
+};
+
+static int ProgressFileRead(void *user, char *data, int size) {
+	struct ProgressFile *const pf = (struct ProgressFile*)user;
+	const size_t n = std::fread(data, 1, (size_t)size, pf->file);
+
+	pf->read += (long)n;
+
+	if (pf->size > 0) {
+		SDL_AtomicSet(pf->progress, pf->progress_base +
+			(int)(pf->progress_span * (double)pf->read / (double)pf->size));
+	}
+
+	return (int)n;
+}
+
+static void ProgressFileSkip(void *user, int n) {
+	struct ProgressFile *const pf = (struct ProgressFile*)user;
+
+	if (std::fseek(pf->file, n, SEEK_CUR) == 0) {
+		pf->read += n;
+	}
+}
+
+static int ProgressFileEof(void *user) {
+	return std::feof(((struct ProgressFile*)user)->file);
+}
+
+// Same as stbi_load but updates `progress`
+//  from `base` to `base + span` percent as the file is read.
+static unsigned char *LoadImageWithProgress(
+	const std::string &path,
+	int *width,
+	int *height,
+	const int channels,
+	SDL_atomic_t *progress,
+	const int base,
+	const int span)
+{
+	struct ProgressFile pf;
+	pf.file = std::fopen(path.c_str(), "rb");
+
+	if (pf.file == NULL) {
+		return NULL;
+	}
+
+	std::fseek(pf.file, 0, SEEK_END);
+	pf.size = std::ftell(pf.file);
+	std::fseek(pf.file, 0, SEEK_SET);
+
+	pf.read = 0;
+	pf.progress = progress;
+	pf.progress_base = base;
+	pf.progress_span = span;
+
+	stbi_io_callbacks callbacks;
+	callbacks.read = ProgressFileRead;
+	callbacks.skip = ProgressFileSkip;
+	callbacks.eof = ProgressFileEof;
+
+	int n;
+	unsigned char *const data = stbi_load_from_callbacks(
+		&callbacks, &pf, width, height, &n, channels);
+
+	std::fclose(pf.file);
+
+	return data;
+}
+
+// Thread function for an AssetLoad.
+// Touches nothing but the AssetLoad.
+static int AssetLoadThread(void *data) {
+	struct AssetLoad *const load = (struct AssetLoad*)data;
+
+	// What this builds in parallel regions runs on this thread only,
+	//  so as not to take cores from rendering
+	omp_set_num_threads(1);
+
+	const bool load_heightmap = !load->heightmap_path.empty();
+	const bool load_colormap = !load->colormap_path.empty();
+
+	// Split the progress between decoding the images
+	//  and converting the heightmap
+	const int decode_span = (load_heightmap && load_colormap) ? 45 : 90;
+	int base = 0;
+
+	if (load_heightmap) {
+		load->base_heightmap_buf = LoadImageWithProgress(
+			load->heightmap_path,
+			&load->heightmap_width, &load->heightmap_height, 3,
+			&load->progress, base, decode_span);
+		base += decode_span;
+
+		if (load->base_heightmap_buf == NULL) {
+			load->error =
+				"Failed to load image for heightmap from "
+				+ load->heightmap_path;
+		}
+	}
+
+	if (load_colormap && load->error.empty()) {
+		load->colormap_buf = LoadImageWithProgress(
+			load->colormap_path,
+			&load->colormap_width, &load->colormap_height, 4,
+			&load->progress, base, decode_span);
+
+		if (load->colormap_buf == NULL) {
+			load->error =
+				"Failed to load image for colormap from "
+				+ load->colormap_path;
+		}
+	}
+
+	if (load_heightmap && load->error.empty()) {
+		const int num_pixels = load->heightmap_width * load->heightmap_height;
+		load->heightmap_buf = new double[num_pixels];
+
+		// In chunks of rows to report progress
+		const int rows_per_chunk = 64;
+		for (int y = 0; y < load->heightmap_height; y += rows_per_chunk) {
+			const int rows =
+				std::min(rows_per_chunk, load->heightmap_height - y);
+			const int first = y * load->heightmap_width;
+
+			ConvertHeights(load->base_heightmap_buf + first * 3,
+				rows * load->heightmap_width, load->params,
+				load->heightmap_buf + first, false);
+
+			SDL_AtomicSet(&load->progress,
+				90 + (9 * (y + rows)) / load->heightmap_height);
+		}
+
+		// Here rather than when swapped in, where it would stall a frame
+		load->heightmap_mip = new MaxMip;
+		load->heightmap_mip->Build(load->heightmap_buf,
+			load->heightmap_width, load->heightmap_height);
+
+		load->heightmap_light = new TerrainLight;
+		if (load->lighting) {
+			load->heightmap_light->Build(load->heightmap_buf,
+				load->heightmap_width, load->heightmap_height,
+				load->grid_width, load->sun);
+		}
+	}
+
+	SDL_AtomicSet(&load->progress, 100);
+	SDL_AtomicSet(&load->done, 1);
+
+	return 0;
+}
+
+static void FreeAssetLoad(struct AssetLoad *load) {
+	stbi_image_free((void*)load->base_heightmap_buf);
+	delete[] load->heightmap_buf;
+	delete load->heightmap_mip;
+	delete load->heightmap_light;
+	stbi_image_free((void*)load->colormap_buf);
+	delete load;
+}
+
+// Start loading in the background, or queue the paths
+//  if a load is already in progress.
+// An empty path means keep the current image.
+static void RequestAssetLoad(
+	const std::string &new_heightmap_path,
+	const std::string &new_colormap_path)
+{
+	if (asset_load != NULL) {
+		if (!new_heightmap_path.empty()) {
+			queued_heightmap_path = new_heightmap_path;
+		}
+
+		if (!new_colormap_path.empty()) {
+			queued_colormap_path = new_colormap_path;
+		}
+
+		return;
+	}
+
+	struct AssetLoad *const load = new struct AssetLoad;
+	load->heightmap_path = new_heightmap_path;
+	load->colormap_path = new_colormap_path;
+	load->params = CurrentHeightParams();
+	load->lighting = use_lighting;
+	load->grid_width = grid_width;
+	load->sun = CurrentSun();
+	load->base_heightmap_buf = NULL;
+	load->heightmap_buf = NULL;
+	load->heightmap_mip = NULL;
+	load->heightmap_light = NULL;
+	load->colormap_buf = NULL;
+	SDL_AtomicSet(&load->progress, 0);
+	SDL_AtomicSet(&load->done, 0);
+
+	asset_load_thread =
+		SDL_CreateThread(AssetLoadThread, "AssetLoad", load);
+
+	if (asset_load_thread == NULL) {
+		std::cerr << "Failed to create thread for loading: "
+		          << SDL_GetError() << "\n";
+		FreeAssetLoad(load);
+		return;
+	}
+
+	asset_load = load;
+}
+
+// If the load in progress is done, swap in its images.
+// Must not be called while rendering.
+static void FinishAssetLoad() {
+	if (asset_load == NULL || SDL_AtomicGet(&asset_load->done) == 0) {
+		return;
+	}
+
+	SDL_WaitThread(asset_load_thread, NULL);
+	asset_load_thread = NULL;
+
+	struct AssetLoad *const load = asset_load;
+	asset_load = NULL;
+
+	if (!load->error.empty()) {
+		// Keep the current terrain
+		std::cerr << load->error << "\n";
+		asset_status = load->error;
+	}
+	else {
+		if (!load->heightmap_path.empty()) {
+			stbi_image_free((void*)base_heightmap_buf);
+			base_heightmap_buf = load->base_heightmap_buf;
+			load->base_heightmap_buf = NULL;
+
+			delete[] heightmap_buf;
+			heightmap_buf = load->heightmap_buf;
+			load->heightmap_buf = NULL;
+
+			delete heightmap_mip;
+			heightmap_mip = load->heightmap_mip;
+			load->heightmap_mip = NULL;
+
+			delete heightmap_light;
+			heightmap_light = load->heightmap_light;
+			load->heightmap_light = NULL;
+
+			heightmap_params = load->params;
+			heightmap_width = load->heightmap_width;
+			heightmap_height = load->heightmap_height;
+			heightmap_path = load->heightmap_path;
+			PrintHeightmap();
+
+			// In case parameters changed in the console while loading
+			UpdateHeightmap();
+		}
+
+		if (!load->colormap_path.empty()) {
+			stbi_image_free((void*)colormap_buf);
+			colormap_buf = load->colormap_buf;
+			load->colormap_buf = NULL;
+
+			colormap_width = load->colormap_width;
+			colormap_height = load->colormap_height;
+			colormap_path = load->colormap_path;
+			PrintColormap();
+		}
+
+		UpdateTerrains();
+		asset_status = "Loaded";
+	}
+
+	asset_status_until_ms = SDL_GetTicks() + 3000;
+	FreeAssetLoad(load);
+
+	if (!queued_heightmap_path.empty() || !queued_colormap_path.empty()) {
+		RequestAssetLoad(queued_heightmap_path, queued_colormap_path);
+		queued_heightmap_path.clear();
+		queued_colormap_path.clear();
+	}
+}
+
+// Whether `pattern` has exactly one printf conversion
+//  and it is an integer one like %d or %04d
+static bool IsFramePattern(const std::string &pattern) {
+	int conversions = 0;
+
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] != '%') {
+			continue;
+		}
+
+		size_t j = i + 1;
+		while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') {
+			j += 1;
+		}
+
+		if (j == pattern.size() || pattern[j] != 'd') {
+			return false;
+		}
+
+		conversions += 1;
+		i = j;
+	}
+
+	return conversions == 1;
+}
+
+static bool FileExists(const std::string &path) {
+	std::FILE *const file = std::fopen(path.c_str(), "rb");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	std::fclose(file);
+	return true;
+}
+
+// Paths of the frames of a heightmap sequence in playback order.
+// `source` is either a pattern like erosion_%04d.png,
+//  numbered from 0 (or 1) up to the first missing file,
+//  or a directory of images sorted by name.
+static std::vector<std::string> SequencePaths(const std::string &source) {
+	std::vector<std::string> paths;
+
+	if (source.find('%') != std::string::npos) {
+		if (!IsFramePattern(source)) {
+			std::cerr << "heightmap_sequence pattern must have one %d: "
+			          << source << "\n";
+			return paths;
+		}
+
+		char buf[4096];
+		for (int i = 0;; ++i) {
+			std::snprintf(buf, sizeof(buf), source.c_str(), i);
+
+			if (FileExists(buf)) {
+				paths.push_back(buf);
+			}
+			else if (i > 0 || !paths.empty()) {
+				break;
+			}
+		}
+
+		return paths;
+	}
+
+	DIR *const dir = opendir(source.c_str());
+
+	if (dir == NULL) {
+		std::cerr << "Failed to open heightmap_sequence directory "
+		          << source << "\n";
+		return paths;
+	}
+
+	static const char *const extensions[] = {
+		".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif",
+		".psd", ".hdr", ".pic", ".pgm", ".ppm", ".pnm"
+	};
+	const int num_extensions = sizeof(extensions) / sizeof(extensions[0]);
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		std::string name = entry->d_name;
+		const size_t dot = name.rfind('.');
+
+		if (dot == std::string::npos) {
+			continue;
+		}
+
+		std::string extension = name.substr(dot);
+		for (size_t i = 0; i < extension.size(); ++i) {
+			extension[i] = (char)std::tolower(extension[i]);
+		}
+
+		for (int i = 0; i < num_extensions; ++i) {
+			if (extension == extensions[i]) {
+				paths.push_back(source + "/" + name);
+				break;
+			}
+		}
+	}
+
+	closedir(dir);
+
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+static void FreeSequenceFrame(const struct SequenceFrame &frame) {
+	stbi_image_free((void*)frame.base_heightmap_buf);
+	delete[] frame.heightmap_buf;
+	delete frame.mip;
+	delete frame.light;
+}
+
+// Decodes and converts frames ahead of playback
+//  until the ring is full, then waits for the main thread to take some.
+static int SequenceThread(void *data) {
+	struct HeightmapSequence *const seq = (struct HeightmapSequence*)data;
+	const int num_paths = (int)seq->paths.size();
+
+	// Like AssetLoadThread, leaves the cores to rendering
+	omp_set_num_threads(1);
+
+	int index = 0;
+	while (true) {
+		SDL_LockMutex(seq->mutex);
+
+		while (!seq->stop && (int)seq->ring.size() >= seq->prefetch) {
+			SDL_CondWait(seq->changed, seq->mutex);
+		}
+
+		// Playback got ahead of decoding, so skip the frames
+		//  that would be too late to show
+		if (seq->ring.empty() && index < seq->due) {
+			seq->skipped += seq->due - index;
+			index = seq->due;
+		}
+
+		const bool stop = seq->stop;
+		const struct HeightParams params = seq->params;
+		const bool lighting = seq->lighting;
+		const double frame_grid_width = seq->grid_width;
+		const struct Sun sun = seq->sun;
+
+		SDL_UnlockMutex(seq->mutex);
+
+		if (stop) {
+			break;
+		}
+
+		const Uint32 start_ms = SDL_GetTicks();
+
+		struct SequenceFrame frame;
+		frame.index = index;
+		frame.params = params;
+		frame.heightmap_buf = NULL;
+		frame.mip = NULL;
+		frame.light = NULL;
+
+		{
+			int n;
+			frame.base_heightmap_buf = stbi_load(
+				seq->paths[index % num_paths].c_str(),
+				&frame.width, &frame.height, &n, 3);
+		}
+
+		if (frame.base_heightmap_buf != NULL) {
+			const int num_pixels = frame.width * frame.height;
+			frame.heightmap_buf = new double[num_pixels];
+			ConvertHeights(frame.base_heightmap_buf, num_pixels, params,
+				frame.heightmap_buf, false);
+
+			frame.mip = new MaxMip;
+			frame.mip->Build(frame.heightmap_buf, frame.width, frame.height);
+
+			frame.light = new TerrainLight;
+			if (lighting) {
+				frame.light->Build(frame.heightmap_buf, frame.width, frame.height,
+					frame_grid_width, sun);
+			}
+		}
+
+		const double ms = (double)(SDL_GetTicks() - start_ms);
+
+		SDL_LockMutex(seq->mutex);
+		seq->ring.push_back(frame);
+		seq->decoded += 1;
+		seq->decode_ms_total += ms;
+		seq->decode_ms_max = std::max(seq->decode_ms_max, ms);
+		SDL_CondSignal(seq->changed);
+		SDL_UnlockMutex(seq->mutex);
+
+		index += 1;
+	}
+
+	return 0;
+}
+
+static void StopSequence() {
+	if (sequence == NULL) {
+		return;
+	}
+
+	SDL_LockMutex(sequence->mutex);
+	sequence->stop = true;
+	SDL_CondBroadcast(sequence->changed);
+	SDL_UnlockMutex(sequence->mutex);
+
+	SDL_WaitThread(sequence->thread, NULL);
+
+	for (size_t i = 0; i < sequence->ring.size(); ++i) {
+		FreeSequenceFrame(sequence->ring[i]);
+	}
+
+	SDL_DestroyCond(sequence->changed);
+	SDL_DestroyMutex(sequence->mutex);
+	delete sequence;
+	sequence = NULL;
+}
+
+static void StartSequence(const std::string &source) {
+	const std::vector<std::string> paths = SequencePaths(source);
+
+	if (paths.empty()) {
+		std::cerr << "No frames found for heightmap_sequence "
+		          << source << "\n";
+		return;
+	}
+
+	struct HeightmapSequence *const seq = new struct HeightmapSequence;
+	seq->source = source;
+	seq->paths = paths;
+	seq->mutex = SDL_CreateMutex();
+	seq->changed = SDL_CreateCond();
+	seq->prefetch = std::max(1, sequence_prefetch);
+	seq->params = CurrentHeightParams();
+	seq->lighting = use_lighting;
+	seq->grid_width = grid_width;
+	seq->sun = CurrentSun();
+	seq->due = 0;
+	seq->stop = false;
+	seq->decoded = 0;
+	seq->decode_ms_total = 0.0;
+	seq->decode_ms_max = 0.0;
+	seq->skipped = 0;
+	seq->position = 0.0;
+	seq->shown = -1;
+	seq->late = 0;
+	seq->max_lag = 0;
+	seq->rejected = 0;
+
+	seq->thread = NULL;
+	if (seq->mutex != NULL && seq->changed != NULL) {
+		seq->thread = SDL_CreateThread(SequenceThread, "Sequence", seq);
+	}
+
+	if (seq->thread == NULL) {
+		std::cerr << "Failed to create thread for heightmap_sequence: "
+		          << SDL_GetError() << "\n";
+		SDL_DestroyCond(seq->changed);
+		SDL_DestroyMutex(seq->mutex);
+		delete seq;
+		return;
+	}
+
+	std::cout << "heightmap_sequence " << source << " ("
+	          << paths.size() << " frames)\n";
+	sequence = seq;
+}
+
+static void PrintSequenceStats() {
+	if (sequence == NULL) {
+		std::cout << "No heightmap_sequence playing\n";
+		return;
+	}
+
+	const int num_paths = (int)sequence->paths.size();
+
+	SDL_LockMutex(sequence->mutex);
+	const int decoded = sequence->decoded;
+	const double decode_ms_total = sequence->decode_ms_total;
+	const double decode_ms_max = sequence->decode_ms_max;
+	const int skipped = sequence->skipped;
+	const int buffered = (int)sequence->ring.size();
+	SDL_UnlockMutex(sequence->mutex);
+
+	std::cout
+		<< "heightmap_sequence " << sequence->source << "\n"
+		<< "  frame " << std::max(0, sequence->shown) % num_paths + 1
+		<< " of " << num_paths << ", "
+		<< buffered << " of " << sequence->prefetch << " decoded ahead\n"
+		<< "  decode ms: mean "
+		<< (decoded > 0 ? decode_ms_total / decoded : 0.0)
+		<< ", max " << decode_ms_max
+		<< ", frame period " << 1000.0 / sequence_fps << "\n"
+		<< "  late " << sequence->late
+		<< ", max lag " << sequence->max_lag << " frames"
+		<< ", skipped " << skipped
+		<< ", rejected " << sequence->rejected << "\n";
+}
+
+// Start or stop the sequence requested with `heightmap_sequence`,
+//  advance playback by `ms` and swap in the frame that is due.
+// With `step` (while recording), advance exactly one frame,
+//  waiting for it to be decoded so that none are skipped.
+// Must not be called while rendering.
+static void UpdateSequence(const double ms, const bool step) {
+	if (sequence_source_changed) {
+		sequence_source_changed = false;
+		StopSequence();
+
+		if (sequence_source != "none") {
+			StartSequence(sequence_source);
+		}
+	}
+
+	if (sequence == NULL) {
+		return;
+	}
+
+	struct HeightmapSequence *const seq = sequence;
+
+	int due;
+	if (step) {
+		due = seq->shown + 1;
+		seq->position = due;
+	}
+	else {
+		seq->position += ms * sequence_fps / 1000.0;
+		due = std::max(0, (int)seq->position);
+	}
+
+	struct SequenceFrame frame;
+	bool took = false;
+
+	SDL_LockMutex(seq->mutex);
+
+	seq->params = CurrentHeightParams();
+	seq->lighting = use_lighting;
+	seq->grid_width = grid_width;
+	seq->sun = CurrentSun();
+	seq->prefetch = std::max(1, sequence_prefetch);
+	seq->due = due;
+
+	while (step && seq->ring.empty()) {
+		SDL_CondWait(seq->changed, seq->mutex);
+	}
+
+	// The thread jumps to `due` when its ring runs empty,
+	//  so frames from before stepping began may be ahead of the next one.
+	// Show the first frame decoded rather than wait for one never coming.
+	if (step && seq->ring.front().index > due) {
+		due = seq->ring.front().index;
+		seq->position = due;
+		seq->due = due;
+	}
+
+	// Take the latest frame that is due, dropping older ones
+	while (!seq->ring.empty() && seq->ring.front().index <= due) {
+		if (took) {
+			FreeSequenceFrame(frame);
+		}
+
+		frame = seq->ring.front();
+		seq->ring.pop_front();
+		took = true;
+	}
+
+	if (took) {
+		SDL_CondSignal(seq->changed);
+	}
+
+	SDL_UnlockMutex(seq->mutex);
+
+	if (took) {
+		const std::string &path =
+			seq->paths[frame.index % seq->paths.size()];
+		seq->shown = frame.index;
+
+		if (frame.base_heightmap_buf == NULL) {
+			if (seq->rejected == 0) {
+				std::cerr << "Failed to load image for heightmap_sequence from "
+				          << path << "\n";
+			}
+
+			seq->rejected += 1;
+			FreeSequenceFrame(frame);
+		}
+		else {
+			stbi_image_free((void*)base_heightmap_buf);
+			base_heightmap_buf = frame.base_heightmap_buf;
+			delete[] heightmap_buf;
+			heightmap_buf = frame.heightmap_buf;
+			delete heightmap_mip;
+			heightmap_mip = frame.mip;
+			delete heightmap_light;
+			heightmap_light = frame.light;
+			heightmap_params = frame.params;
+			heightmap_width = frame.width;
+			heightmap_height = frame.height;
+			heightmap_path = path;
+
+			// In case parameters changed in the console
+			//  after this frame was decoded
+			UpdateHeightmap();
+
+			UpdateTerrains();
+		}
+	}
+
+	const int lag = due - seq->shown;
+	if (seq->shown >= 0 && lag > 0) {
+		seq->late += 1;
+		seq->max_lag = std::max(seq->max_lag, lag);
+	}
+}
+
+// Generates the requested tiles at full detail, nearest first,
+//  then waits for more
+static int ProceduralThread(void *data) {
+	struct ProceduralTerrain *const proc = (struct ProceduralTerrain*)data;
+
+	// Like AssetLoadThread, leaves the cores to rendering
+	omp_set_num_threads(1);
+
+	while (true) {
+		SDL_LockMutex(proc->mutex);
+
+		while (!proc->stop && proc->requests.empty()) {
+			SDL_CondWait(proc->changed, proc->mutex);
+		}
+
+		if (proc->stop) {
+			SDL_UnlockMutex(proc->mutex);
+			break;
+		}
+
+		proc->current = proc->requests.back();
+		proc->requests.pop_back();
+		proc->generating = true;
+		const bool lighting = proc->lighting;
+		const struct Sun sun = proc->sun;
+
+		SDL_UnlockMutex(proc->mutex);
+
+		const Uint32 start_ms = SDL_GetTicks();
+
+		struct ProceduralTile *const tile = new struct ProceduralTile;
+		GenerateTile(proc->params, proc->current.first, proc->current.second,
+			proc->params.tile_cells, tile);
+
+		if (lighting) {
+			BakeTileLight(proc->params, sun, tile);
+		}
+
+		const double ms = (double)(SDL_GetTicks() - start_ms);
+
+		SDL_LockMutex(proc->mutex);
+		proc->finished.push_back(tile);
+		proc->generating = false;
+		proc->generated += 1;
+		proc->generate_ms_total += ms;
+		SDL_UnlockMutex(proc->mutex);
+	}
+
+	return 0;
+}
+
+// Stop drawing the procedural terrain and free its tiles
+static void StopProcedural() {
+	if (procedural == NULL) {
+		return;
+	}
+
+	struct ProceduralTerrain *const proc = procedural;
+
+	// Before the tiles `terrains` reference are freed
+	procedural = NULL;
+	ShowProceduralTiles();
+
+	if (proc->thread != NULL) {
+		SDL_LockMutex(proc->mutex);
+		proc->stop = true;
+		SDL_CondBroadcast(proc->changed);
+		SDL_UnlockMutex(proc->mutex);
+
+		SDL_WaitThread(proc->thread, NULL);
+	}
+
+	for (size_t i = 0; i < proc->finished.size(); ++i) {
+		delete proc->finished[i];
+	}
+
+	SDL_DestroyCond(proc->changed);
+	SDL_DestroyMutex(proc->mutex);
+	delete proc;
+}
+
+static void StartProcedural() {
+	struct ProceduralTerrain *const proc = new struct ProceduralTerrain;
+	proc->params = procedural_params;
+	proc->mutex = SDL_CreateMutex();
+	proc->changed = SDL_CreateCond();
+	proc->generating = false;
+	proc->lighting = false;
+	proc->sun = CurrentSun();
+	proc->stop = false;
+	proc->generated = 0;
+	proc->generate_ms_total = 0.0;
+	proc->thread = NULL;
+	proc->thread_failed = false;
+	proc->now = 0;
+	proc->coarse_generated = 0;
+
+	procedural = proc;
+}
+
+// Orders tiles farthest first from a point in tile space
+struct FartherTile {
+	double x;
+	double y;
+
+	bool operator()(
+		const std::pair<int, int> &a,
+		const std::pair<int, int> &b) const
+	{
+		const double ax = a.first + 0.5 - x;
+		const double ay = a.second + 0.5 - y;
+		const double bx = b.first + 0.5 - x;
+		const double by = b.second + 0.5 - y;
+
+		return ax * ax + ay * ay > bx * bx + by * by;
+	}
+};
+
+// Whether `terrains` hold exactly the procedural tiles, at full detail,
+//  that a camera at `cam_pos` sees
+static bool ProceduralShows(const glm::dvec3 &cam_pos) {
+	if (!procedural_enabled) {
+		return procedural == NULL;
+	}
+
+	if (procedural == NULL || !(procedural->params == procedural_params)) {
+		return false;
+	}
+
+	struct ProceduralTerrain &proc = *procedural;
+	TilesInRange(proc.params, cam_pos.x, cam_pos.y, procedural_range,
+		&proc.in_range);
+
+	if (proc.in_range.size() != proc.shown.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < proc.shown.size(); ++i) {
+		const struct ProceduralTile &tile = *proc.shown[i];
+
+		if (tile.x != proc.in_range[i].first
+			|| tile.y != proc.in_range[i].second
+			|| tile.cells != proc.params.tile_cells)
+		{
+			return false;
+		}
+
+		if (use_lighting && tile.light_azimuth != sun_azimuth) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Bring the procedural tiles within `procedural_range` of `cam_pos`
+//  into `terrains`, starting or stopping the procedural terrain as needed.
+// With `wait`, tiles missing at full detail are generated now in parallel.
+// Otherwise they are drawn coarsely (generating that takes little time)
+//  until the background thread has generated them.
+// With lighting, tiles are generated with their light baked,
+//  and those whose light is for another sun azimuth are generated again.
+// Must not be called while rendering.
+static void UpdateProcedural(const glm::dvec3 &cam_pos, const bool wait) {
+	if (procedural != NULL
+		&& (!procedural_enabled || !(procedural->params == procedural_params)))
+	{
+		StopProcedural();
+	}
+
+	if (!procedural_enabled) {
+		return;
+	}
+
+	if (procedural == NULL) {
+		StartProcedural();
+	}
+
+	struct ProceduralTerrain &proc = *procedural;
+	const struct ProceduralParams &params = proc.params;
+	const struct Sun sun = CurrentSun();
+	proc.now += 1;
+
+	// Tiles shown may be among those replaced
+	bool replaced = false;
+
+	SDL_LockMutex(proc.mutex);
+
+	for (size_t i = 0; i < proc.finished.size(); ++i) {
+		replaced = proc.cache.Add(proc.finished[i], true, proc.now) || replaced;
+		delete proc.finished[i];
+	}
+
+	proc.finished.clear();
+
+	SDL_UnlockMutex(proc.mutex);
+
+	TilesInRange(params, cam_pos.x, cam_pos.y, procedural_range,
+		&proc.in_range);
+
+	// Those without light are drawn coarsely like missing ones,
+	//  and those with light for another azimuth as they are
+	proc.missing.clear();
+	proc.stale.clear();
+	for (size_t i = 0; i < proc.in_range.size(); ++i) {
+		const std::pair<int, int> &key = proc.in_range[i];
+		const struct ProceduralTile *const tile =
+			proc.cache.Find(key.first, key.second, true, proc.now);
+
+		if (tile == NULL || (use_lighting && tile->light.Empty())) {
+			proc.missing.push_back(key);
+		}
+		else if (use_lighting && tile->light_azimuth != sun.azimuth) {
+			proc.stale.push_back(key);
+		}
+	}
+
+	bool generate_now = wait;
+
+	if (!generate_now && (!proc.missing.empty() || !proc.stale.empty())
+		&& proc.thread == NULL)
+	{
+		if (!proc.thread_failed && proc.mutex != NULL && proc.changed != NULL) {
+			proc.thread =
+				SDL_CreateThread(ProceduralThread, "Procedural", &proc);
+		}
+
+		if (proc.thread == NULL) {
+			if (!proc.thread_failed) {
+				std::cerr
+					<< "WARNING: Failed to create thread for procedural tiles: "
+					<< SDL_GetError() << ", generating them when needed\n";
+			}
+
+			proc.thread_failed = true;
+			generate_now = true;
+		}
+	}
+
+	if (generate_now) {
+		proc.missing.insert(proc.missing.end(),
+			proc.stale.begin(), proc.stale.end());
+		proc.stale.clear();
+	}
+
+	if (generate_now && !proc.missing.empty()) {
+		const int count = (int)proc.missing.size();
+		std::vector<struct ProceduralTile> generated(count);
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < count; ++i) {
+			GenerateTile(params, proc.missing[i].first, proc.missing[i].second,
+				params.tile_cells, &generated[i]);
+
+			if (use_lighting) {
+				BakeTileLight(params, sun, &generated[i]);
+			}
+		}
+
+		for (int i = 0; i < count; ++i) {
+			replaced = proc.cache.Add(&generated[i], true, proc.now) || replaced;
+		}
+
+		proc.missing.clear();
+	}
+
+	proc.tiles.clear();
+	for (size_t i = 0; i < proc.in_range.size(); ++i) {
+		const std::pair<int, int> &key = proc.in_range[i];
+		struct ProceduralTile *tile =
+			proc.cache.Find(key.first, key.second, true, proc.now);
+
+		if (tile != NULL && use_lighting && tile->light.Empty()) {
+			tile = NULL;
+		}
+
+		if (tile == NULL) {
+			tile = proc.cache.Find(key.first, key.second, false, proc.now);
+		}
+
+		if (tile == NULL) {
+			struct ProceduralTile coarse;
+			GenerateTile(params, key.first, key.second,
+				params.tile_cells / PROCEDURAL_COARSE, &coarse);
+			proc.cache.Add(&coarse, false, proc.now);
+			proc.coarse_generated += 1;
+
+			tile = proc.cache.Find(key.first, key.second, false, proc.now);
+		}
+
+		// Coarse tiles are small enough to light here
+		if (use_lighting && tile->light.Empty()) {
+			BakeTileLight(params, sun, tile);
+		}
+
+		proc.tiles.push_back(tile);
+	}
+
+	if (proc.thread != NULL) {
+		const double tile_size = params.tile_cells * params.grid_width;
+		struct FartherTile farther;
+		farther.x = cam_pos.x / tile_size;
+		farther.y = -cam_pos.y / tile_size;
+		std::sort(proc.missing.begin(), proc.missing.end(), farther);
+		std::sort(proc.stale.begin(), proc.stale.end(), farther);
+
+		// Tiles drawn coarsely before those drawn with a stale light
+		proc.stale.insert(proc.stale.end(),
+			proc.missing.begin(), proc.missing.end());
+
+		SDL_LockMutex(proc.mutex);
+
+		// Not the one already being generated
+		proc.requests.clear();
+		for (size_t i = 0; i < proc.stale.size(); ++i) {
+			if (!proc.generating || proc.stale[i] != proc.current) {
+				proc.requests.push_back(proc.stale[i]);
+			}
+		}
+
+		proc.lighting = use_lighting;
+		proc.sun = sun;
+
+		SDL_CondSignal(proc.changed);
+		SDL_UnlockMutex(proc.mutex);
+	}
+
+	if (proc.tiles != proc.shown || replaced) {
+		proc.shown.swap(proc.tiles);
+		ShowProceduralTiles();
+	}
+
+	proc.cache.Trim(
+		std::max(procedural_cache_tiles, (int)proc.in_range.size()), proc.now);
+}
+
+static void PrintProceduralStats() {
+	if (procedural == NULL) {
+		std::cout << "No procedural terrain\n";
+		return;
+	}
+
+	struct ProceduralTerrain &proc = *procedural;
+
+	SDL_LockMutex(proc.mutex);
+	const int generated = proc.generated;
+	const double generate_ms_total = proc.generate_ms_total;
+	const int requested = (int)proc.requests.size();
+	SDL_UnlockMutex(proc.mutex);
+
+	int full = 0;
+	for (size_t i = 0; i < proc.shown.size(); ++i) {
+		if (proc.shown[i]->cells == proc.params.tile_cells) {
+			full += 1;
+		}
+	}
+
+	std::cout
+		<< "procedural_stats\n"
+		<< "  drawn " << proc.shown.size() << " tiles, "
+		<< full << " at full detail, "
+		<< requested << " waiting to be generated\n"
+		<< "  cached " << proc.cache.Count() << " tiles, "
+		<< proc.cache.FullCount() << " at full detail, "
+		<< proc.cache.Evicted() << " evicted\n"
+		<< "  generated in the background " << generated << " tiles, mean "
+		<< (generated > 0 ? generate_ms_total / generated : 0.0) << " ms, "
+		<< proc.coarse_generated << " coarse ones\n";
+}
+
+// Whether the identifier changes `terrains` (or their light) when consumed
+static bool ChangesTerrain(const std::string &identifier) {
+	static const char *const identifiers[] = {
+		"heightmap", "colormap", "min_height", "max_height",
+		"lum", "lum_norm", "lum_r", "lum_g", "lum_b",
+		"grid_width", "instance", "instance_clear",
+		"sun", "ambient", "colormap_compress",
+		"procedural", "procedural_tiles"
+	};
+	const int count = sizeof(identifiers) / sizeof(identifiers[0]);
+
+	for (int i = 0; i < count; ++i) {
+		if (identifier == identifiers[i]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Report that a config statement failed with `message`:
+//  to `config_error` if set, keeping the first failure, else by exiting
+static void ConfigFailed(const std::string &message) {
+	if (config_error == NULL) {
+		std::cerr << message << "\n";
+		std::exit(1);
+	}
+
+	if (config_error->empty()) {
+		*config_error = message;
+	}
+}
+
+// Read stream until end and update config values
+static void ConsumeConfigStream(std::istream &input) {
+	bool should_update_heightmap = false;
+	bool should_update_terrains = false;
+	// With the terrains as updated by the whole stream
+	bool should_compare_engines = false;
+	bool should_compare_steps = false;
+	// Posters to render, as width, height and path
+	std::vector<int> poster_widths;
+	std::vector<int> poster_heights;
+	std::vector<std::string> poster_paths;
+
+	// Loaded together in the background if `load_assets_async`
+	//  so that both are swapped in at once
+	std::string async_heightmap_path;
+	std::string async_colormap_path;
+
+	std::string next;
+	while (input >> next) {
+		if (ChangesTerrain(next)) {
+			should_update_terrains = true;
+		}
+
+		if (next == "heightmap" && load_assets_async) {
+			input >> async_heightmap_path;
+			std::cout << "heightmap " << async_heightmap_path << " (loading)\n";
+		}
+		else if (next == "colormap" && load_assets_async) {
+			input >> async_colormap_path;
+			std::cout << "colormap " << async_colormap_path << " (loading)\n";
+		}
+		else if (next == "heightmap") {
+			std::string path;
+			input >> path;
+
+			int width, height, n;
+			const unsigned char *const buf =
+				stbi_load(path.c_str(), &width, &height, &n, 3);
+
+			if (buf == NULL) {
+				ConfigFailed("Failed to load image for heightmap from " + path);
+				continue;
+			}
+
+			stbi_image_free((void*)base_heightmap_buf);
+			base_heightmap_buf = buf;
+			heightmap_path = path;
+			heightmap_width = width;
+			heightmap_height = height;
+
+			delete[] heightmap_buf;
+			heightmap_buf = NULL;
+
+			should_update_heightmap = true;
+
+			PrintHeightmap();
+		}
+		else if (next == "colormap") {
+			std::string path;
+			input >> path;
+
+			int width, height, n;
+			const unsigned char *const buf =
+				stbi_load(path.c_str(), &width, &height, &n, 4);
+
+			if (buf == NULL) {
+				ConfigFailed("Failed to load image for colormap from " + path);
+				continue;
+			}
+
+			stbi_image_free((void*)colormap_buf);
+			colormap_buf = buf;
+			colormap_path = path;
+			colormap_width = width;
+			colormap_height = height;
+
+			PrintColormap();
+		}
+		else if (next == "colormap_filter") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "nearest") {
+				colormap_bilinear = false;
+			}
+			else if (mode == "bilinear") {
+				colormap_bilinear = true;
+			}
+			else {
+				std::cerr
+					<< "WARNING: colormap_filter must be nearest or bilinear\n";
+			}
+
+			PrintColormapFilter();
+		}
+		else if (next == "colormap_compress") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				colormap_compress = true;
+			}
+			else if (mode == "off") {
+				colormap_compress = false;
+			}
+			else {
+				std::cerr << "WARNING: colormap_compress must be on or off\n";
+			}
+
+			PrintColormapCompress();
+		}
+		else if (next == "colormap_stats") {
+			PrintColormapStats();
+		}
+		else if (next == "print") {
+			std::cout << "print\n";
+			PrintAllOptions();
+		}
+		else if (next == "resolution") {
+			input >> screen_width >> screen_height;
+
+			if (window != NULL) {
+				SDL_SetWindowSize(window, screen_width, screen_height);
+			}
+
+			PrintResolution();
+		}
+		else if (next == "hfov") {
+			double deg;
+			input >> deg;
+			hfov = DegreesToRads(deg);
+			PrintHfov();
+		}
+		else if (next == "projection") {
+			std::string name;
+			input >> name;
+
+			if (name == "perspective") {
+				image_plane = IMAGEPLANE_PERSPECTIVE;
+			}
+			else if (name == "spherical") {
+				image_plane = IMAGEPLANE_SPHERICAL;
+			}
+			else if (name == "orthographic") {
+				image_plane = IMAGEPLANE_ORTHOGRAPHIC;
+			}
+			else {
+				std::cerr << "WARNING: Unknown projection: " << name << "\n";
+			}
+
+			PrintProjection();
+		}
+		else if (next == "hang") {
+			double deg;
+			input >> deg;
+			hang = DegreesToRads(deg);
+			PrintHang();
+		}
+		else if (next == "vang") {
+			double deg;
+			input >> deg;
+			vang = DegreesToRads(deg);
+			PrintVang();
+		}
+		else if (next == "pos") {
+			input >> cam_pos.x >> cam_pos.y >> cam_pos.z;
+			PrintPos();
+		}
+		else if (next == "pos_x") {
+			input >> cam_pos.x;
+			std::cout << "pos_x " << cam_pos.x << "\n";
+		}
+		else if (next == "pos_y") {
+			input >> cam_pos.y;
+			std::cout << "pos_y " << cam_pos.y << "\n";
+		}
+		else if (next == "pos_z") {
+			input >> cam_pos.z;
+			std::cout << "pos_z " << cam_pos.z << "\n";
+		}
+		else if (next == "min_height") {
+			input >> min_height;
+			should_update_heightmap = true;
+			PrintMinHeight();
+		}
+		else if (next == "max_height") {
+			input >> max_height;
+			should_update_heightmap = true;
+			PrintMaxHeight();
+		}
+		else if (next == "lum") {
+			input >> lum_r >> lum_g >> lum_b;
+			should_update_heightmap = true;
+			PrintLum();
+		}
+		else if (next == "lum_norm") {
+			double r, g, b;
+			input >> r >> g >> b;
+			const double total = r + g + b;
+			lum_r = r / total;
+			lum_g = g / total;
+			lum_b = b / total;
+			should_update_heightmap = true;
+			PrintLum();
+		}
+		else if (next == "lum_r") {
+			input >> lum_r;
+			should_update_heightmap = true;
+			std::cout << "lum_r " << lum_r << "\n";
+		}
+		else if (next == "lum_g") {
+			input >> lum_g;
+			should_update_heightmap = true;
+			std::cout << "lum_g " << lum_g << "\n";
+		}
+		else if (next == "lum_b") {
+			input >> lum_b;
+			should_update_heightmap = true;
+			std::cout << "lum_b " << lum_b << "\n";
+		}
+		else if (next == "grid_width") {
+			input >> grid_width;
+			PrintGridWidth();
+		}
+		else if (next == "ortho_width") {
+			input >> ortho_width;
+			PrintOrthoWidth();
+		}
+		else if (next == "step_dist") {
+			input >> step_dist;
+			PrintStepDist();
+		}
+		else if (next == "step_mode") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "fixed") {
+				step_adaptive = false;
+			}
+			else if (mode == "adaptive") {
+				step_adaptive = true;
+			}
+			else {
+				std::cerr << "WARNING: Unknown step mode: " << mode << "\n";
+			}
+
+			PrintStepMode();
+		}
+		else if (next == "step_min") {
+			double value;
+			input >> value;
+
+			if (value >= 0.0) {
+				step_min = value;
+			}
+			else {
+				std::cerr << "WARNING: step_min must not be negative\n";
+			}
+
+			PrintStepMin();
+		}
+		else if (next == "step_growth") {
+			double value;
+			input >> value;
+
+			if (value >= 0.0) {
+				step_growth = value;
+			}
+			else {
+				std::cerr << "WARNING: step_growth must not be negative\n";
+			}
+
+			PrintStepGrowth();
+		}
+		else if (next == "refine_iters") {
+			input >> refine_iters;
+			refine_iters = std::min(std::max(refine_iters, 0), 32);
+			PrintRefineIters();
+		}
+		else if (next == "step_compare") {
+			should_compare_steps = true;
+		}
+		else if (next == "bg_color") {
+			// Read into int intermediaries because
+			//  stream does not properly read directly to Uint8.
+			int r, g, b;
+			input >> r >> g >> b;
+
+			bg_r = (Uint8)r;
+			bg_g = (Uint8)g;
+			bg_b = (Uint8)b;
+
+			PrintBgColor();
+		}
+		else if (next == "cycle") {
+			input >> cycle_period;
+			cycle = 0;
+			PrintCycle();
+		}
+		else if (next == "mouse_sens") {
+			input >> mouse_sens;
+			PrintMouseSens();
+		}
+		else if (next == "scroll_sens") {
+			input >> scroll_sens;
+			PrintScrollSens();
+		}
+		else if (next == "move") {
+			input >> move_speed;
+			PrintMove();
+		}
+		else if (next == "recording_frame_count") {
+			input >> recording_frame_count;
+			PrintRecordingFrameCount();
+		}
+		else if (next == "brush_radius") {
+			input >> brush_radius;
+			PrintBrushRadius();
+		}
+		else if (next == "brush_strength") {
+			input >> brush_strength;
+			PrintBrushStrength();
+		}
+		else if (next == "beam") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				use_beams = true;
+			}
+			else if (mode == "off") {
+				use_beams = false;
+			}
+			else {
+				std::cerr << "WARNING: beam must be on or off\n";
+			}
+
+			PrintBeam();
+		}
+		else if (next == "beam_stats") {
+			PrintBeamStats();
+		}
+		else if (next == "lighting") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				use_lighting = true;
+			}
+			else if (mode == "off") {
+				use_lighting = false;
+			}
+			else {
+				std::cerr << "WARNING: lighting must be on or off\n";
+			}
+
+			PrintLighting();
+		}
+		else if (next == "sun") {
+			double azimuth_degrees;
+			double elevation_degrees;
+			input >> azimuth_degrees >> elevation_degrees;
+
+			sun_azimuth = DegreesToRads(azimuth_degrees);
+			sun_elevation = DegreesToRads(
+				Clamp<double>(elevation_degrees, -90.0, 90.0));
+			PrintSun();
+		}
+		else if (next == "ambient") {
+			input >> ambient;
+			ambient = Clamp<double>(ambient, 0.0, 1.0);
+			PrintAmbient();
+		}
+		else if (next == "aa") {
+			input >> aa_samples;
+			aa_samples = Clamp<int>(aa_samples, 0, AA_MAX_SAMPLES);
+			PrintAa();
+		}
+		else if (next == "aa_capture") {
+			input >> aa_capture_samples;
+			aa_capture_samples =
+				Clamp<int>(aa_capture_samples, 0, AA_MAX_SAMPLES);
+			PrintAaCapture();
+		}
+		else if (next == "aa_budget") {
+			input >> aa_budget;
+			aa_budget = std::max(aa_budget, 0.0);
+			PrintAaBudget();
+		}
+		else if (next == "aa_stats") {
+			PrintAaStats();
+		}
+		else if (next == "vrs") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				use_vrs = true;
+			}
+			else if (mode == "off") {
+				use_vrs = false;
+			}
+			else {
+				std::cerr << "WARNING: vrs must be on or off\n";
+			}
+
+			PrintVrs();
+		}
+		else if (next == "vrs_center") {
+			input >> vrs_x >> vrs_y;
+			PrintVrsCenter();
+		}
+		else if (next == "vrs_zones") {
+			input >> vrs_full >> vrs_half;
+			vrs_half = std::max(vrs_half, vrs_full);
+			PrintVrsZones();
+		}
+		else if (next == "vrs_overlay") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				vrs_overlay = true;
+			}
+			else if (mode == "off") {
+				vrs_overlay = false;
+			}
+			else {
+				std::cerr << "WARNING: vrs_overlay must be on or off\n";
+			}
+
+			PrintVrsOverlay();
+		}
+		else if (next == "vrs_stats") {
+			PrintVrsStats();
+		}
+		else if (next == "alloc_stats") {
+			PrintAllocStats();
+		}
+		else if (next == "alloc_check") {
+			CheckFrameAllocs();
+		}
+		else if (next == "hud") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				show_hud = true;
+			}
+			else if (mode == "off") {
+				show_hud = false;
+			}
+			else {
+				std::cerr << "WARNING: hud must be on or off\n";
+			}
+
+			PrintHud();
+		}
+		else if (next == "hud_record") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				hud_record = true;
+			}
+			else if (mode == "off") {
+				hud_record = false;
+			}
+			else {
+				std::cerr << "WARNING: hud_record must be on or off\n";
+			}
+
+			PrintHudRecord();
+		}
+		else if (next == "gbuffer_dump") {
+			std::string mode;
+			input >> mode;
+
+			if (mode == "on") {
+				gbuffer_dump = true;
+			}
+			else if (mode == "off") {
+				gbuffer_dump = false;
+			}
+			else {
+				std::cerr << "WARNING: gbuffer_dump must be on or off\n";
+			}
+
+			PrintGBufferDump();
+		}
+		else if (next == "engine") {
+			std::string name;
+			input >> name;
+
+			if (name == "march") {
+				render_engine = ENGINE_MARCH;
+			}
+			else if (name == "splat") {
+				render_engine = ENGINE_SPLAT;
+			}
+			else if (name == "raster") {
+				render_engine = ENGINE_RASTER;
+			}
+			else {
+				std::cerr << "WARNING: Unknown engine: " << name << "\n";
+			}
+
+			PrintEngine();
+		}
+		else if (next == "raster_lod") {
+			input >> raster_lod;
+			PrintRasterLod();
+		}
+		else if (next == "engine_tolerance") {
+			input >> engine_tolerance;
+			PrintEngineTolerance();
+		}
+		else if (next == "golden_tolerance") {
+			input >> golden_threshold >> golden_percent >> golden_ssim;
+			PrintGoldenTolerance();
+		}
+		else if (next == "engine_compare") {
+			should_compare_engines = true;
+		}
+		else if (next == "poster") {
+			int width;
+			int height;
+			std::string path;
+			input >> width >> height >> path;
+
+			poster_widths.push_back(width);
+			poster_heights.push_back(height);
+			poster_paths.push_back(path);
+		}
+		else if (next == "poster_band") {
+			input >> poster_band;
+			PrintPosterBand();
+		}
+		else if (next == "heightmap_sequence") {
+			input >> sequence_source;
+			sequence_source_changed = true;
+			PrintSequence();
+		}
+		else if (next == "sequence_fps") {
+			input >> sequence_fps;
+			PrintSequenceFps();
+		}
+		else if (next == "sequence_prefetch") {
+			input >> sequence_prefetch;
+			PrintSequencePrefetch();
+		}
+		else if (next == "sequence_stats") {
+			PrintSequenceStats();
+		}
+		else if (next == "save_heightmap") {
+			std::string path;
+			input >> path;
+			SaveHeightmap(path);
+		}
+		else if (next == "instance") {
+			struct TerrainInstance inst;
+			input
+				>> inst.heightmap_path >> inst.colormap_path
+				>> inst.x >> inst.y >> inst.grid_width
+				>> inst.min_height >> inst.max_height;
+
+			{
+				int n;
+				inst.base_heightmap_buf = stbi_load(
+					inst.heightmap_path.c_str(),
+					&inst.width, &inst.height, &n, 3);
+			}
+
+			if (inst.base_heightmap_buf == NULL) {
+				ConfigFailed("Failed to load image for instance heightmap from "
+					+ inst.heightmap_path);
+				continue;
+			}
+
+			{
+				int n;
+				inst.colormap_buf = stbi_load(inst.colormap_path.c_str(),
+					&inst.color_width, &inst.color_height, &n, 4);
+
+				if (inst.colormap_buf == NULL) {
+					stbi_image_free((void*)inst.base_heightmap_buf);
+					ConfigFailed("Failed to load image for instance colormap from "
+						+ inst.colormap_path);
+					continue;
+				}
+			}
+
+			inst.heightmap_buf = NULL;
+			inst.mip = NULL;
+			inst.light = NULL;
+			UpdateInstanceHeightmap(&inst);
+			instances.push_back(inst);
+
+			PrintInstance(inst);
+		}
+		else if (next == "procedural") {
+			std::string seed;
+			input >> seed;
+
+			if (seed == "none") {
+				procedural_enabled = false;
+			}
+			else {
+				struct ProceduralParams params = procedural_params;
+				params.seed = (unsigned int)std::strtoul(seed.c_str(), NULL, 10);
+				input
+					>> params.octaves >> params.feature_size
+					>> params.min_height >> params.max_height;
+
+				if (params.octaves < 1 || params.feature_size <= 0.0) {
+					std::cerr
+						<< "WARNING: procedural needs at least 1 octave"
+						<< " and a positive feature size\n";
+				}
+				else {
+					procedural_params = params;
+					procedural_enabled = true;
+				}
+			}
+
+			PrintProcedural();
+		}
+		else if (next == "procedural_tiles") {
+			int cells;
+			double width;
+			input
+				>> cells >> width
+				>> procedural_range >> procedural_cache_tiles;
+
+			if (cells < 1 || width <= 0.0) {
+				std::cerr
+					<< "WARNING: procedural_tiles needs at least 1 cell"
+					<< " and a positive grid width\n";
+			}
+			else {
+				// Whole cells of the coarse tiles
+				procedural_params.tile_cells =
+					(cells + PROCEDURAL_COARSE - 1)
+					/ PROCEDURAL_COARSE * PROCEDURAL_COARSE;
+				procedural_params.grid_width = width;
+			}
+
+			PrintProceduralTiles();
+		}
+		else if (next == "procedural_stats") {
+			PrintProceduralStats();
+		}
+		else if (next == "instance_clear") {
+			FreeInstances();
+			std::cout << "instance_clear\n";
+		}
+		else {
+			std::cerr << "WARNING: Unknown identifier: " << next << "\n";
+		}
+	}
+
+	// Some validation
+
+	if (base_heightmap_buf == NULL) {
+		ConfigFailed("Must specify heightmap in config");
+		return;
+	}
+
+	if (colormap_buf == NULL && colormap_blocks.Empty()) {
+		ConfigFailed("Must specify colormap in config");
+		return;
+	}
+
+	if (should_update_heightmap) {
+		UpdateHeightmap();
+	}
+
+	if (should_update_terrains) {
+		UpdateTerrains();
+	}
+
+	if (should_compare_engines) {
+		CompareEngines();
+	}
+
+	if (should_compare_steps) {
+		CompareSteps();
+	}
+
+	if (!poster_paths.empty()) {
+		UpdateProcedural(cam_pos, true);
+	}
+
+	for (size_t i = 0; i < poster_paths.size(); ++i) {
+		RenderPoster(poster_widths[i], poster_heights[i], poster_paths[i]);
+	}
+
+	if (!async_heightmap_path.empty() || !async_colormap_path.empty()) {
+		RequestAssetLoad(async_heightmap_path, async_colormap_path);
+	}
+}
+
+// Write config statements that reproduce the camera of the view
+//  followed by `frame`, as read by RunBatch.
+static void WriteViewFrame(std::ostream &output, const struct View &view) {
+	const char *projection = "orthographic";
+	if (view.image_plane == IMAGEPLANE_PERSPECTIVE) {
+		projection = "perspective";
+	}
+	else if (view.image_plane == IMAGEPLANE_SPHERICAL) {
+		projection = "spherical";
+	}
+
+	output
+		<< std::setprecision(17)
+		<< "pos "
+		<< view.cam_pos.x << " " << view.cam_pos.y << " " << view.cam_pos.z
+		<< " hang " << RadsToDegrees(view.hang)
+		<< " vang " << RadsToDegrees(view.vang)
+		<< " hfov " << RadsToDegrees(view.hfov)
+		<< " ortho_width " << view.ortho_width
+		<< " projection " << projection
+		<< " frame\n";
+}
+
+// Render the views in parallel, both across and within frames,
+//  saving each one as soon as its last row is done (if `save`).
+// Frame numbers in file names start at `first_num`.
+// If `images` is given, the frames are kept in it as RGBA rows.
+static void RenderViews(
+	const std::vector<struct View> &views,
+	const std::time_t batch_id,
+	const int first_num,
+	const bool save = true,
+	std::vector<std::vector<Uint8> > *const images = NULL)
+{
+	const int count = (int)views.size();
+
+	std::vector<ImagePlane*> planes(count);
+	std::vector<Uint8*> bufs(count);
+	std::vector<int> rows_left(count);
+	// Frame i covers rows [row_start[i], row_start[i + 1]) of the batch
+	std::vector<int> row_start(count + 1, 0);
+
+	std::vector<struct ViewPrep> preps(count);
+	std::vector<std::vector<struct PixelHit> > gbuffers(count);
+
+	if (images != NULL) {
+		images->resize(count);
+	}
+
+	for (int i = 0; i < count; ++i) {
+		const size_t size = (size_t)views[i].width * views[i].height * 4;
+
+		planes[i] = NewImagePlane(views[i]);
+
+		if (images != NULL) {
+			(*images)[i].resize(size);
+			bufs[i] = &(*images)[i][0];
+		}
+		else {
+			bufs[i] = new Uint8[size];
+		}
+
+		rows_left[i] = views[i].height;
+		row_start[i + 1] = row_start[i] + views[i].height;
+
+		PrepareView(views[i], planes[i], 0, views[i].height, &preps[i]);
+		gbuffers[i].resize((size_t)views[i].width * views[i].height);
+
+		if (preps[i].beams) {
+			beam_rays += views[i].width * views[i].height;
+		}
+	}
+
+	long long skipped = 0;
+
+	#pragma omp parallel for schedule(dynamic) reduction(+:skipped)
+	for (int row = 0; row < row_start[count]; ++row) {
+		const int f = (int)(std::upper_bound(
+			row_start.begin(), row_start.end(), row) - row_start.begin()) - 1;
+		const struct View &view = views[f];
+		const int h = row - row_start[f];
+
+		Uint8 *const row_buf = bufs[f] + (size_t)h * view.width * 4;
+		struct PixelHit *const row_hits = &gbuffers[f][(size_t)h * view.width];
+
+		for (int w = 0; w < view.width; ++w) {
+			MarchPixel(view, planes[f], w, h, preps[f], &skipped,
+				&row_hits[w]);
+		}
+
+		ResolveRows(row_buf, row_hits, view, planes[f], h, 1, 1, 0);
+
+		int left;
+		#pragma omp atomic capture
+		left = --rows_left[f];
+
+		if (left == 0) {
+			if (view.aa_samples > 0) {
+				RefineEdges(bufs[f], &gbuffers[f][0], view, planes[f],
+					0, view.height, 0, view.height, 1, 0, &preps[f].edges);
+			}
+
+			if (save) {
+				std::stringstream ss;
+				ss << "screenshots/hmap_" << batch_id << "_"
+				   << (first_num + f) << ".png";
+
+				SavePNG(bufs[f], view.width, view.height, ss.str());
+
+				if (gbuffer_dump) {
+					SaveGBuffer(&gbuffers[f][0], view.width, view.height,
+						ss.str());
+				}
+			}
+
+			if (images == NULL) {
+				delete[] bufs[f];
+			}
+
+			bufs[f] = NULL;
+			std::vector<struct PixelHit>().swap(gbuffers[f]);
+		}
+	}
+
+	for (int i = 0; i < count; ++i) {
+		delete planes[i];
+	}
+
+	beam_steps_skipped += skipped;
+}
+
+// Send config statements for the worker to consume
+static bool SendStatements(
+	const struct ChildProcess &worker,
+	const std::string &statements)
+{
+	const int type = WORKER_MSG_CONFIG;
+	const int length = (int)statements.size();
+
+	return WriteAll(worker.fd, &type, sizeof(type))
+	    && WriteAll(worker.fd, &length, sizeof(length))
+	    && WriteAll(worker.fd, statements.data(), statements.size());
+}
+
+// Start a worker that loads the config file
+//  and catches up on `worker_statements`.
+static bool StartWorker(struct ChildProcess *worker) {
+	// Share the threads between the workers
+	int threads = omp_get_max_threads() / (int)workers.size();
+	if (threads < 1) threads = 1;
+
+	std::stringstream ss;
+	ss << threads;
+
+	std::vector<std::string> args;
+	args.push_back(program_name);
+	args.push_back(config_path);
+	args.push_back("--worker");
+	args.push_back(ss.str());
+
+	if (!SpawnChild("/proc/self/exe", args, worker)) {
+		worker->pid = -1;
+		worker->fd = -1;
+		return false;
+	}
+
+	if (!worker_statements.empty()
+		&& !SendStatements(*worker, worker_statements))
+	{
+		EndChild(worker);
+		return false;
+	}
+
+	return true;
+}
+
+// Give config statements that change the terrain to every worker
+static void ForwardStatements(const std::string &statements) {
+	worker_statements += statements;
+
+	for (size_t i = 0; i < workers.size(); ++i) {
+		if (workers[i].fd >= 0 && !SendStatements(workers[i], statements)) {
+			// Noticed as dead when given a tile
+			std::cerr << "Worker " << workers[i].pid << " is not responding\n";
+		}
+	}
+}
+
+// Serve tiles to the coordinator on `fd` until it closes the socket
+static void RunWorker(const int fd, const int threads) {
+	omp_set_num_threads(threads);
+
+	std::vector<Uint8> buf;
+
+	int type;
+	while (ReadAll(fd, &type, sizeof(type))) {
+		if (type == WORKER_MSG_CONFIG) {
+			int length;
+			if (!ReadAll(fd, &length, sizeof(length))) {
+				break;
+			}
+
+			std::string statements((size_t)length, ' ');
+			if (length > 0 && !ReadAll(fd, &statements[0], (size_t)length)) {
+				break;
+			}
+
+			std::istringstream iss(statements);
+			ConsumeConfigStream(iss);
+		}
+		else if (type == WORKER_MSG_TILE) {
+			struct TileJob job;
+			if (!ReadAll(fd, &job, sizeof(job))) {
+				break;
+			}
+
+			// The same tiles as the main process has for the camera
+			UpdateProcedural(job.view.cam_pos, true);
+
+			buf.resize((size_t)job.rows * job.view.width * 4);
+			RenderRows(&buf[0], job.view, job.y0, job.rows);
+
+			struct TileResult result;
+			result.frame = job.frame;
+			result.y0 = job.y0;
+			result.rows = job.rows;
+			result.width = job.view.width;
+
+			const bool sent =
+				WriteAll(fd, &result, sizeof(result)) &&
+				WriteAll(fd, &buf[0], buf.size());
+
+			if (!sent) {
+				break;
+			}
+		}
+		else {
+			std::cerr << "Worker got unknown message type " << type << "\n";
+			break;
+		}
+	}
+}
+
+// Same as RenderViews but the tiles are rendered by `workers`.
+// Tiles go to whichever worker is idle.
+// A tile whose worker dies is given to another worker
+//  and the dead worker is replaced while `worker_respawns_left` allows.
+static void DistributeViews(
+	const std::vector<struct View> &views,
+	const std::time_t batch_id,
+	const int first_num)
+{
+	const int count = (int)views.size();
+
+	std::vector<Uint8*> bufs(count);
+	std::vector<int> rows_left(count);
+	std::deque<struct TileJob> jobs;
+
+	for (int f = 0; f < count; ++f) {
+		bufs[f] = new Uint8[views[f].width * views[f].height * 4];
+		rows_left[f] = views[f].height;
+
+		for (int y0 = 0; y0 < views[f].height; y0 += WORKER_TILE_ROWS) {
+			struct TileJob job;
+			job.frame = f;
+			job.y0 = y0;
+			job.rows = std::min(WORKER_TILE_ROWS, views[f].height - y0);
+			job.view = views[f];
+			jobs.push_back(job);
+		}
+	}
+
+	int frames_left = count;
+
+	// Tile that each worker is rendering. frame is -1 if idle.
+	std::vector<struct TileJob> busy(workers.size());
+	for (size_t i = 0; i < busy.size(); ++i) {
+		busy[i].frame = -1;
+	}
+
+	while (frames_left > 0) {
+		std::vector<struct TileJob> done;
+
+		// Hand out tiles to idle workers
+		for (size_t i = 0; i < workers.size() && !jobs.empty(); ++i) {
+			if (workers[i].fd < 0 || busy[i].frame >= 0) {
+				continue;
+			}
+
+			const int type = WORKER_MSG_TILE;
+			const struct TileJob &job = jobs.front();
+
+			const bool sent =
+				WriteAll(workers[i].fd, &type, sizeof(type)) &&
+				WriteAll(workers[i].fd, &job, sizeof(job));
+
+			if (sent) {
+				busy[i] = job;
+				jobs.pop_front();
+			}
+			else {
+				std::cerr << "Worker " << workers[i].pid << " died\n";
+				EndChild(&workers[i]);
+
+				if (worker_respawns_left > 0) {
+					worker_respawns_left -= 1;
+					StartWorker(&workers[i]);
+				}
+			}
+		}
+
+		std::vector<struct pollfd> fds;
+		std::vector<size_t> fd_workers;
+
+		for (size_t i = 0; i < workers.size(); ++i) {
+			if (workers[i].fd >= 0 && busy[i].frame >= 0) {
+				struct pollfd pfd;
+				pfd.fd = workers[i].fd;
+				pfd.events = POLLIN;
+				pfd.revents = 0;
+				fds.push_back(pfd);
+				fd_workers.push_back(i);
+			}
+		}
+
+		if (fds.empty()) {
+			bool any_alive = false;
+			for (size_t i = 0; i < workers.size(); ++i) {
+				any_alive = any_alive || workers[i].fd >= 0;
+			}
+
+			if (any_alive) {
+				continue;
+			}
+
+			// No workers left, so render the rest here
+			if (!jobs.empty()) {
+				const struct TileJob job = jobs.front();
+				jobs.pop_front();
+
+				const struct View &view = views[job.frame];
+				RenderRows(bufs[job.frame] + (size_t)job.y0 * view.width * 4,
+					view, job.y0, job.rows);
+
+				done.push_back(job);
+			}
+		}
+		else if (poll(&fds[0], fds.size(), -1) < 0) {
+			std::perror("poll");
+			continue;
+		}
+
+		for (size_t k = 0; k < fds.size(); ++k) {
+			if (fds[k].revents == 0) {
+				continue;
+			}
+
+			const size_t i = fd_workers[k];
+			const struct TileJob job = busy[i];
+			const struct View &view = views[job.frame];
+
+			struct TileResult result;
+			const bool received =
+				ReadAll(workers[i].fd, &result, sizeof(result)) &&
+				result.frame == job.frame &&
+				result.y0 == job.y0 &&
+				result.rows == job.rows &&
+				result.width == view.width &&
+				ReadAll(workers[i].fd,
+					bufs[job.frame] + (size_t)job.y0 * view.width * 4,
+					(size_t)job.rows * view.width * 4);
+
+			busy[i].frame = -1;
+
+			if (received) {
+				done.push_back(job);
+				continue;
+			}
+
+			std::cerr
+				<< "Worker " << workers[i].pid << " died. "
+				<< "Retrying its tile.\n";
+			jobs.push_front(job);
+			EndChild(&workers[i]);
+
+			if (worker_respawns_left > 0) {
+				worker_respawns_left -= 1;
+				StartWorker(&workers[i]);
+			}
+		}
+
+		for (size_t k = 0; k < done.size(); ++k) {
+			const int f = done[k].frame;
+			rows_left[f] -= done[k].rows;
+
+			if (rows_left[f] == 0) {
+				std::stringstream ss;
+				ss << "screenshots/hmap_" << batch_id << "_"
+				   << (first_num + f) << ".png";
+
+				SavePNG(bufs[f], views[f].width, views[f].height, ss.str());
+
+				delete[] bufs[f];
+				bufs[f] = NULL;
+				frames_left -= 1;
+			}
+		}
+	}
+}
+
+// Whether --scaling was given.
+// If so, every group of frames is also rendered by this process alone
+//  to compare with the workers.
+bool measure_scaling = false;
+double distributed_seconds = 0.0;
+double single_seconds = 0.0;
+
+// Set by --golden: the directory of reference images
+//  that batch frames are checked against instead of being saved
+const char *golden_dir = NULL;
+// Whether --update was given, replacing the reference images
+bool golden_update = false;
+// What became of the frames checked against reference images
+int golden_passed = 0;
+int golden_failed = 0;
+int golden_written = 0;
+// A line per frame: its number, result, time and differences
+std::ofstream golden_results;
+
+// Check frame `num`, rendered as `image` in `seconds`,
+//  against the reference image of the same number in golden_dir.
+// With --update, the reference is written instead.
+// A frame that fails, or has no reference, is written next to where the
+//  reference is, with a diff image if there is a reference.
+static void CheckGolden(
+	const std::vector<Uint8> &image,
+	const struct View &view,
+	const int num,
+	const double seconds)
+{
+	std::stringstream ss;
+	ss << golden_dir << "/" << num;
+	const std::string base = ss.str();
+	const std::string path = base + ".png";
+
+	int w = 0;
+	int h = 0;
+	int n;
+	Uint8 *const reference = golden_update
+		? NULL : stbi_load(path.c_str(), &w, &h, &n, 4);
+
+	std::stringstream result;
+	result << num << " " << std::setw(8) << seconds * 1000.0 << " ms ";
+
+	if (golden_update) {
+		if (stbi_write_png(path.c_str(), view.width, view.height, 4,
+			&image[0], view.width * 4) == 0)
+		{
+			std::cerr << "Failed to write reference image to " << path << "\n";
+			golden_failed += 1;
+			result << "FAILED to write the reference image";
+		}
+		else {
+			golden_written += 1;
+			result << "wrote the reference image";
+
+			// Left by an earlier run that failed
+			std::remove((base + "_diff.png").c_str());
+			std::remove((base + "_failed.png").c_str());
+		}
+	}
+	else {
+		bool passed = false;
+
+		if (reference == NULL) {
+			result << "FAILED: no reference image (write it with --update)";
+		}
+		else if (w != view.width || h != view.height) {
+			result << "FAILED: the reference image is " << w << "x" << h;
+		}
+		else {
+			struct ImageDifference difference;
+			CompareImages(reference, &image[0], w, h, golden_threshold,
+				&difference);
+
+			const double percent =
+				100.0 * difference.differing / ((double)w * h);
+			passed = percent <= golden_percent
+				&& difference.ssim >= golden_ssim;
+
+			result
+				<< (passed ? "passed: " : "FAILED: ") << percent
+				<< "% of pixels differ by more than " << golden_threshold
+				<< " (at most " << difference.max_difference << "), SSIM "
+				<< difference.ssim;
+
+			if (!passed) {
+				std::vector<Uint8> diff(image.size());
+				DiffImage(reference, &image[0], w, h, golden_threshold,
+					&diff[0]);
+				stbi_write_png((base + "_diff.png").c_str(), w, h, 4,
+					&diff[0], w * 4);
+			}
+		}
+
+		if (passed) {
+			golden_passed += 1;
+
+			// Left by an earlier run that failed
+			std::remove((base + "_diff.png").c_str());
+			std::remove((base + "_failed.png").c_str());
+		}
+		else {
+			golden_failed += 1;
+			stbi_write_png((base + "_failed.png").c_str(),
+				view.width, view.height, 4, &image[0], view.width * 4);
+		}
+
+		stbi_image_free(reference);
+	}
+
+	std::cout << "Frame " << result.str() << "\n";
+	golden_results << result.str() << "\n";
+}
+
+// Render the pending frames and clear them
+static void RenderPending(
+	std::vector<struct View> *pending,
+	const std::time_t batch_id,
+	int *frame_num)
+{
+	if (pending->empty()) {
+		return;
+	}
+
+	// One frame at a time so that each is timed
+	if (golden_dir != NULL) {
+		std::vector<struct View> single(1);
+		std::vector<std::vector<Uint8> > images;
+
+		for (size_t i = 0; i < pending->size(); ++i) {
+			single[0] = (*pending)[i];
+
+			const double start = omp_get_wtime();
+			RenderViews(single, batch_id, 0, false, &images);
+			const double seconds = omp_get_wtime() - start;
+
+			CheckGolden(images[0], single[0], *frame_num + (int)i, seconds);
+		}
+	}
+	// Workers only send back colors, not G-buffers
+	else if (workers.empty() || gbuffer_dump) {
+		RenderViews(*pending, batch_id, *frame_num);
+	}
+	else {
+		const double start = omp_get_wtime();
+		DistributeViews(*pending, batch_id, *frame_num);
+		distributed_seconds += omp_get_wtime() - start;
+
+		if (measure_scaling) {
+			const double single_start = omp_get_wtime();
+			RenderViews(*pending, batch_id, *frame_num, false);
+			single_seconds += omp_get_wtime() - single_start;
+		}
+	}
+
+	*frame_num += (int)pending->size();
+	pending->clear();
+}
+
+// Add `view` to the frames to render.
+// The pending frames are rendered first if the procedural tiles
+//  around its camera differ from theirs.
+static void QueueView(
+	const struct View &view,
+	std::vector<struct View> *pending,
+	const std::time_t batch_id,
+	int *frame_num)
+{
+	if (!ProceduralShows(view.cam_pos)) {
+		RenderPending(pending, batch_id, frame_num);
+		UpdateProcedural(view.cam_pos, true);
+	}
+
+	pending->push_back(view);
+}
+
+// Render the frames described by the file at `path` without a window.
+// The file holds config statements.
+// `frame` renders a frame with the current values.
+// `tween <n>` renders n frames moving the camera
+//  from where it was at the previous `frame`/`tween` to where it is now.
+static void RunBatch(const char *const path) {
+	std::ifstream input;
+	input.open(path);
+
+	if (!input.is_open()) {
+		std::cerr << "Failed to open batch file: " << path << "\n";
+		std::exit(1);
+	}
+
+	const std::time_t batch_id = std::time(NULL);
+
+	if (batch_id == (std::time_t)(-1)) {
+		std::cerr << "Failed to get time for batch.\n";
+		std::exit(1);
+	}
+
+	// Frames are rendered in groups of this many
+	//  so that few frames are in memory at once
+	//  but there is enough work to keep every thread busy.
+	const size_t max_pending = 4 * (size_t)omp_get_max_threads();
+
+	std::vector<struct View> pending;
+	int frame_num = 0;
+
+	// Camera at the previous `frame`/`tween`
+	struct View key = CaptureView();
+
+	// Config statements since the previous `frame`/`tween`
+	std::string statements;
+	bool statements_change_terrain = false;
+
+	std::string next;
+	while (true) {
+		const bool more = (bool)(input >> next);
+
+		if (more && next != "frame" && next != "tween") {
+			statements_change_terrain =
+				statements_change_terrain || ChangesTerrain(next);
+			statements += next + " ";
+			continue;
+		}
+
+		// Pending frames use the current terrains
+		if (statements_change_terrain) {
+			RenderPending(&pending, batch_id, &frame_num);
+			ForwardStatements(statements);
+		}
+
+		std::istringstream iss(statements);
+		ConsumeConfigStream(iss);
+		statements.clear();
+		statements_change_terrain = false;
+
+		if (!more) {
+			break;
+		}
+
+		const struct View target = CaptureView();
+
+		if (next == "frame") {
+			QueueView(target, &pending, batch_id, &frame_num);
+		}
+		else {
+			int n;
+			input >> n;
+
+			for (int i = 1; i <= n; ++i) {
+				QueueView(LerpView((double)i / n, key, target),
+					&pending, batch_id, &frame_num);
+			}
+		}
+
+		key = target;
+
+		if (pending.size() >= max_pending) {
+			RenderPending(&pending, batch_id, &frame_num);
+		}
+	}
+
+	RenderPending(&pending, batch_id, &frame_num);
+
+	std::cout << "Done rendering " << frame_num << " frames.\n";
+
+	if (golden_dir != NULL) {
+		std::cout
+			<< golden_passed << " frames passed, " << golden_failed
+			<< " failed and " << golden_written
+			<< " reference images were written\n";
+	}
+
+	if (engine_compare_failed > 0) {
+		std::cout
+			<< engine_compare_failed
+			<< " engine_compare over the tolerance\n";
+	}
+
+	if (alloc_check_failed > 0) {
+		std::cout
+			<< alloc_check_failed
+			<< " alloc_check found frames that allocate\n";
+	}
+
+	// Only counts rays traced in this process
+	if (beam_rays > 0) {
+		PrintBeamStats();
+	}
+
+	if (aa_pixels > 0) {
+		PrintAaStats();
+	}
+
+	if (!workers.empty()) {
+		std::cout
+			<< "Rendering with " << workers.size() << " workers took "
+			<< distributed_seconds << " s\n";
+	}
+
+	if (!workers.empty() && measure_scaling) {
+		const double speedup = single_seconds / distributed_seconds;
+
+		std::cout
+			<< "Rendering in one process took " << single_seconds << " s\n"
+			<< "Speedup: " << speedup << "\n"
+			<< "Scaling efficiency: "
+			<< (100.0 * speedup / (double)workers.size()) << "%\n";
+	}
+}
+
+// Largest width or height of a frame that a client can ask for
+#define SERVER_MAX_SIZE 16384
+// Bytes read from a client at a time
+#define SERVER_READ_SIZE 65536
+
+// A connection to the render server
+struct ServerClient {
+	int fd;
+	// Number shown in the log, counting connections from 0
+	int id;
+	// Start of a statement word cut off by the end of the last read
+	std::string partial;
+	// Config statements since the client's last frame
+	std::string statements;
+	bool statements_change_terrain;
+	// Camera of the client's last frame, which the next one starts from
+	struct View view;
+	// Frames asked for so far
+	int frames;
+};
+
+// A frame that a client asked for
+struct ServerRequest {
+	size_t client;
+	// Number of the frame among the client's frames
+	int frame;
+	std::string statements;
+	bool statements_change_terrain;
+	bool png;
+	// When `frame` was read
+	double received;
+
+	// Set once the statements are applied:
+	//  the frame's view, or why it cannot be rendered
+	struct View view;
+	std::string error;
+};
+
+// Set the camera and resolution globals to those of `view`
+static void ApplyView(const struct View &view) {
+	cam_pos = view.cam_pos;
+	hang = view.hang;
+	vang = view.vang;
+	hfov = view.hfov;
+	ortho_width = view.ortho_width;
+	image_plane = view.image_plane;
+	screen_width = view.width;
+	screen_height = view.height;
+}
+
+// Append PNG bytes written by stbi_write_png_to_func to a vector
+static void AppendBytes(void *const context, void *const data, const int size) {
+	std::vector<unsigned char> *const bytes =
+		(std::vector<unsigned char>*)context;
+	const unsigned char *const begin = (const unsigned char*)data;
+
+	bytes->insert(bytes->end(), begin, begin + size);
+}
+
+// Split what was read from `client` into statement words,
+//  adding a request for each `frame` or `frame_raw` to `requests`
+static void ReadRequests(
+	struct ServerClient *const client,
+	const size_t index,
+	const char *const data,
+	const size_t size,
+	std::vector<struct ServerRequest> *const requests)
+{
+	client->partial.append(data, size);
+
+	size_t begin = 0;
+
+	while (true) {
+		while (begin < client->partial.size()
+			&& std::isspace((unsigned char)client->partial[begin]))
+		{
+			begin += 1;
+		}
+
+		size_t end = begin;
+
+		while (end < client->partial.size()
+			&& !std::isspace((unsigned char)client->partial[end]))
+		{
+			end += 1;
+		}
+
+		// The word may go on in the next read
+		if (end == client->partial.size()) {
+			break;
+		}
+
+		const std::string word = client->partial.substr(begin, end - begin);
+		begin = end;
+
+		if (word != "frame" && word != "frame_raw") {
+			client->statements_change_terrain =
+				client->statements_change_terrain || ChangesTerrain(word);
+			client->statements += word + " ";
+			continue;
+		}
+
+		struct ServerRequest request;
+		request.client = index;
+		request.frame = client->frames;
+		request.statements = client->statements;
+		request.statements_change_terrain = client->statements_change_terrain;
+		request.png = word == "frame";
+		request.received = omp_get_wtime();
+		requests->push_back(request);
+
+		client->frames += 1;
+		client->statements.clear();
+		client->statements_change_terrain = false;
+	}
+
+	client->partial.erase(0, begin);
+}
+
+// Send the frame in `image` in answer to `request`.
+// Returns false if the client's socket failed.
+static bool SendFrame(
+	const struct ServerClient &client,
+	const struct ServerRequest &request,
+	const std::vector<Uint8> &image,
+	const int batched)
+{
+	const struct View &view = request.view;
+	std::vector<unsigned char> png;
+	const unsigned char *data = &image[0];
+	size_t size = image.size();
+
+	if (request.png) {
+		if (stbi_write_png_to_func(AppendBytes, &png,
+			view.width, view.height, 4, &image[0], view.width * 4) == 0)
+		{
+			png.clear();
+		}
+
+		data = png.empty() ? NULL : &png[0];
+		size = png.size();
+	}
+
+	const double ms = (omp_get_wtime() - request.received) * 1000.0;
+
+	std::stringstream header;
+	header
+		<< "frame " << request.frame << " " << view.width << " "
+		<< view.height << " " << (request.png ? "png" : "raw") << " "
+		<< size << " " << ms << "\n";
+
+	std::cout
+		<< "Client " << client.id << " frame " << request.frame << ": "
+		<< view.width << "x" << view.height << " in " << ms << " ms ("
+		<< batched << " frames rendered together)" << std::endl;
+
+	const std::string text = header.str();
+
+	return WriteAll(client.fd, text.data(), text.size())
+		&& (size == 0 || WriteAll(client.fd, data, size));
+}
+
+// Send a line with request.error in answer to `request`.
+// Returns false if the client's socket failed.
+static bool SendError(
+	const struct ServerClient &client,
+	const struct ServerRequest &request)
+{
+	std::cout
+		<< "Client " << client.id << " frame " << request.frame << ": "
+		<< request.error << std::endl;
+
+	std::stringstream ss;
+	ss << "error " << request.frame << " " << request.error << "\n";
+	const std::string text = ss.str();
+
+	return WriteAll(client.fd, text.data(), text.size());
+}
+
+// Render the frames of `requests` together and answer them in order,
+//  then clear them
+static void AnswerRequests(
+	std::vector<struct ServerClient> *const clients,
+	std::vector<struct ServerRequest> *const requests)
+{
+	std::vector<struct View> views;
+
+	for (size_t i = 0; i < requests->size(); ++i) {
+		if ((*requests)[i].error.empty()) {
+			views.push_back((*requests)[i].view);
+		}
+	}
+
+	std::vector<std::vector<Uint8> > images;
+	RenderViews(views, 0, 0, false, &images);
+
+	size_t image = 0;
+
+	for (size_t i = 0; i < requests->size(); ++i) {
+		const struct ServerRequest &request = (*requests)[i];
+		struct ServerClient &client = (*clients)[request.client];
+
+		bool sent = true;
+
+		if (!request.error.empty()) {
+			sent = client.fd < 0 || SendError(client, request);
+		}
+		else {
+			sent = client.fd < 0 || SendFrame(client, request,
+				images[image], (int)views.size());
+			image += 1;
+		}
+
+		if (!sent) {
+			std::cout << "Client " << client.id << " disconnected\n";
+			close(client.fd);
+			client.fd = -1;
+		}
+	}
+
+	requests->clear();
+}
+
+// Apply the statements of each request in the order they came,
+//  starting from the camera of the client's last frame,
+//  and render the frames of as many of them together as the terrain allows
+static void ServeRequests(
+	std::vector<struct ServerClient> *const clients,
+	const std::vector<struct ServerRequest> &requests)
+{
+	std::vector<struct ServerRequest> batch;
+
+	for (size_t i = 0; i < requests.size(); ++i) {
+		struct ServerRequest request = requests[i];
+		struct ServerClient &client = (*clients)[request.client];
+
+		// Frames already batched use the current terrains
+		if (request.statements_change_terrain) {
+			AnswerRequests(clients, &batch);
+		}
+
+		ApplyView(client.view);
+
+		std::istringstream iss(request.statements);
+		config_error = &request.error;
+		ConsumeConfigStream(iss);
+		config_error = NULL;
+
+		request.view = CaptureView();
+		client.view = request.view;
+
+		const struct View &view = request.view;
+
+		if (!request.error.empty()) {
+			// A statement failed, so answer with why
+			batch.push_back(request);
+			continue;
+		}
+
+		if (view.width < 2 || view.height < 2
+			|| view.width > SERVER_MAX_SIZE || view.height > SERVER_MAX_SIZE)
+		{
+			std::stringstream ss;
+			ss << "resolution must be from 2 to " << SERVER_MAX_SIZE;
+			request.error = ss.str();
+		}
+		else if (!ProceduralShows(view.cam_pos)) {
+			AnswerRequests(clients, &batch);
+			UpdateProcedural(view.cam_pos, true);
+		}
+
+		batch.push_back(request);
+	}
+
+	AnswerRequests(clients, &batch);
+}
+
+// Render frames for clients connecting to `address`
+//  (a Unix socket path or localhost TCP port) until killed.
+// Clients send config statements like a `--batch` file.
+// `frame` answers with a PNG image and `frame_raw` with RGBA rows,
+//  after a line "frame <number> <width> <height> png|raw <bytes> <ms>".
+// Each client's camera and resolution are its own
+//  but other options are shared by all clients.
+static void RunServer(const char *const address) {
+	const int listener = ListenLocal(address);
+
+	if (listener < 0) {
+		std::cerr << "Failed to listen on " << address << "\n";
+		std::exit(1);
+	}
+
+	std::cout << "Listening on " << address << std::endl;
+
+	// Where every client's camera starts
+	const struct View initial = CaptureView();
+
+	std::vector<struct ServerClient> clients;
+	std::vector<struct ServerRequest> requests;
+	std::vector<struct pollfd> fds;
+	std::vector<char> buf(SERVER_READ_SIZE);
+	int connections = 0;
+
+	while (true) {
+		fds.clear();
+
+		struct pollfd pfd;
+		pfd.fd = listener;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		fds.push_back(pfd);
+
+		for (size_t i = 0; i < clients.size(); ++i) {
+			pfd.fd = clients[i].fd;
+			fds.push_back(pfd);
+		}
+
+		if (poll(&fds[0], fds.size(), -1) < 0) {
+			if (errno != EINTR) {
+				std::perror("poll");
+			}
+
+			continue;
+		}
+
+		// Requests that came in together are rendered together
+		for (size_t i = 0; i < clients.size(); ++i) {
+			if (fds[i + 1].revents == 0) {
+				continue;
+			}
+
+			const ssize_t n = read(clients[i].fd, &buf[0], buf.size());
+
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+
+			if (n <= 0) {
+				std::cout << "Client " << clients[i].id << " disconnected\n";
+				close(clients[i].fd);
+				clients[i].fd = -1;
+				continue;
+			}
+
+			ReadRequests(&clients[i], i, &buf[0], (size_t)n, &requests);
+		}
+
+		ServeRequests(&clients, requests);
+		requests.clear();
+
+		// Forget closed clients, which no request refers to now
+		size_t kept = 0;
+		for (size_t i = 0; i < clients.size(); ++i) {
+			if (clients[i].fd >= 0) {
+				clients[kept] = clients[i];
+				kept += 1;
+			}
+		}
+		clients.resize(kept);
+
+		if (fds[0].revents != 0) {
+			const int fd = AcceptLocal(listener);
+
+			if (fd >= 0) {
+				struct ServerClient client;
+				client.fd = fd;
+				client.id = connections;
+				client.statements_change_terrain = false;
+				client.view = initial;
+				client.frames = 0;
+				clients.push_back(client);
+
+				std::cout << "Client " << client.id << " connected" << std::endl;
+				connections += 1;
+			}
+		}
+	}
+}
+
+// Set the text of `overlay`, rendering it with `font` on `bg`
+//  only if it changed.
+// Returns false if the texture could not be created.
+static bool SetOverlayText(
+	SDL_Renderer *const renderer,
+	TTF_Font *const font,
+	const char *const text,
+	const SDL_Color bg,
+	struct TextOverlay *const overlay)
+{
+	if (overlay->text == text) {
+		return true;
+	}
+
+	overlay->text.assign(text);
+
+	SDL_DestroyTexture(overlay->tex);
+	overlay->tex = NULL;
+
+	if (text[0] == '\0') {
+		return true;
+	}
+
+	const SDL_Color fg = {255, 255, 255, 255};
+	SDL_Surface *const surface = TTF_RenderUTF8_Shaded(font, text, fg, bg);
+
+	if (surface == NULL) {
+		return true;
+	}
+
+	overlay->tex = SDL_CreateTextureFromSurface(renderer, surface);
+	overlay->w = surface->w;
+	overlay->h = surface->h;
+
+	SDL_FreeSurface(surface);
+
+	return overlay->tex != NULL;
+}
+
+// Render the printable ASCII characters of `font` once for the HUD.
+// The font is monospaced, so they are rendered as one line
+//  and cut into glyphs of equal widths.
+static void LoadHudFont(TTF_Font *const font) {
+	char chars[128];
+	int count = 0;
+
+	for (char c = ' '; c <= '~'; ++c) {
+		chars[count++] = c;
+	}
+
+	chars[count] = '\0';
+
+	const SDL_Color fg = {255, 255, 255, 255};
+	const SDL_Color bg = {0, 0, 0, 255};
+	SDL_Surface *const line = TTF_RenderUTF8_Shaded(font, chars, fg, bg);
+	SDL_Surface *const rgba = line == NULL
+		? NULL
+		: SDL_ConvertSurfaceFormat(line, SDL_PIXELFORMAT_ABGR8888, 0);
+
+	SDL_FreeSurface(line);
+
+	if (rgba == NULL) {
+		std::cerr << "WARNING: Failed to render the HUD's glyphs: "
+			<< TTF_GetError() << "\n";
+		return;
+	}
+
+	// White on black, so red is the coverage
+	const int glyph_width = rgba->w / count;
+	const int atlas_width = glyph_width * count;
+	std::vector<unsigned char> coverage((size_t)atlas_width * rgba->h);
+
+	for (int y = 0; y < rgba->h; ++y) {
+		const Uint8 *const row = (const Uint8*)rgba->pixels + y * rgba->pitch;
+
+		for (int x = 0; x < atlas_width; ++x) {
+			coverage[(size_t)y * atlas_width + x] = row[x * 4];
+		}
+	}
+
+	hud.SetFont(&coverage[0], glyph_width, rgba->h);
+
+	SDL_FreeSurface(rgba);
+}
+
+// Draw `overlay` with its upper left corner at (x, y)
+static void DrawOverlay(
+	SDL_Renderer *const renderer,
+	const struct TextOverlay &overlay,
+	const int x,
+	const int y)
+{
+	if (overlay.tex != NULL) {
+		SDL_Rect dst_rect = {x, y, overlay.w, overlay.h};
+		SDL_RenderCopy(renderer, overlay.tex, NULL, &dst_rect);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// main
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+	const char *batch_path = NULL;
+	const char *serve_address = NULL;
+	int worker_count = 0;
+	// Set if this process is a worker
+	int worker_fd = -1;
+	int worker_threads = 1;
+	bool usage_error = (argc < 2);
+
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+
+		if (arg == "--batch" && i + 1 < argc) {
+			batch_path = argv[++i];
+		}
+		else if (arg == "--workers" && i + 1 < argc) {
+			const char *const count = argv[++i];
+			char *end;
+			const long n = std::strtol(count, &end, 10);
+
+			// A whole number of workers, from 0
+			if (end == count || *end != '\0' || n < 0 || n > INT_MAX) {
+				usage_error = true;
+			}
+			else {
+				worker_count = (int)n;
+			}
+		}
+		else if (arg == "--serve" && i + 1 < argc) {
+			serve_address = argv[++i];
+		}
+		else if (arg == "--golden" && i + 1 < argc) {
+			golden_dir = argv[++i];
+		}
+		else if (arg == "--update") {
+			golden_update = true;
+		}
+		else if (arg == "--scaling") {
+			measure_scaling = true;
+		}
+		else if (arg == "--worker" && i + 2 < argc) {
+			worker_threads = std::atoi(argv[++i]);
+			worker_fd = std::atoi(argv[++i]);
+		}
+		else {
+			usage_error = true;
+		}
+	}
+
+	if (usage_error || (worker_count > 0 && batch_path == NULL)
+		|| (batch_path != NULL && serve_address != NULL)
+		|| (golden_dir != NULL && (batch_path == NULL || worker_count > 0))
+		|| (golden_update && golden_dir == NULL))
+	{
+		std::cerr
+			<< "USAGE: hmap.exe path/to/config.txt "
+			<< "[--batch path/to/frames.txt [--workers <n> [--scaling]"
+			<< " | --golden path/to/dir [--update]]"
+			<< " | --serve <port or socket path>]\n";
+		std::exit(1);
+	}
+
+	program_name = argv[0];
+	config_path = argv[1];
+
+	// Messages from ConsumeConfigStream would be mixed into the
+	//  coordinator's output
+	if (worker_fd >= 0 && std::freopen("/dev/null", "w", stdout) == NULL) {
+		std::cerr << "Worker failed to silence stdout\n";
+	}
+
+	// Parse input file
+
+	std::ifstream input;
+	input.open(argv[1]);
+
+	if (!input.is_open()) {
+		std::cerr << "Failed to open input file: " << argv[1] << "\n";
+		std::exit(1);
+	}
+
+	ConsumeConfigStream(input);
+
+	input.close();
+
+	if (worker_fd >= 0) {
+		RunWorker(worker_fd, worker_threads);
+		std::exit(0);
+	}
+
+	if (serve_address != NULL) {
+		// Clients that go away are noticed by failed writes
+		std::signal(SIGPIPE, SIG_IGN);
+
+		RunServer(serve_address);
+	}
+
+	if (batch_path != NULL) {
+		// Dead workers are noticed by failed reads and writes
+		std::signal(SIGPIPE, SIG_IGN);
+
+		workers.resize((size_t)worker_count);
+		worker_respawns_left = 2 * worker_count;
+
+		for (size_t i = 0; i < workers.size(); ++i) {
+			if (!StartWorker(&workers[i])) {
+				std::cerr << "Failed to start worker " << i << "\n";
+			}
+		}
+
+		if (golden_dir != NULL) {
+			const std::string results_path =
+				std::string(golden_dir) + "/results.txt";
+			golden_results.open(results_path.c_str());
+
+			if (!golden_results.is_open()) {
+				std::cerr << "Failed to open " << results_path << "\n";
+				std::exit(1);
+			}
+		}
+
+		RunBatch(batch_path);
+
+		for (size_t i = 0; i < workers.size(); ++i) {
+			EndChild(&workers[i]);
+		}
+
+		stbi_image_free((void*)base_heightmap_buf);
+		delete[] heightmap_buf;
+		stbi_image_free((void*)colormap_buf);
+		FreeInstances();
+
+		return (golden_failed > 0 || engine_compare_failed > 0
+			|| alloc_check_failed > 0) ? 1 : 0;
+	}
+
+	// Initialize libraries
+
+	class ManageSDL {
+	public:
+		ManageSDL() {
+			if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+				std::cerr << "SDL_Init failed: " << SDL_GetError() << "\n";
+				std::exit(1);
+			}
+		}
+
+		~ManageSDL() { SDL_Quit(); }
+	};
+	const ManageSDL manage_sdl;
+
+	class ManageTTF {
+	public:
+		ManageTTF() {
+			if (TTF_Init() != 0) {
+				std::cerr << "TTF_Init failed: " << TTF_GetError() << "\n";
+				std::exit(1);
+			}
+		}
+
+		~ManageTTF() { TTF_Quit(); }
+	};
+	const ManageTTF manage_ttf;
+
+	const char font_path[] = "fonts/NotoSansMono-Regular.ttf";
+	TTF_Font *const font = TTF_OpenFont(font_path, 12);
+
+	if (font == NULL) {
+		std::cerr << "Failed to open font at: " << font_path << "\n";
+		std::exit(1);
+	}
+
+	LoadHudFont(font);
+
+	window = SDL_CreateWindow(
+		"Heightmap Ray Marcher",
+		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		screen_width, screen_height,
+		SDL_WINDOW_RESIZABLE);
+
+	if (window == NULL) {
+		std::cerr << "SDL_CreateWindow failed: " << SDL_GetError() << "\n";
+		std::exit(1);
+	}
+
+	SDL_Renderer *renderer =
+		SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+
+	if (renderer == NULL) {
+		std::cerr << "Failed to create renderer: " << SDL_GetError() << "\n";
+		exit(1);
+	}
+
+	SDL_Texture *tex = SDL_CreateTexture(
+		renderer,
+		SDL_PIXELFORMAT_ABGR8888,
+		SDL_TEXTUREACCESS_STREAMING,
+		screen_width, screen_height);
+
+	if (tex == NULL) {
+		std::cerr << "Failed to create texture: " << SDL_GetError() << "\n";
+		std::exit(1);
+	}
+
+	Uint8 *framebuf = new Uint8[screen_width * screen_height * 4];
+
+	// The framebuffer and texture only grow,
+	//  so that resizing the window back and forth does not reallocate them.
+	// The texture's upper left screen_width x screen_height is drawn.
+	size_t framebuf_size = (size_t)screen_width * screen_height * 4;
+	int tex_width = screen_width;
+	int tex_height = screen_height;
+
+	std::srand((unsigned)std::time(NULL));
+
+	bool quit = false;
+
+	struct TextOverlay console_overlay = {"", NULL, 0, 0};
+	struct TextOverlay loading_overlay = {"", NULL, 0, 0};
+
+	load_assets_async = true;
+
+	// To avoid the text changing too frequently to be readable,
+	//  update the text only every X ms.
+	const Uint32 text_surface_rerender_period_ms = 200;
+	Uint32 text_surface_rerender_timer_ms = text_surface_rerender_period_ms + 1;
+
+	bool console_active = false;
+	std::string console_buf;
+	console_buf.assign(" ");
+
+	Uint32 old_time = SDL_GetTicks();// milliseconds
+	Uint32 new_time;
+	Uint32 delta;
+	double ddelta;
+
+	if (SDL_SetRelativeMouseMode(SDL_TRUE)) {
+		std::cerr << "Initial SDL_SetRelativeMouseMode failed: "
+		          << SDL_GetError() << "\n";
+		std::exit(1);
+	}
+
+	bool recording = false;
+	// Auto-generated identifier (currently, unix epoch in seconds)
+	// that will differ from id of any existing recordings,
+	// so that frames can be written to image files
+	// without overwriting any files.
+	std::time_t recording_id = 0;
+	// Current frame number while recording. Frame 0 is first frame.
+	int recording_frame_num = 0;
+
+	// The HUD's lines, formatted as often as the text overlays
+	char hud_lines[6][64];
+	int hud_line_count = 0;
+	// Texture the HUD is drawn over the window from, which only grows
+	SDL_Texture *hud_tex = NULL;
+	int hud_tex_width = 0;
+	int hud_tex_height = 0;
+	double hud_ms = 0.0;
+	// What the HUD covered when it was drawn into `framebuf`,
+	//  put back before the next frame is drawn over it
+	std::vector<Uint8> hud_under;
+	SDL_Rect hud_under_rect = {0, 0, 0, 0};
+
+	double frame_start = omp_get_wtime();
+
+	// Reused between frames
+	struct Cameras cameras;
+	struct ViewPrep view_prep;
+	std::vector<struct PixelHit> gbuffer;
+
+	// While open, the camera of every frame is written to this file
+	//  so that the path can be rendered again with --batch.
+	std::ofstream camera_path;
+
+	while (!quit) {
+		new_time = SDL_GetTicks();
+		delta = new_time - old_time;
+		ddelta = (double)delta;
+		old_time = new_time;
+
+		text_surface_rerender_timer_ms += delta;
+
+		// Swap in images loaded in the background
+		FinishAssetLoad();
+		// Recordings get every frame of the sequence
+		UpdateSequence(ddelta, recording);
+		// Recordings get every tile at full detail
+		UpdateProcedural(cam_pos, recording);
+
+		glm::dvec3 forward(
+			cos(hang),
+			sin(hang),
+			0.0
+		);
+
+		double right_hang = hang - (M_PI / 2.0);
+		glm::dvec3 right(
+			cos(right_hang),
+			sin(right_hang),
+			0.0
+		);
+
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT) {
+				quit = true;
+			}
+			else if (event.type == SDL_WINDOWEVENT) {
+				if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+					// Maybe different call if high DPI allowed
+					//  when window created
+					SDL_GetWindowSize(window, &screen_width, &screen_height);
+
+					const size_t size = (size_t)screen_width * screen_height * 4;
+
+					// Not where it was anymore
+					hud_under_rect.w = 0;
+					hud_under_rect.h = 0;
+
+					if (size > framebuf_size) {
+						delete[] framebuf;
+						framebuf = new Uint8[size];
+						framebuf_size = size;
+					}
+
+					if (screen_width > tex_width || screen_height > tex_height) {
+						tex_width = std::max(tex_width, screen_width);
+						tex_height = std::max(tex_height, screen_height);
+
+						SDL_DestroyTexture(tex);
+						tex = SDL_CreateTexture(
+							renderer,
+							SDL_PIXELFORMAT_ABGR8888,
+							SDL_TEXTUREACCESS_STREAMING,
+							tex_width, tex_height);
+
+						if (tex == NULL) {
+							std::cerr << "Failed to recreate texture: "
+							          << SDL_GetError() << "\n";
+							std::exit(1);
+						}
+					}
+				}
+				else if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+					// The brush needs the cursor
+					const SDL_bool relative =
+						brush_active ? SDL_FALSE : SDL_TRUE;
+
+					if (SDL_SetRelativeMouseMode(relative)) {
+						std::cerr
+							<< "FOCUS_GAINED SDL_SetRelativeMouseMode failed: "
+							<< SDL_GetError() << "\n";
+					}
+				}
+				else if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+					if (SDL_SetRelativeMouseMode(SDL_FALSE)) {
+						std::cerr
+							<< "FOCUS_LOST SDL_SetRelativeMouseMode failed: "
+							<< SDL_GetError() << "\n";
+					}
+				}
+			}
+			else if (event.type == SDL_MOUSEMOTION && !brush_active) {
+				hang -= mouse_sens * 0.00025 * event.motion.xrel * ddelta;
+				vang += mouse_sens * 0.00025 * event.motion.yrel * ddelta;
+
+				if (vang < 0.0) {
+					vang = 0.0;
+				}
+				else if (vang > M_PI) {
+					vang = M_PI;
+				}
+			}
+			else if (event.type == SDL_MOUSEWHEEL && brush_active) {
+				brush_radius *= std::pow(1.1, event.wheel.y);
+				PrintBrushRadius();
+			}
+			else if (event.type == SDL_MOUSEWHEEL) {
+				if (image_plane == IMAGEPLANE_PERSPECTIVE ||
+					image_plane == IMAGEPLANE_SPHERICAL)
+				{
+					const double new_hfov =
+						hfov - (scroll_sens * 0.03 * event.wheel.y);
+
+					if (new_hfov > 0.0 && new_hfov < M_PI) {
+						hfov = new_hfov;
+					}
+				}
+				else if (image_plane == IMAGEPLANE_ORTHOGRAPHIC) {
+					const double new_ortho_width =
+						ortho_width - (scroll_sens * 0.0075 * event.wheel.y);
+
+					if (new_ortho_width > 0.0) {
+						ortho_width = new_ortho_width;
+					}
+				}
+			}
+			else if (event.type == SDL_TEXTINPUT && console_active) {
+				console_buf.append(event.text.text);
+			}
+			else if (event.type == SDL_KEYUP) {
+				const SDL_Keymod mod_state = SDL_GetModState();
+
+				switch (event.key.keysym.sym) {
+				case SDLK_q:
+				{
+					if (mod_state & KMOD_CTRL) {
+						quit = true;
+					}
+
+					break;
+				}
+				case SDLK_BACKQUOTE:
+				{
+					console_active = !console_active;
+
+					if (console_active) {
+						console_buf.assign(" ");
+					}
+
+					break;
+				}
+				case SDLK_BACKSPACE:
+				{
+					// Do not permit deleting the leading space
+					if (console_active && console_buf.length() > 1) {
+						console_buf.erase(console_buf.length() - 1, 1);
+					}
+
+					break;
+				}
+				case SDLK_RETURN:
+				{
+					if (console_active) {
+						console_active = false;
+						std::istringstream iss(console_buf);
+						ConsumeConfigStream(iss);
+						console_buf.assign(" ");
+					}
+
+					break;
+				}
+				case SDLK_b:
+				{
+					if (console_active || mod_state != KMOD_NONE) {
+						break;
+					}
+
+					brush_active = !brush_active;
+
+					if (SDL_SetRelativeMouseMode(
+						brush_active ? SDL_FALSE : SDL_TRUE))
+					{
+						std::cerr << "SDL_SetRelativeMouseMode failed: "
+						          << SDL_GetError() << "\n";
+					}
+
+					std::cout
+						<< "Brush " << (brush_active ? "on" : "off") << "\n";
+
+					break;
+				}
+				case SDLK_F1:
+				{
+					show_hud = !show_hud;
+					break;
+				}
+				case SDLK_F11:
+					// Ignore F11 press
+					//  if any of Alt, Shift, Ctrl, etc. are down
+					if (mod_state != KMOD_NONE) {
+						break;
+					}
+
+					fullscreen = !fullscreen;
+
+					if (fullscreen) {
+						SDL_SetWindowFullscreen(
+							window, SDL_WINDOW_FULLSCREEN_DESKTOP);
+					}
+					else {
+						SDL_SetWindowFullscreen(window, 0);
+					}
+
+					break;
+				case SDLK_F12:
+				{
+					if (mod_state != KMOD_NONE) {
+						break;
+					}
+
+					std::time_t seconds = std::time(NULL);
+
+					if (seconds == (std::time_t)(-1)) {
+						std::cerr
+							<< "Failed to get time for screenshot. "
+							<< "Screenshot NOT saved.\n";
+					}
+					else {
+						std::stringstream ss;
+						ss << "screenshots/hmap_" << seconds << ".png";
+						std::string path = ss.str();
+
+						if (aa_capture_samples > 0) {
+							// Render it again with the capture anti-aliasing
+							const struct View capture = CaptureView();
+							const size_t count =
+								(size_t)capture.width * capture.height;
+							std::vector<Uint8> image(count * 4);
+							std::vector<struct PixelHit> capture_gbuffer(count);
+
+							double render_seconds;
+							RenderTimed(&image[0], &capture_gbuffer[0],
+								capture, &render_seconds);
+
+							SavePNG(&image[0], capture.width, capture.height,
+								path);
+
+							if (gbuffer_dump) {
+								SaveGBuffer(&capture_gbuffer[0],
+									capture.width, capture.height, path);
+							}
+						}
+						else {
+							SavePNG(framebuf, screen_width, screen_height, path);
+
+							if (gbuffer_dump && gbuffer.size()
+								== (size_t)screen_width * screen_height)
+							{
+								SaveGBuffer(&gbuffer[0],
+									screen_width, screen_height, path);
+							}
+						}
+					}
+
+					break;
+				}
+				case SDLK_1:
+					if (!console_active) {
+						image_plane = IMAGEPLANE_PERSPECTIVE;
+					}
+
+					break;
+				case SDLK_2:
+					if (!console_active) {
+						image_plane = IMAGEPLANE_SPHERICAL;
+					}
+
+					break;
+				case SDLK_3:
+					if (!console_active) {
+						image_plane = IMAGEPLANE_ORTHOGRAPHIC;
+					}
+
+					break;
+				case SDLK_p:
+				{
+					const bool ctrl_and_shift = (mod_state & KMOD_CTRL) &&
+					                            (mod_state & KMOD_SHIFT);
+
+					if (console_active || !ctrl_and_shift) {
+						break;
+					}
+
+					if (camera_path.is_open()) {
+						camera_path.close();
+						std::cout << "Done recording camera path.\n";
+						break;
+					}
+
+					std::time_t seconds = std::time(NULL);
+
+					if (seconds == (std::time_t)(-1)) {
+						std::cerr
+							<< "Failed to get time for camera path. "
+							<< "Camera path NOT recorded.\n";
+						break;
+					}
+
+					std::stringstream ss;
+					ss << "screenshots/hmap_" << seconds << "_path.txt";
+					camera_path.open(ss.str().c_str());
+
+					if (!camera_path.is_open()) {
+						std::cerr
+							<< "Failed to open camera path file "
+							<< ss.str() << "\n";
+					}
+					else {
+						std::cout
+							<< "Recording camera path to " << ss.str() << "\n";
+					}
+
+					break;
+				}
+				case SDLK_r:
+				{
+					const bool ctrl_and_shift = (mod_state & KMOD_CTRL) &&
+					                            (mod_state & KMOD_SHIFT);
+
+					if (!console_active && ctrl_and_shift) {
+						if (!recording) {
+							recording = true;
+							recording_frame_num = 0;
+
+							recording_id = std::time(NULL);
+
+							// move_speed = 0.0;
+							// mouse_sens = 0.0;
+							// scroll_sens = 0.0;
+							// cycle_period = 1;
+
+							if (recording_id == (std::time_t)(-1)) {
+								std::cerr
+									<< "Failed to get time for recording. "
+									<< "Recording NOT started.\n";
+
+								recording = false;
+							}
+						}
+						else {
+							recording = !recording;
+						}
+					}
+
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+
+		// If you do not intend to manually move the camera while recording,
+		// before starting the recording, consider setting in the console:
+		//     move 0
+		//     mouse_sens 0
+		//     scroll_sens 0
+		//
+		// Also consider `cycle 1` so that frames are complete images.
+		//
+		// For a programmatic animation, alter this block and recompile.
+		if (recording)
+		{
+			// const double t =
+			// 	((double)recording_frame_num) / recording_frame_count;
+			//
+			// // Change some global parameters.
+			//
+			// // We need to update the heightmap if we have changed any
+			// // global parameters that have an effect on it.
+			// // This does nothing when they have not changed.
+			// UpdateHeightmap();
+			// UpdateTerrains();
+		}
+
+		// Not counting the events, which allocate as they please
+		const long long allocs_before = AllocCount();
+
+		const Uint8 *const kb_state = SDL_GetKeyboardState(NULL);
+		const SDL_Keymod mod_state = SDL_GetModState();
+
+		if (!console_active && mod_state == KMOD_NONE) {
+			if (kb_state[SDL_SCANCODE_W]) {
+				cam_pos += ddelta * move_speed * forward;
+			}
+			if (kb_state[SDL_SCANCODE_S]) {
+				cam_pos -= ddelta * move_speed * forward;
+			}
+			if (kb_state[SDL_SCANCODE_D]) {
+				cam_pos += ddelta * move_speed * right;
+			}
+			if (kb_state[SDL_SCANCODE_A]) {
+				cam_pos -= ddelta * move_speed * right;
+			}
+			if (kb_state[SDL_SCANCODE_SPACE]) {
+				cam_pos.z += ddelta * move_speed;
+			}
+			if (kb_state[SDL_SCANCODE_Q]) {
+				cam_pos.z -= ddelta * move_speed;
+			}
+		}
+
+		const struct View view = recording ? CaptureView() : CurrentView();
+
+		if (brush_active && !console_active) {
+			int mouse_x;
+			int mouse_y;
+			const Uint32 buttons = SDL_GetMouseState(&mouse_x, &mouse_y);
+
+			int mode = 0;
+			if (buttons & SDL_BUTTON_LMASK) {
+				mode = (mod_state & KMOD_SHIFT) ? BRUSH_SMOOTH : BRUSH_RAISE;
+			}
+			else if (buttons & SDL_BUTTON_RMASK) {
+				mode = BRUSH_LOWER;
+			}
+
+			int gridx;
+			int gridy;
+
+			if (mode != 0
+				&& PickHeightmap(view, mouse_x, mouse_y, &gridx, &gridy))
+			{
+				ApplyBrush(mode, gridx, gridy, ddelta / 1000.0);
+			}
+		}
+
+		// Interlaced frames keep the pixels they do not draw
+		for (int y = 0; y < hud_under_rect.h; ++y) {
+			std::memcpy(
+				framebuf + ((size_t)(hud_under_rect.y + y) * screen_width
+					+ hud_under_rect.x) * 4,
+				&hud_under[(size_t)y * hud_under_rect.w * 4],
+				(size_t)hud_under_rect.w * 4);
+		}
+
+		hud_under_rect.w = 0;
+		hud_under_rect.h = 0;
+
+		const double march_start = omp_get_wtime();
+		struct FrameStats frame_stats;
+		const long long aa_rays_before = aa_rays;
+
+		cycle = (cycle + 1) % cycle_period;
+
+		RenderFrame(framebuf, view, cycle_period, cycle,
+			&cameras, &view_prep, &gbuffer, &frame_stats.busy);
+
+		frame_stats.march_ms = (omp_get_wtime() - march_start) * 1000.0;
+		frame_stats.march_rays = hud_march_rays;
+		frame_stats.steps = hud_steps;
+		frame_stats.rays = hud_march_rays + (aa_rays - aa_rays_before);
+		hud_march_rays = 0;
+		hud_steps = 0;
+
+		if (text_surface_rerender_timer_ms >= text_surface_rerender_period_ms)
+		{
+			text_surface_rerender_timer_ms = 0;
+
+			// Formatted in place rather than with a stringstream,
+			//  which would allocate every time
+			char text[1024];
+			const SDL_Color console_bg = {50, 100, 250, 255};
+			bool ok = true;
+
+			if (show_hud) {
+				const struct FrameStats average =
+					hud.Average(text_surface_rerender_period_ms);
+				const double frame_ms = std::max(average.frame_ms, 1e-3);
+				const double pixels = (double)view.width * view.height;
+
+				std::snprintf(hud_lines[0], sizeof(hud_lines[0]),
+					"%.1f ms %.0f fps  hud %.3f ms",
+					frame_ms, 1000.0 / frame_ms, hud_ms);
+				std::snprintf(hud_lines[1], sizeof(hud_lines[1]),
+					"march %.1f ms  present %.1f ms",
+					average.march_ms, average.present_ms);
+				std::snprintf(hud_lines[2], sizeof(hud_lines[2]),
+					"%.2f Mrays/s  %.1f steps/ray",
+					(double)average.rays / frame_ms / 1000.0,
+					(double)average.steps
+						/ (double)std::max(average.march_rays, 1LL));
+
+				if (average.busy >= 0.0) {
+					std::snprintf(hud_lines[3], sizeof(hud_lines[3]),
+						"%d threads  %.0f%% busy",
+						omp_get_max_threads(), 100.0 * average.busy);
+				}
+				else {
+					std::snprintf(hud_lines[3], sizeof(hud_lines[3]),
+						"%d threads", omp_get_max_threads());
+				}
+
+				std::snprintf(hud_lines[4], sizeof(hud_lines[4]),
+					"%dx%d  %.2f rays/px",
+					view.width, view.height, (double)average.rays / pixels);
+
+				hud_line_count = 5;
+
+				if (sequence != NULL && sequence->shown >= 0) {
+					std::snprintf(hud_lines[5], sizeof(hud_lines[5]),
+						"sequence %d/%d (lag %d)",
+						sequence->shown % (int)sequence->paths.size() + 1,
+						(int)sequence->paths.size(),
+						(int)sequence->position - sequence->shown);
+					hud_line_count = 6;
+				}
+			}
+
+			ok = ok && SetOverlayText(renderer, font, console_buf.c_str(),
+				console_bg, &console_overlay);
+
+			text[0] = '\0';
+
+			if (asset_load != NULL) {
+				std::snprintf(text, sizeof(text), "Loading%s%s%s%s %d%%",
+					asset_load->heightmap_path.empty() ? "" : " ",
+					asset_load->heightmap_path.c_str(),
+					asset_load->colormap_path.empty() ? "" : " ",
+					asset_load->colormap_path.c_str(),
+					SDL_AtomicGet(&asset_load->progress));
+			}
+			else if (SDL_GetTicks() < asset_status_until_ms) {
+				std::snprintf(text, sizeof(text), "%s", asset_status.c_str());
+			}
+
+			ok = ok && SetOverlayText(renderer, font, text, console_bg,
+				&loading_overlay);
+
+			if (!ok) {
+				std::cerr << "Failed to create texture for text: "
+					<< SDL_GetError() << "\n";
+				break;
+			}
+		}
+
+		if (show_hud && hud_line_count > 0) {
+			const double hud_start = omp_get_wtime();
+
+			const char *lines[6];
+			for (int i = 0; i < hud_line_count; ++i) {
+				lines[i] = hud_lines[i];
+			}
+
+			hud.Draw(lines, hud_line_count);
+
+			if (hud_record) {
+				hud_under_rect.x = 5;
+				hud_under_rect.y = 2;
+				hud_under_rect.w = std::min(hud.Width(), screen_width - 5);
+				hud_under_rect.h = std::min(hud.Height(), screen_height - 2);
+
+				if (hud_under_rect.w <= 0 || hud_under_rect.h <= 0) {
+					hud_under_rect.w = 0;
+					hud_under_rect.h = 0;
+				}
+
+				const size_t under_size =
+					(size_t)hud_under_rect.w * hud_under_rect.h * 4;
+
+				if (hud_under.size() < under_size) {
+					hud_under.resize(under_size);
+				}
+
+				for (int y = 0; y < hud_under_rect.h; ++y) {
+					std::memcpy(
+						&hud_under[(size_t)y * hud_under_rect.w * 4],
+						framebuf + ((size_t)(hud_under_rect.y + y) * screen_width
+							+ hud_under_rect.x) * 4,
+						(size_t)hud_under_rect.w * 4);
+				}
+
+				hud.Composite(framebuf, screen_width, screen_height,
+					hud_under_rect.x, hud_under_rect.y);
+			}
+			else {
+				if (hud.Width() > hud_tex_width || hud.Height() > hud_tex_height) {
+					hud_tex_width = std::max(hud_tex_width, hud.Width());
+					hud_tex_height = std::max(hud_tex_height, hud.Height());
+
+					SDL_DestroyTexture(hud_tex);
+					hud_tex = SDL_CreateTexture(
+						renderer,
+						SDL_PIXELFORMAT_ABGR8888,
+						SDL_TEXTUREACCESS_STREAMING,
+						hud_tex_width, hud_tex_height);
+
+					if (hud_tex == NULL) {
+						std::cerr << "Failed to create HUD texture: "
+						          << SDL_GetError() << "\n";
+						std::exit(1);
+					}
+				}
+
+				const SDL_Rect hud_rect = {0, 0, hud.Width(), hud.Height()};
+				SDL_UpdateTexture(hud_tex, &hud_rect, hud.Pixels(),
+					hud.Width() * 4);
+			}
+
+			hud_ms = (omp_get_wtime() - hud_start) * 1000.0;
+		}
+
+		const double present_start = omp_get_wtime();
+
+		const SDL_Rect screen_rect = {0, 0, screen_width, screen_height};
+		SDL_UpdateTexture(tex, &screen_rect, framebuf, screen_width * 4);
+		SDL_RenderClear(renderer);
+		SDL_RenderCopy(renderer, tex, &screen_rect, NULL);
+
+		// The overlays other than a recorded HUD will not appear
+		//  in screenshots and recordings because they are sent
+		//  'straight to the renderer' rather than being put into `framebuf`
+
+		const bool hud_shown = show_hud && hud_line_count > 0;
+
+		if (hud_shown && !hud_record) {
+			const SDL_Rect src_rect = {0, 0, hud.Width(), hud.Height()};
+			const SDL_Rect dst_rect = {5, 2, hud.Width(), hud.Height()};
+			SDL_RenderCopy(renderer, hud_tex, &src_rect, &dst_rect);
+		}
+
+		// Below the HUD
+		DrawOverlay(renderer, loading_overlay, 5,
+			hud_shown ? hud.Height() + 4 : 2);
+
+		if (console_active) {
+			DrawOverlay(renderer, console_overlay,
+				0, screen_height - console_overlay.h - 10);
+		}
+
+		SDL_RenderPresent(renderer);
+
+		const double frame_end = omp_get_wtime();
+		frame_stats.present_ms = (frame_end - present_start) * 1000.0;
+		frame_stats.frame_ms = (frame_end - frame_start) * 1000.0;
+		frame_start = frame_end;
+		hud.AddFrame(frame_stats);
+
+		frame_allocs += AllocCount() - allocs_before;
+		alloc_frames += 1;
+
+		if (camera_path.is_open()) {
+			WriteViewFrame(camera_path, view);
+		}
+
+		if (recording) {
+			std::stringstream ss;
+			ss << "screenshots/hmap_" << recording_id << "_"
+			   << recording_frame_num << ".png";
+
+			SavePNG(framebuf, screen_width, screen_height, ss.str());
+
+			if (gbuffer_dump) {
+				SaveGBuffer(&gbuffer[0], screen_width, screen_height, ss.str());
+			}
+
+			recording_frame_num += 1;
+
+			if (recording_frame_num == recording_frame_count) {
+				recording = false;
+				std::cout << "Done recording.\n";
+			}
+		}
+	} // while (!quit)
+
+	SDL_DestroyWindow(window);
+	SDL_DestroyRenderer(renderer);
+	SDL_DestroyTexture(tex);
+	SDL_DestroyTexture(hud_tex);
+	SDL_DestroyTexture(console_overlay.tex);
+	SDL_DestroyTexture(loading_overlay.tex);
+
+	if (asset_load != NULL) {
+		SDL_WaitThread(asset_load_thread, NULL);
+		FreeAssetLoad(asset_load);
+		asset_load = NULL;
+	}
+
+	StopSequence();
+	StopProcedural();
+
+	TTF_CloseFont(font);
+
+	stbi_image_free((void*)base_heightmap_buf);
+	delete[] heightmap_buf;
+	stbi_image_free((void*)colormap_buf);
+	FreeInstances();
+
+	delete[] framebuf;
+
+	return 0;
+}
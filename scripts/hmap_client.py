@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# Ask a render server (`hmap config.txt --serve <address>`) for frames
+#  and check that the answers are well formed.
+#
+# Usage: scripts/hmap_client.py <address> [statements...]
+#
+# `address` is a Unix socket path if it contains a `/`, otherwise a TCP port
+#  on localhost, as for `--serve`.
+# The statements, e.g. `resolution 320 180 pos 0 0 5`, are sent before
+#  one `frame` and one `frame_raw`.
+# Prints each answer's header and exits with 1 if any answer is an error
+#  or does not match its header.
+
+import socket
+import sys
+
+PNG_SIGNATURE = b"\x89PNG\r\n\x1a\n"
+
+
+def connect(address):
+	if "/" in address:
+		sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		sock.connect(address)
+	else:
+		sock = socket.create_connection(("127.0.0.1", int(address)))
+
+	return sock
+
+
+# Read a line without its newline from `reader`, or None at the end
+def read_line(reader):
+	line = reader.readline()
+
+	if not line.endswith(b"\n"):
+		return None
+
+	return line[:-1].decode()
+
+
+# Read the answer to the frame numbered `number`
+#  and return why it is wrong, or None
+def check_answer(reader, number, png):
+	line = read_line(reader)
+
+	if line is None:
+		return "connection closed before frame %d" % number
+
+	print(line)
+	words = line.split()
+
+	if words[0] == "error":
+		return line
+
+	if words[0] != "frame" or len(words) != 7:
+		return "bad header: %s" % line
+
+	frame, width, height, kind, size = (
+		int(words[1]), int(words[2]), int(words[3]), words[4], int(words[5]))
+	data = reader.read(size)
+
+	if frame != number:
+		return "expected frame %d, got %d" % (number, frame)
+
+	if len(data) != size:
+		return "frame %d: got %d of %d bytes" % (frame, len(data), size)
+
+	if png:
+		if kind != "png" or not data.startswith(PNG_SIGNATURE):
+			return "frame %d: not a PNG" % frame
+	else:
+		if kind != "raw" or size != width * height * 4:
+			return "frame %d: %d bytes for %dx%d RGBA" % (
+				frame, size, width, height)
+
+	return None
+
+
+def main():
+	if len(sys.argv) < 2:
+		sys.stderr.write(
+			"Usage: %s <address> [statements...]\n" % sys.argv[0])
+		return 2
+
+	sock = connect(sys.argv[1])
+	statements = " ".join(sys.argv[2:])
+	sock.sendall((statements + "\nframe\nframe_raw\n").encode())
+
+	reader = sock.makefile("rb")
+	errors = [
+		check_answer(reader, 0, True),
+		check_answer(reader, 1, False),
+	]
+	sock.close()
+
+	failed = False
+
+	for error in errors:
+		if error is not None:
+			sys.stderr.write(error + "\n")
+			failed = True
+
+	return 1 if failed else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
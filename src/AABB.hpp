@@ -1,14 +1,26 @@
-#ifndef AABB_HPP
-#define AABB_HPP
-
-#include <limits>
-#include "glm/glm.hpp"
-#include "Ray.hpp"
-
-// Axis Aligned Bounding Box intersection with a ray
-
-bool intersection(glm::dvec3 *out, struct Ray ray, glm::dvec3 c0, glm::dvec3 c1);
-
-double distance(struct Ray ray, glm::dvec3 c0, glm::dvec3 c1);
-
-#endif
+#ifndef AABB_HPP
+#define AABB_HPP
+
+#include <limits>
+#include "glm/glm.hpp"
+#include "Ray.hpp"
+
+// Axis Aligned Bounding Box intersection with a ray
+
+bool intersection(glm::dvec3 *out, struct Ray ray, glm::dvec3 c0, glm::dvec3 c1);
+
+double distance(struct Ray ray, glm::dvec3 c0, glm::dvec3 c1);
+
+// Same as above but also writes the distance at which the ray leaves the box.
+// `exit` is only written if the ray hits the box.
+double distance(struct Ray ray, glm::dvec3 c0, glm::dvec3 c1, double *exit);
+
+// Most points that clip_box can write
+#define CLIP_BOX_MAX_POINTS 20
+
+// Write to `out` points whose convex hull is the part of the box
+//  on the side of the plane (through `point`) that `normal` points to.
+// Returns the number of points, 0 if the box is entirely behind the plane.
+int clip_box(glm::dvec3 *out, glm::dvec3 c0, glm::dvec3 c1, glm::dvec3 point, glm::dvec3 normal);
+
+#endif
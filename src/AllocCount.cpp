@@ -0,0 +1,32 @@
+#include "AllocCount.hpp"
+
+#include <cstdlib>
+#include <new>
+
+static long long alloc_count = 0;
+
+long long AllocCount() {
+	long long count;
+
+	#pragma omp atomic read
+	count = alloc_count;
+
+	return count;
+}
+
+void *operator new(std::size_t size) throw(std::bad_alloc) {
+	#pragma omp atomic
+	alloc_count += 1;
+
+	void *const p = std::malloc(size > 0 ? size : 1);
+
+	if (p == NULL) {
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void operator delete(void *p) throw() {
+	std::free(p);
+}
@@ -0,0 +1,11 @@
+#ifndef ALLOCCOUNT_HPP
+#define ALLOCCOUNT_HPP
+
+// Calls of the global operator new (and new[]) since the program started.
+// Replacing the operators in a file of their own
+//  keeps the compiler from seeing them where they are called.
+// Memory that C code gets from malloc is not counted:
+//  that of SDL, stb_image and the OpenMP runtime, for example.
+long long AllocCount();
+
+#endif
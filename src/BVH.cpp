@@ -0,0 +1,252 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "AABB.hpp"
+
+// Terrains per leaf at most
+#define BVH_LEAF_SIZE 2
+// Splits are at the median so depth is at most log2 of the terrain count.
+// Each level leaves at most one node on the stack.
+#define BVH_STACK_SIZE 64
+
+static glm::dvec3 MinCorner(const struct Terrain &t) {
+	return glm::min(t.c0, t.c1);
+}
+
+static glm::dvec3 MaxCorner(const struct Terrain &t) {
+	return glm::max(t.c0, t.c1);
+}
+
+// Corners of where MarchTerrain samples the terrain:
+//  its grid at any height, and up to a grid width before
+//  the first row and column, which are truncated into the grid.
+static glm::dvec3 ColumnMin(const struct Terrain &t) {
+	return glm::dvec3(t.c0.x - t.grid_width, t.c1.y, -1e300);
+}
+
+static glm::dvec3 ColumnMax(const struct Terrain &t) {
+	return glm::dvec3(t.c1.x, t.c0.y + t.grid_width, 1e300);
+}
+
+// Orders terrain indices by the center of their boxes along one axis
+class CenterLess {
+public:
+	CenterLess(const std::vector<struct Terrain> &t, int a)
+		: terrains(&t), axis(a) {}
+
+	bool operator()(int a, int b) const {
+		const double ca = (*terrains)[a].c0[axis] + (*terrains)[a].c1[axis];
+		const double cb = (*terrains)[b].c0[axis] + (*terrains)[b].c1[axis];
+
+		return ca < cb;
+	}
+
+private:
+	const std::vector<struct Terrain> *terrains;
+	int axis;
+};
+
+BVH::BVH() {
+	terrains = NULL;
+}
+
+void BVH::Build(const std::vector<struct Terrain> &t) {
+	terrains = &t;
+	nodes.clear();
+	order.clear();
+
+	if (t.empty()) {
+		return;
+	}
+
+	for (int i = 0; i < (int)t.size(); ++i) {
+		order.push_back(i);
+	}
+
+	nodes.reserve(2 * t.size());
+	BuildRange(0, (int)t.size());
+}
+
+// Build node over order[begin, end) and return its index
+int BVH::BuildRange(int begin, int end) {
+	const std::vector<struct Terrain> &t = *terrains;
+
+	Node node;
+	node.c0 = MinCorner(t[order[begin]]);
+	node.c1 = MaxCorner(t[order[begin]]);
+	node.left = -1;
+	node.right = -1;
+	node.first = begin;
+	node.count = end - begin;
+
+	glm::dvec3 center_lo = 0.5 * (node.c0 + node.c1);
+	glm::dvec3 center_hi = center_lo;
+
+	for (int i = begin + 1; i < end; ++i) {
+		const glm::dvec3 lo = MinCorner(t[order[i]]);
+		const glm::dvec3 hi = MaxCorner(t[order[i]]);
+		const glm::dvec3 center = 0.5 * (lo + hi);
+
+		node.c0 = glm::min(node.c0, lo);
+		node.c1 = glm::max(node.c1, hi);
+		center_lo = glm::min(center_lo, center);
+		center_hi = glm::max(center_hi, center);
+	}
+
+	const int index = (int)nodes.size();
+	nodes.push_back(node);
+
+	if (end - begin <= BVH_LEAF_SIZE) {
+		return index;
+	}
+
+	// Split at the median along the axis with the widest spread of centers
+	const glm::dvec3 spread = center_hi - center_lo;
+	int axis = 0;
+	if (spread.y > spread[axis]) axis = 1;
+	if (spread.z > spread[axis]) axis = 2;
+
+	const int mid = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + mid,
+		order.begin() + end, CenterLess(t, axis));
+
+	const int left = BuildRange(begin, mid);
+	const int right = BuildRange(mid, end);
+
+	nodes[index].left = left;
+	nodes[index].right = right;
+	nodes[index].count = 0;
+
+	return index;
+}
+
+int BVH::Trace(
+	struct Ray ray,
+	const struct MarchParams &march,
+	struct TerrainHit *hit) const
+{
+	long long skipped = 0;
+	long long steps = 0;
+
+	return Trace(ray, 0.0, march, hit, &skipped, &steps);
+}
+
+int BVH::Trace(
+	struct Ray ray,
+	double start,
+	const struct MarchParams &march,
+	struct TerrainHit *hit,
+	long long *skipped,
+	long long *steps) const
+{
+	if (nodes.empty()) {
+		return -1;
+	}
+
+	const double inf = std::numeric_limits<double>::infinity();
+
+	int hit_index = -1;
+	hit->t = inf;
+
+	// Nodes to visit and the distance at which the ray enters them
+	int stack_node[BVH_STACK_SIZE];
+	double stack_entry[BVH_STACK_SIZE];
+	int top = 0;
+
+	double exit;
+	double entry = distance(ray, nodes[0].c0, nodes[0].c1, &exit);
+
+	if (entry == inf || exit < 0.0) {
+		return -1;
+	}
+
+	stack_node[top] = 0;
+	stack_entry[top] = entry;
+	top += 1;
+
+	while (top > 0) {
+		top -= 1;
+		const Node &node = nodes[stack_node[top]];
+
+		// Anything in this node is farther than what was already hit
+		if (stack_entry[top] >= hit->t) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; ++i) {
+				const struct Terrain &terrain = (*terrains)[order[i]];
+				const double d = distance(ray, terrain.c0, terrain.c1);
+
+				// Same as `intersection`:
+				//  a ray starting inside the box does not hit it
+				if (d == inf || d < 0.0 || d >= hit->t) {
+					continue;
+				}
+
+				// Known to be above the surface until it leaves the grid
+				if (start > d) {
+					double column_exit;
+					const double column_d = distance(ray,
+						ColumnMin(terrain), ColumnMax(terrain), &column_exit);
+
+					if (column_d != inf && start >= column_exit) {
+						*skipped +=
+							(long long)((column_exit - d) / march.step_dist);
+						continue;
+					}
+				}
+
+				struct TerrainHit h;
+				if (MarchTerrain(terrain, ray, d, start, march, hit->t,
+					&h, skipped, steps))
+				{
+					*hit = h;
+					hit_index = order[i];
+				}
+			}
+
+			continue;
+		}
+
+		double exit_l;
+		double exit_r;
+		double entry_l =
+			distance(ray, nodes[node.left].c0, nodes[node.left].c1, &exit_l);
+		double entry_r =
+			distance(ray, nodes[node.right].c0, nodes[node.right].c1, &exit_r);
+
+		const bool hit_l = entry_l != inf && exit_l >= 0.0;
+		const bool hit_r = entry_r != inf && exit_r >= 0.0;
+
+		if (entry_l < 0.0) entry_l = 0.0;
+		if (entry_r < 0.0) entry_r = 0.0;
+
+		// Push the farther child first so the nearer one is visited first
+		if (hit_l && hit_r) {
+			const bool left_first = entry_l <= entry_r;
+
+			stack_node[top] = left_first ? node.right : node.left;
+			stack_entry[top] = left_first ? entry_r : entry_l;
+			top += 1;
+
+			stack_node[top] = left_first ? node.left : node.right;
+			stack_entry[top] = left_first ? entry_l : entry_r;
+			top += 1;
+		}
+		else if (hit_l) {
+			stack_node[top] = node.left;
+			stack_entry[top] = entry_l;
+			top += 1;
+		}
+		else if (hit_r) {
+			stack_node[top] = node.right;
+			stack_entry[top] = entry_r;
+			top += 1;
+		}
+	}
+
+	return hit_index;
+}
@@ -0,0 +1,61 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Ray.hpp"
+#include "Terrain.hpp"
+
+// Bounding volume hierarchy over the bounding boxes of terrains
+class BVH {
+public:
+	// Build the hierarchy over the given terrains.
+	// The vector is referenced, not copied,
+	//  so it must outlive the BVH and not change until the next Build.
+	void Build(const std::vector<struct Terrain> &terrains);
+
+	// Visit nodes nearest first and march the terrains in the leaves.
+	// Returns the index of the terrain that was hit or -1 if none was.
+	int Trace(
+		struct Ray ray,
+		const struct MarchParams &march,
+		struct TerrainHit *hit) const;
+
+	// Same as above but marching from no nearer than distance `start`.
+	// Adds the number of steps of step_dist skipped to `*skipped`
+	//  and the number of steps marched to `*steps`.
+	int Trace(
+		struct Ray ray,
+		double start,
+		const struct MarchParams &march,
+		struct TerrainHit *hit,
+		long long *skipped,
+		long long *steps) const;
+
+	BVH();
+
+private:
+	struct Node {
+		glm::dvec3 c0;
+		glm::dvec3 c1;
+
+		// Child node indices if internal
+		int left;
+		int right;
+
+		// Range in `order` if leaf. count is 0 if internal.
+		int first;
+		int count;
+	};
+
+	int BuildRange(int begin, int end);
+
+	const std::vector<struct Terrain> *terrains;
+	std::vector<Node> nodes;
+	// Indices into `terrains` sorted so that each leaf covers a range
+	std::vector<int> order;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "Beam.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// How much longer each segment is than the parameter it starts at,
+//  so that far away the number of segments grows only logarithmically
+#define BEAM_SEGMENT_GROWTH 0.05
+
+static int ClampIndex(double v, int size) {
+	if (v < 0.0) {
+		return 0;
+	}
+
+	if (v > size - 1) {
+		return size - 1;
+	}
+
+	return (int)v;
+}
+
+// Whether a point in the box could be below the terrain's surface.
+// Matches MarchTerrain: the surface is at height + c0.z,
+//  and points up to a grid width before the grid's first row and column
+//  are truncated into it.
+static bool BoxMayHit(
+	const glm::dvec3 &bmin,
+	const glm::dvec3 &bmax,
+	const struct Terrain &terrain)
+{
+	const glm::dvec3 c0 = terrain.c0;
+	const double gw = terrain.grid_width;
+
+	const double gx0 = std::floor((bmin.x - c0.x) / gw);
+	const double gx1 = std::floor((bmax.x - c0.x) / gw);
+	const double gy0 = std::floor((c0.y - bmax.y) / gw);
+	const double gy1 = std::floor((c0.y - bmin.y) / gw);
+
+	if (gx1 < -1.0 || gx0 > terrain.width - 1
+		|| gy1 < -1.0 || gy0 > terrain.height - 1)
+	{
+		return false;
+	}
+
+	const double max_height = terrain.mip->MaxHeight(
+		ClampIndex(gx0, terrain.width), ClampIndex(gy0, terrain.height),
+		ClampIndex(gx1, terrain.width), ClampIndex(gy1, terrain.height));
+
+	return bmin.z < max_height + c0.z;
+}
+
+double BeamStart(
+	const struct Beam &beam,
+	const std::vector<struct Terrain> &terrains,
+	double min_ds)
+{
+	// Farthest along the axis that a ray could hit a terrain,
+	//  with the same slack as in BoxMayHit
+	//  and a segment's length below the bottom for the last step down.
+	double far = -HUGE_VAL;
+	double top = -HUGE_VAL;
+
+	for (size_t i = 0; i < terrains.size(); ++i) {
+		const struct Terrain &t = terrains[i];
+		const glm::dvec3 lo = glm::min(t.c0, t.c1);
+		const glm::dvec3 hi = glm::max(t.c0, t.c1);
+
+		const glm::dvec3 column_lo(
+			lo.x - t.grid_width,
+			lo.y,
+			std::min(lo.z, 2.0 * lo.z) - min_ds);
+		const glm::dvec3 column_hi(
+			hi.x,
+			hi.y + t.grid_width,
+			std::max(hi.z, hi.z + lo.z));
+
+		for (int c = 0; c < 8; ++c) {
+			const glm::dvec3 corner(
+				(c & 1) ? column_hi.x : column_lo.x,
+				(c & 2) ? column_hi.y : column_lo.y,
+				(c & 4) ? column_hi.z : column_lo.z);
+
+			far = std::max(far, glm::dot(corner, beam.axis));
+		}
+
+		top = std::max(top, column_hi.z);
+	}
+
+	double s_end = 0.0;
+	bool rising = true;
+
+	for (int i = 0; i < 4; ++i) {
+		const double along = glm::dot(beam.dir[i], beam.axis);
+
+		// The beam may never get past the terrains
+		if (along <= 0.0) {
+			return 0.0;
+		}
+
+		s_end = std::max(s_end,
+			(far - glm::dot(beam.pos[i], beam.axis)) / along);
+
+		rising = rising && beam.dir[i].z >= 0.0;
+	}
+
+	double s = 0.0;
+	while (s < s_end) {
+		const double s1 = s + std::max(min_ds, s * BEAM_SEGMENT_GROWTH);
+
+		glm::dvec3 bmin = beam.pos[0] + s * beam.dir[0];
+		glm::dvec3 bmax = bmin;
+
+		for (int i = 0; i < 4; ++i) {
+			const glm::dvec3 a = beam.pos[i] + s * beam.dir[i];
+			const glm::dvec3 b = beam.pos[i] + s1 * beam.dir[i];
+
+			bmin = glm::min(bmin, glm::min(a, b));
+			bmax = glm::max(bmax, glm::max(a, b));
+		}
+
+		// Above everything and never coming down
+		if (rising && bmin.z >= top) {
+			return s_end;
+		}
+
+		for (size_t i = 0; i < terrains.size(); ++i) {
+			if (BoxMayHit(bmin, bmax, terrains[i])) {
+				return s;
+			}
+		}
+
+		s = s1;
+	}
+
+	return s_end;
+}
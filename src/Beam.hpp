@@ -0,0 +1,33 @@
+#ifndef BEAM_HPP
+#define BEAM_HPP
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Terrain.hpp"
+
+// A bundle of rays bounded by four corner rays.
+// For every ray of the bundle, its point at parameter s
+//  is within the convex hull of the corner rays' points at s,
+//  where the corner ray i's point at s is pos[i] + s * dir[i].
+struct Beam {
+	glm::dvec3 pos[4];
+	glm::dvec3 dir[4];
+
+	// Unit direction along which all of dir[] advance,
+	//  so that the beam is past anything behind a plane
+	//  perpendicular to it eventually.
+	glm::dvec3 axis;
+};
+
+// The parameter s before which no ray of the beam
+//  can be below the surface of any of the terrains, going no further than
+//  the parameter at which the beam is past all of them.
+// `min_ds` is the shortest length of the segments the beam is tested in.
+double BeamStart(
+	const struct Beam &beam,
+	const std::vector<struct Terrain> &terrains,
+	double min_ds);
+
+#endif
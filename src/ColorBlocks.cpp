@@ -0,0 +1,226 @@
+#include "ColorBlocks.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ColorBlocks::ColorBlocks() {
+	width = 0;
+	height = 0;
+	blocks_wide = 0;
+}
+
+bool ColorBlocks::Empty() const {
+	return blocks.empty();
+}
+
+size_t ColorBlocks::Bytes() const {
+	return blocks.size();
+}
+
+void ColorBlocks::Clear() {
+	// Actually give back the memory
+	std::vector<unsigned char>().swap(blocks);
+	width = 0;
+	height = 0;
+	blocks_wide = 0;
+}
+
+// Nearest of `top` + 1 levels evenly spread over [0, 255] to `v`
+static unsigned int QuantizeChannel(double v, int top) {
+	v = std::min(std::max(v, 0.0), 255.0);
+	return (unsigned int)(v * top / 255.0 + 0.5);
+}
+
+// RGB565 of the nearest color to `rgb`
+static unsigned int Quantize(const double *rgb) {
+	return (QuantizeChannel(rgb[0], 31) << 11)
+		| (QuantizeChannel(rgb[1], 63) << 5)
+		| QuantizeChannel(rgb[2], 31);
+}
+
+void ColorBlocks::BuildBlock(const unsigned char *rgba, int bx, int by) {
+	// The texels of the block, repeating the last ones past the edges
+	int texels[16][3];
+	bool transparent[16];
+	int opaque = 0;
+	double mean[3] = {0.0, 0.0, 0.0};
+
+	for (int i = 0; i < 16; ++i) {
+		const int x = std::min(bx * 4 + i % 4, width - 1);
+		const int y = std::min(by * 4 + i / 4, height - 1);
+		const unsigned char *const texel = rgba + ((size_t)y * width + x) * 4;
+
+		transparent[i] = texel[3] == 0;
+
+		for (int c = 0; c < 3; ++c) {
+			texels[i][c] = texel[c];
+		}
+
+		if (!transparent[i]) {
+			for (int c = 0; c < 3; ++c) {
+				mean[c] += texel[c];
+			}
+
+			opaque += 1;
+		}
+	}
+
+	unsigned char *const block =
+		&blocks[((size_t)by * blocks_wide + bx) * 8];
+
+	if (opaque == 0) {
+		// 3 colors (c0 <= c1) and all texels the 4th, transparent one
+		std::fill(block, block + 4, 0);
+		std::fill(block + 4, block + 8, 0xff);
+		return;
+	}
+
+	for (int c = 0; c < 3; ++c) {
+		mean[c] /= opaque;
+	}
+
+	// Covariance of the opaque colors: xx, xy, xz, yy, yz, zz
+	double cov[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+	for (int i = 0; i < 16; ++i) {
+		if (transparent[i]) {
+			continue;
+		}
+
+		const double d[3] = {
+			texels[i][0] - mean[0],
+			texels[i][1] - mean[1],
+			texels[i][2] - mean[2]
+		};
+
+		cov[0] += d[0] * d[0];
+		cov[1] += d[0] * d[1];
+		cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1];
+		cov[4] += d[1] * d[2];
+		cov[5] += d[2] * d[2];
+	}
+
+	// The end colors are on the line through the mean along which
+	//  the colors vary most, found by power iteration
+	double axis[3] = {1.0, 1.0, 1.0};
+
+	for (int k = 0; k < 4; ++k) {
+		const double next[3] = {
+			cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+			cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+			cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+		};
+		const double length = std::sqrt(
+			next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+
+		// All the same color
+		if (length < 1e-9) {
+			break;
+		}
+
+		for (int c = 0; c < 3; ++c) {
+			axis[c] = next[c] / length;
+		}
+	}
+
+	double t_min = 0.0;
+	double t_max = 0.0;
+
+	for (int i = 0; i < 16; ++i) {
+		if (transparent[i]) {
+			continue;
+		}
+
+		const double t =
+			(texels[i][0] - mean[0]) * axis[0]
+			+ (texels[i][1] - mean[1]) * axis[1]
+			+ (texels[i][2] - mean[2]) * axis[2];
+
+		t_min = std::min(t_min, t);
+		t_max = std::max(t_max, t);
+	}
+
+	double end0[3];
+	double end1[3];
+
+	for (int c = 0; c < 3; ++c) {
+		end0[c] = mean[c] + axis[c] * t_max;
+		end1[c] = mean[c] + axis[c] * t_min;
+	}
+
+	unsigned int c0 = Quantize(end0);
+	unsigned int c1 = Quantize(end1);
+
+	// The order of the end colors picks 4 colors (c0 > c1)
+	//  or 3 and transparent (c0 <= c1)
+	if (opaque < 16 ? c0 > c1 : c0 < c1) {
+		std::swap(c0, c1);
+	}
+
+	const unsigned int colors = c0 > c1 ? 4 : 3;
+	unsigned char palette[4][4];
+
+	for (unsigned int k = 0; k < colors; ++k) {
+		DecodeIndex(c0, c1, k, palette[k]);
+	}
+
+	unsigned int indices = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		unsigned int best = 3;
+
+		if (!transparent[i]) {
+			int best_distance = 0;
+
+			for (unsigned int k = 0; k < colors; ++k) {
+				int distance = 0;
+
+				for (int c = 0; c < 3; ++c) {
+					const int d = texels[i][c] - palette[k][c];
+					distance += d * d;
+				}
+
+				if (k == 0 || distance < best_distance) {
+					best = k;
+					best_distance = distance;
+				}
+			}
+		}
+
+		indices |= best << (i * 2);
+	}
+
+	block[0] = (unsigned char)(c0 & 0xff);
+	block[1] = (unsigned char)(c0 >> 8);
+	block[2] = (unsigned char)(c1 & 0xff);
+	block[3] = (unsigned char)(c1 >> 8);
+
+	for (int k = 0; k < 4; ++k) {
+		block[4 + k] = (unsigned char)((indices >> (k * 8)) & 0xff);
+	}
+}
+
+void ColorBlocks::Build(const unsigned char *rgba, int w, int h) {
+	width = w;
+	height = h;
+	blocks_wide = (w + 3) / 4;
+
+	const int blocks_high = (h + 3) / 4;
+	blocks.assign((size_t)blocks_wide * blocks_high * 8, 0);
+
+	#pragma omp parallel for if(blocks_wide * blocks_high > 4096)
+	for (int by = 0; by < blocks_high; ++by) {
+		for (int bx = 0; bx < blocks_wide; ++bx) {
+			BuildBlock(rgba, bx, by);
+		}
+	}
+}
+
+void ColorBlocks::Decode(unsigned char *rgba) const {
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			Texel(x, y, rgba + ((size_t)y * width + x) * 4);
+		}
+	}
+}
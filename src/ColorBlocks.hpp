@@ -0,0 +1,106 @@
+#ifndef COLORBLOCKS_HPP
+#define COLORBLOCKS_HPP
+
+#include <cstddef>
+#include <vector>
+
+// An RGBA image compressed to 8 bytes per block of 4x4 texels,
+//  laid out as BC1 (DXT1): two RGB565 end colors and a 2-bit index per texel
+//  into a palette of colors between them.
+// Only whether a texel is transparent (alpha 0) is kept of its alpha:
+//  blocks with transparent texels use 3 colors and the 4th index for them.
+class ColorBlocks {
+public:
+	// Compress `width` x `height` RGBA texels
+	void Build(const unsigned char *rgba, int width, int height);
+
+	void Clear();
+
+	// Write all the texels to `rgba`, width x height RGBA values
+	void Decode(unsigned char *rgba) const;
+
+	// Write to `rgba` the RGBA color of texel (x, y),
+	//  with alpha 0 if it was transparent and 255 otherwise
+	void Texel(int x, int y, unsigned char *rgba) const {
+		const unsigned char *const block =
+			&blocks[((size_t)(y >> 2) * blocks_wide + (x >> 2)) * 8];
+		const unsigned int c0 = block[0] | (block[1] << 8);
+		const unsigned int c1 = block[2] | (block[3] << 8);
+		const int shift = ((y & 3) * 4 + (x & 3)) * 2;
+		const unsigned int index = (block[4 + shift / 8] >> (shift % 8)) & 3;
+
+		DecodeIndex(c0, c1, index, rgba);
+	}
+
+	// Bytes taken by the blocks
+	size_t Bytes() const;
+
+	bool Empty() const;
+
+	ColorBlocks();
+
+private:
+	// Color `index` of the palette of end colors `c0` and `c1`
+	static void DecodeIndex(
+		unsigned int c0, unsigned int c1, unsigned int index,
+		unsigned char *rgba)
+	{
+		if (index == 3 && c0 <= c1) {
+			rgba[0] = 0;
+			rgba[1] = 0;
+			rgba[2] = 0;
+			rgba[3] = 0;
+			return;
+		}
+
+		const unsigned int end = index == 1 ? c1 : c0;
+		const int e0[3] = {
+			Expand5(end >> 11), Expand6(end >> 5), Expand5(end)
+		};
+
+		if (index < 2) {
+			for (int c = 0; c < 3; ++c) {
+				rgba[c] = (unsigned char)e0[c];
+			}
+		}
+		else {
+			const int e1[3] = {
+				Expand5(c1 >> 11), Expand6(c1 >> 5), Expand5(c1)
+			};
+
+			// A third (or half) of the way from one end color to the other
+			for (int c = 0; c < 3; ++c) {
+				if (c0 <= c1) {
+					rgba[c] = (unsigned char)((e0[c] + e1[c] + 1) / 2);
+				}
+				else if (index == 2) {
+					rgba[c] = (unsigned char)((2 * e0[c] + e1[c] + 1) / 3);
+				}
+				else {
+					rgba[c] = (unsigned char)((e0[c] + 2 * e1[c] + 1) / 3);
+				}
+			}
+		}
+
+		rgba[3] = 255;
+	}
+
+	static int Expand5(unsigned int v) {
+		v &= 31;
+		return (int)((v << 3) | (v >> 2));
+	}
+
+	static int Expand6(unsigned int v) {
+		v &= 63;
+		return (int)((v << 2) | (v >> 4));
+	}
+
+	void BuildBlock(const unsigned char *rgba, int bx, int by);
+
+	std::vector<unsigned char> blocks;
+	int width;
+	int height;
+	int blocks_wide;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "Heights.hpp"
+
+bool operator==(
+	const struct HeightParams &a,
+	const struct HeightParams &b)
+{
+	return a.lum_r == b.lum_r
+	    && a.lum_g == b.lum_g
+	    && a.lum_b == b.lum_b
+	    && a.min_height == b.min_height
+	    && a.max_height == b.max_height;
+}
+
+void ConvertHeights(
+	const unsigned char *const base,
+	const int num_pixels,
+	const struct HeightParams &params,
+	double *const out,
+	const bool parallel)
+{
+	// Weighted components by value, so that converting a pixel
+	//  is three lookups and no conversions from unsigned char
+	//  (which keep the loop from vectorizing on plain x86-64)
+	double weighted_r[256];
+	double weighted_g[256];
+	double weighted_b[256];
+	for (int i = 0; i < 256; ++i) {
+		weighted_r[i] = params.lum_r * i;
+		weighted_g[i] = params.lum_g * i;
+		weighted_b[i] = params.lum_b * i;
+	}
+
+	const double min_h = params.min_height;
+	const double scale = (params.max_height - min_h) / 255.0;
+
+	// No branches, so that it vectorizes
+	#pragma omp parallel for simd if(parallel) schedule(static)
+	for (int p = 0; p < num_pixels; ++p) {
+		const double value =
+			weighted_r[base[p * 3 + 0]] +
+			weighted_g[base[p * 3 + 1]] +
+			weighted_b[base[p * 3 + 2]];
+
+		const double above = value > 0.0 ? value : 0.0;
+		const double clamped = above < 255.0 ? above : 255.0;
+
+		out[p] = clamped * scale + min_h;
+	}
+}
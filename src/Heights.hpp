@@ -0,0 +1,30 @@
+#ifndef HEIGHTS_HPP
+#define HEIGHTS_HPP
+
+// Parameters for converting heightmap image pixels to heights.
+// For each pixel with components RGB, its value is
+//  (lum_r * R + lum_g * G + lum_b * B), clamped to range [0.0, 255.0],
+//  then scaled to range [min_height, max_height].
+struct HeightParams {
+	double lum_r;
+	double lum_g;
+	double lum_b;
+	double min_height;
+	double max_height;
+};
+
+bool operator==(
+	const struct HeightParams &a,
+	const struct HeightParams &b);
+
+// Convert RGB pixels to heights.
+// In parallel if `parallel`, which background threads leave false
+//  so as not to take cores from rendering.
+void ConvertHeights(
+	const unsigned char *base,
+	int num_pixels,
+	const struct HeightParams &params,
+	double *out,
+	bool parallel);
+
+#endif
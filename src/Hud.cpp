@@ -0,0 +1,230 @@
+#include "Hud.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Space around and between the text and the graph
+#define HUD_PAD 4
+
+// The first and last characters of the atlas
+#define HUD_FIRST_CHAR ' '
+#define HUD_LAST_CHAR '~'
+
+// Frame time of 60 frames per second
+#define HUD_TARGET_MS (1000.0 / 60.0)
+
+static const unsigned char background[4] = {0, 0, 0, 255};
+static const unsigned char march_color[4] = {80, 200, 80, 255};
+static const unsigned char present_color[4] = {80, 140, 255, 255};
+static const unsigned char other_color[4] = {160, 160, 160, 255};
+static const unsigned char target_color[4] = {200, 200, 60, 255};
+
+Hud::Hud() {
+	glyph_width = 0;
+	glyph_height = 0;
+	newest = HUD_HISTORY - 1;
+	frame_count = 0;
+	width = 0;
+	height = 0;
+}
+
+void Hud::SetFont(const unsigned char *coverage, int gw, int gh) {
+	const int count = HUD_LAST_CHAR - HUD_FIRST_CHAR + 1;
+
+	glyphs.assign(coverage, coverage + (size_t)count * gw * gh);
+	glyph_width = gw;
+	glyph_height = gh;
+}
+
+void Hud::AddFrame(const struct FrameStats &frame) {
+	newest = (newest + 1) % HUD_HISTORY;
+	frames[newest] = frame;
+	frame_count = std::min(frame_count + 1, HUD_HISTORY);
+}
+
+const struct FrameStats &Hud::Frame(int age) const {
+	return frames[(newest - age + HUD_HISTORY) % HUD_HISTORY];
+}
+
+struct FrameStats Hud::Average(double ms) const {
+	struct FrameStats sum = {0.0, 0.0, 0.0, 0, 0, 0, 0.0};
+	int count = 0;
+	int busy_count = 0;
+
+	while (count < frame_count && sum.frame_ms < ms) {
+		const struct FrameStats &frame = Frame(count);
+
+		sum.frame_ms += frame.frame_ms;
+		sum.march_ms += frame.march_ms;
+		sum.present_ms += frame.present_ms;
+		sum.rays += frame.rays;
+		sum.march_rays += frame.march_rays;
+		sum.steps += frame.steps;
+
+		if (frame.busy >= 0.0) {
+			sum.busy += frame.busy;
+			busy_count += 1;
+		}
+
+		count += 1;
+	}
+
+	if (count > 0) {
+		sum.frame_ms /= count;
+		sum.march_ms /= count;
+		sum.present_ms /= count;
+		sum.rays /= count;
+		sum.march_rays /= count;
+		sum.steps /= count;
+	}
+
+	sum.busy = busy_count > 0 ? sum.busy / busy_count : -1.0;
+
+	return sum;
+}
+
+void Hud::Fill(int x0, int y0, int x1, int y1, const unsigned char *rgba) {
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	unsigned char *const first = &pixels[((size_t)y0 * width + x0) * 4];
+
+	for (int x = 0; x < x1 - x0; ++x) {
+		std::memcpy(first + x * 4, rgba, 4);
+	}
+
+	// The other rows are copies of the first
+	for (int y = y0 + 1; y < y1; ++y) {
+		std::memcpy(&pixels[((size_t)y * width + x0) * 4], first,
+			(size_t)(x1 - x0) * 4);
+	}
+}
+
+void Hud::DrawText(const char *text, int x, int y) {
+	if (glyphs.empty()) {
+		return;
+	}
+
+	const int atlas_width =
+		(HUD_LAST_CHAR - HUD_FIRST_CHAR + 1) * glyph_width;
+
+	for (; *text != '\0' && x + glyph_width <= width; ++text) {
+		char c = *text;
+
+		if (c < HUD_FIRST_CHAR || c > HUD_LAST_CHAR) {
+			c = '?';
+		}
+
+		const unsigned char *const glyph =
+			&glyphs[(size_t)(c - HUD_FIRST_CHAR) * glyph_width];
+
+		for (int gy = 0; gy < glyph_height && y + gy < height; ++gy) {
+			const unsigned char *a = glyph + (size_t)gy * atlas_width;
+			unsigned char *p = &pixels[((size_t)(y + gy) * width + x) * 4];
+
+			// White, and over the black background
+			//  brighter only where the glyph is
+			for (int gx = 0; gx < glyph_width; ++gx, ++a, p += 4) {
+				p[0] = std::max(p[0], *a);
+				p[1] = std::max(p[1], *a);
+				p[2] = std::max(p[2], *a);
+			}
+		}
+
+		x += glyph_width;
+	}
+}
+
+void Hud::DrawGraph(int x, int y, int graph_width) {
+	const int columns = std::min(graph_width, frame_count);
+
+	// Twice as tall until it fits the slowest frame shown
+	double top_ms = HUD_TARGET_MS;
+
+	for (int age = 0; age < columns; ++age) {
+		while (Frame(age).frame_ms > top_ms) {
+			top_ms *= 2.0;
+		}
+	}
+
+	const double scale = HUD_GRAPH_HEIGHT / top_ms;
+	const int bottom = y + HUD_GRAPH_HEIGHT;
+
+	// Newest on the right
+	for (int age = 0; age < columns; ++age) {
+		const struct FrameStats &frame = Frame(age);
+		const int column = x + graph_width - 1 - age;
+
+		const int march = (int)(frame.march_ms * scale + 0.5);
+		const int present = (int)(frame.present_ms * scale + 0.5);
+		const int total = std::min((int)(frame.frame_ms * scale + 0.5),
+			HUD_GRAPH_HEIGHT);
+
+		const int march_top = std::max(bottom - march, bottom - total);
+		const int present_top =
+			std::max(march_top - present, bottom - total);
+
+		Fill(column, march_top, column + 1, bottom, march_color);
+		Fill(column, present_top, column + 1, march_top, present_color);
+		Fill(column, bottom - total, column + 1, present_top, other_color);
+	}
+
+	const int target_y = bottom - (int)(HUD_TARGET_MS * scale + 0.5);
+	Fill(x, target_y, x + graph_width, target_y + 1, target_color);
+
+	char label[32];
+	std::sprintf(label, "%.0f ms", top_ms);
+	DrawText(label, x, y);
+}
+
+void Hud::Draw(const char *const *lines, int count) {
+	width = HUD_COLUMNS * glyph_width + 2 * HUD_PAD;
+	height = count * glyph_height + HUD_GRAPH_HEIGHT + 3 * HUD_PAD;
+
+	// Only grows
+	if (pixels.size() < (size_t)width * height * 4) {
+		pixels.resize((size_t)width * height * 4);
+	}
+
+	Fill(0, 0, width, height, background);
+
+	for (int i = 0; i < count; ++i) {
+		DrawText(lines[i], HUD_PAD, HUD_PAD + i * glyph_height);
+	}
+
+	DrawGraph(HUD_PAD, count * glyph_height + 2 * HUD_PAD,
+		std::min(width - 2 * HUD_PAD, HUD_HISTORY));
+}
+
+const unsigned char *Hud::Pixels() const {
+	return &pixels[0];
+}
+
+int Hud::Width() const {
+	return width;
+}
+
+int Hud::Height() const {
+	return height;
+}
+
+void Hud::Composite(unsigned char *buf, int buf_width, int buf_height,
+	int x, int y) const
+{
+	const int x0 = std::max(x, 0);
+	const int y0 = std::max(y, 0);
+	const int x1 = std::min(x + width, buf_width);
+	const int y1 = std::min(y + height, buf_height);
+
+	if (x0 >= x1) {
+		return;
+	}
+
+	for (int by = y0; by < y1; ++by) {
+		std::memcpy(buf + ((size_t)by * buf_width + x0) * 4,
+			&pixels[((size_t)(by - y) * width + (x0 - x)) * 4],
+			(size_t)(x1 - x0) * 4);
+	}
+}
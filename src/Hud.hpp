@@ -0,0 +1,84 @@
+#ifndef HUD_HPP
+#define HUD_HPP
+
+#include <vector>
+
+// Frames kept for the graph
+#define HUD_HISTORY 256
+// Characters per line of text
+#define HUD_COLUMNS 36
+// Height of the graph in pixels
+#define HUD_GRAPH_HEIGHT 48
+
+// How a frame of the window went
+struct FrameStats {
+	// From the start of the frame to the start of the next
+	double frame_ms;
+	// Rendering the image
+	double march_ms;
+	// Handing the image to the display
+	double present_ms;
+	// Rays traced, including anti-aliasing ones
+	long long rays;
+	// Rays marched for whole pixels and the steps they took
+	long long march_rays;
+	long long steps;
+	// Proportion of the march the threads were busy,
+	//  negative if not measured
+	double busy;
+};
+
+// Heads-up display of how the last frames went:
+//  lines of text over a graph of the frame times.
+// Text is drawn from an atlas of glyphs rendered once,
+//  into an RGBA image that is kept between frames.
+class Hud {
+public:
+	// Use the glyphs of the printable ASCII characters (' ' to '~')
+	//  of a monospaced font, each `glyph_width` x `glyph_height`,
+	//  from `coverage` (0 to 255) holding them side by side in that order.
+	void SetFont(const unsigned char *coverage, int glyph_width, int glyph_height);
+
+	void AddFrame(const struct FrameStats &frame);
+
+	// Average of the frames of (about) the last `ms` milliseconds,
+	//  all zero if there are none
+	struct FrameStats Average(double ms) const;
+
+	// Draw the first `count` of `lines` over the graph into the image
+	void Draw(const char *const *lines, int count);
+
+	// The image as last drawn, Width() x Height() opaque RGBA pixels
+	const unsigned char *Pixels() const;
+	int Width() const;
+	int Height() const;
+
+	// Copy the image into the RGBA image `buf`
+	//  with its upper left corner at (x, y)
+	void Composite(unsigned char *buf, int buf_width, int buf_height,
+		int x, int y) const;
+
+	Hud();
+
+private:
+	void Fill(int x0, int y0, int x1, int y1, const unsigned char *rgba);
+	void DrawText(const char *text, int x, int y);
+	void DrawGraph(int x, int y, int width);
+
+	const struct FrameStats &Frame(int age) const;
+
+	std::vector<unsigned char> glyphs;
+	int glyph_width;
+	int glyph_height;
+
+	// Ring buffer of the last frames, newest at `newest`
+	struct FrameStats frames[HUD_HISTORY];
+	int newest;
+	int frame_count;
+
+	std::vector<unsigned char> pixels;
+	int width;
+	int height;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "ImageDiff.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+// Side of the blocks that SSIM is taken over
+#define SSIM_BLOCK 8
+
+// Largest difference of the color channels of two RGBA pixels
+static int PixelDifference(const unsigned char *a, const unsigned char *b) {
+	int difference = 0;
+
+	for (int c = 0; c < 3; ++c) {
+		difference = std::max(difference, std::abs(a[c] - b[c]));
+	}
+
+	return difference;
+}
+
+static double Luminance(const unsigned char *rgba) {
+	return 0.299 * rgba[0] + 0.587 * rgba[1] + 0.114 * rgba[2];
+}
+
+// SSIM of the luminance of the pixels of [x0, x1) x [y0, y1)
+static double BlockSsim(
+	const unsigned char *a,
+	const unsigned char *b,
+	int width,
+	int x0,
+	int y0,
+	int x1,
+	int y1)
+{
+	// Keep the ratios stable where both blocks are flat or dark
+	const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+	const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+
+	double sum_a = 0.0;
+	double sum_b = 0.0;
+	double sum_aa = 0.0;
+	double sum_bb = 0.0;
+	double sum_ab = 0.0;
+
+	for (int y = y0; y < y1; ++y) {
+		for (int x = x0; x < x1; ++x) {
+			const size_t i = ((size_t)y * width + x) * 4;
+			const double la = Luminance(a + i);
+			const double lb = Luminance(b + i);
+
+			sum_a += la;
+			sum_b += lb;
+			sum_aa += la * la;
+			sum_bb += lb * lb;
+			sum_ab += la * lb;
+		}
+	}
+
+	const double n = (double)(x1 - x0) * (y1 - y0);
+	const double mean_a = sum_a / n;
+	const double mean_b = sum_b / n;
+	const double var_a = sum_aa / n - mean_a * mean_a;
+	const double var_b = sum_bb / n - mean_b * mean_b;
+	const double covariance = sum_ab / n - mean_a * mean_b;
+
+	return ((2.0 * mean_a * mean_b + c1) * (2.0 * covariance + c2))
+		/ ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+}
+
+void CompareImages(
+	const unsigned char *a,
+	const unsigned char *b,
+	int width,
+	int height,
+	int threshold,
+	struct ImageDifference *difference)
+{
+	difference->differing = 0;
+	difference->max_difference = 0;
+
+	const size_t size = (size_t)width * height * 4;
+
+	for (size_t p = 0; p < size; p += 4) {
+		const int d = PixelDifference(a + p, b + p);
+
+		if (d > threshold) {
+			difference->differing += 1;
+		}
+
+		difference->max_difference = std::max(difference->max_difference, d);
+	}
+
+	double ssim = 0.0;
+	int blocks = 0;
+
+	for (int y0 = 0; y0 < height; y0 += SSIM_BLOCK) {
+		for (int x0 = 0; x0 < width; x0 += SSIM_BLOCK) {
+			ssim += BlockSsim(a, b, width, x0, y0,
+				std::min(x0 + SSIM_BLOCK, width),
+				std::min(y0 + SSIM_BLOCK, height));
+			blocks += 1;
+		}
+	}
+
+	difference->ssim = blocks > 0 ? ssim / blocks : 1.0;
+}
+
+void DiffImage(
+	const unsigned char *a,
+	const unsigned char *b,
+	int width,
+	int height,
+	int threshold,
+	unsigned char *out)
+{
+	const size_t size = (size_t)width * height * 4;
+
+	for (size_t p = 0; p < size; p += 4) {
+		if (PixelDifference(a + p, b + p) > threshold) {
+			out[p] = 255;
+			out[p + 1] = 0;
+			out[p + 2] = 0;
+		}
+		else {
+			const unsigned char grey =
+				(unsigned char)(Luminance(b + p) * 0.5 + 64.0);
+
+			out[p] = grey;
+			out[p + 1] = grey;
+			out[p + 2] = grey;
+		}
+
+		out[p + 3] = 255;
+	}
+}
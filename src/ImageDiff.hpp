@@ -0,0 +1,37 @@
+#ifndef IMAGEDIFF_HPP
+#define IMAGEDIFF_HPP
+
+// How much two RGBA images of the same size differ
+struct ImageDifference {
+	// Pixels with a color channel that differs by more than the threshold
+	int differing;
+	// Largest difference of a color channel
+	int max_difference;
+	// Mean structural similarity (SSIM) of their luminance
+	//  over blocks of 8x8 pixels: 1 if the same,
+	//  lower as edges and texture are lost or added,
+	//  but barely lower for small shifts in brightness
+	double ssim;
+};
+
+// Compare the colors of `width` x `height` RGBA images `a` and `b`
+void CompareImages(
+	const unsigned char *a,
+	const unsigned char *b,
+	int width,
+	int height,
+	int threshold,
+	struct ImageDifference *difference);
+
+// Write to `out` an RGBA image of where `a` and `b` differ:
+//  `b` faded to grey, with the pixels that differ by more than
+//  `threshold` in red
+void DiffImage(
+	const unsigned char *a,
+	const unsigned char *b,
+	int width,
+	int height,
+	int threshold,
+	unsigned char *out);
+
+#endif
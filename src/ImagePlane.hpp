@@ -1,17 +1,39 @@
-#ifndef IMAGEPLANE_HPP
-#define IMAGEPLANE_HPP
-
-#include "Ray.hpp"
-
-class ImagePlane {
-public:
-	// w and h are [0, 1] meaning how far to go along the width and height
-	//  of the image plane from the upper left corner
-	virtual struct Ray GetRay(double w, double h) = 0;
-
-	// Does nothing,
-	//  but necessary to be able to `delete` an instance of ImagePlane
-	virtual ~ImagePlane() {}
-};
-
-#endif
+#ifndef IMAGEPLANE_HPP
+#define IMAGEPLANE_HPP
+
+#include "Beam.hpp"
+#include "Ray.hpp"
+
+class ImagePlane {
+public:
+	// w and h are [0, 1] meaning how far to go along the width and height
+	//  of the image plane from the upper left corner
+	virtual struct Ray GetRay(double w, double h) = 0;
+
+	// Set `beam` to bound the rays for [w0, w1] x [h0, h1].
+	// Returns false if this projection's rays cannot be bounded that way.
+	virtual bool GetBeam(double, double, double, double, struct Beam*) {
+		return false;
+	}
+
+	// Distance along `ray` (from GetRay) of its point at parameter `s`
+	//  of a beam (from GetBeam) that it is in
+	virtual double BeamDistance(struct Ray, double s) {
+		return s;
+	}
+
+	// Set [w0, w1] x [h0, h1] (in the units of GetRay) to cover the rays
+	//  that can hit the box with corners c0 and c1, empty (w0 > w1)
+	//  if none can.
+	// Returns false if this projection cannot tell,
+	//  in which case any ray may hit it.
+	virtual bool ScreenBounds(glm::dvec3, glm::dvec3, double*, double*, double*, double*) {
+		return false;
+	}
+
+	// Does nothing,
+	//  but necessary to be able to `delete` an instance of ImagePlane
+	virtual ~ImagePlane() {}
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "Light.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Radians over which the sun goes from hidden to not behind a horizon
+#define LIGHT_PENUMBRA 0.05
+
+// Directions sampled for ambient occlusion
+#define LIGHT_OCCLUSION_DIRECTIONS 8
+
+TerrainLight::TerrainLight() {
+	heights = NULL;
+	width = 0;
+	height = 0;
+	grid_width = 0.0;
+	max_height = 0.0;
+	sun.azimuth = 0.0;
+	sun.elevation = 0.0;
+	sun.ambient = 0.0;
+}
+
+bool TerrainLight::Empty() const {
+	return heights == NULL;
+}
+
+bool TerrainLight::BuiltFor(
+	const double *h,
+	int w,
+	int ht,
+	double gw) const
+{
+	return heights != NULL
+		&& heights == h
+		&& width == w
+		&& height == ht
+		&& grid_width == gw;
+}
+
+void TerrainLight::Clear() {
+	heights = NULL;
+	std::vector<float>().swap(normals);
+	std::vector<float>().swap(occlusion);
+	std::vector<float>().swap(horizons);
+	std::vector<unsigned char>().swap(levels);
+}
+
+void TerrainLight::Swap(TerrainLight &other) {
+	std::swap(heights, other.heights);
+	std::swap(width, other.width);
+	std::swap(height, other.height);
+	std::swap(grid_width, other.grid_width);
+	std::swap(max_height, other.max_height);
+	std::swap(sun, other.sun);
+	normals.swap(other.normals);
+	occlusion.swap(other.occlusion);
+	horizons.swap(other.horizons);
+	levels.swap(other.levels);
+}
+
+double TerrainLight::Height(int x, int y) const {
+	return heights[x + y * width];
+}
+
+double TerrainLight::Horizon(int x, int y, double dx, double dy, int range) const {
+	const double h0 = Height(x, y);
+	double best = 0.0;
+
+	// Every cell nearby, then fewer as they get farther
+	double d = 1.0;
+
+	while (d <= range) {
+		// Nothing this far can be higher than the highest height
+		if (max_height - h0 <= best * d * grid_width) {
+			break;
+		}
+
+		const double px = x + 0.5 + d * dx;
+		const double py = y + 0.5 + d * dy;
+
+		if (px < 0.0 || py < 0.0 || px >= width || py >= height) {
+			break;
+		}
+
+		const double rise = Height((int)px, (int)py) - h0;
+
+		if (rise > best * d * grid_width) {
+			best = rise / (d * grid_width);
+		}
+
+		d = d < 4.0 ? d + 1.0 : d * 1.25;
+	}
+
+	return best;
+}
+
+void TerrainLight::BakeNormals(int x0, int y0, int x1, int y1) {
+	#pragma omp parallel for if((y1 - y0 + 1) * (x1 - x0 + 1) > 4096)
+	for (int y = y0; y <= y1; ++y) {
+		const int ya = std::max(y - 1, 0);
+		const int yb = std::min(y + 1, height - 1);
+
+		for (int x = x0; x <= x1; ++x) {
+			const int xa = std::max(x - 1, 0);
+			const int xb = std::min(x + 1, width - 1);
+
+			// Grid y increases along the negative y axis
+			const double dz_dx = (Height(xb, y) - Height(xa, y))
+				/ (std::max(xb - xa, 1) * grid_width);
+			const double dz_dy = -(Height(x, yb) - Height(x, ya))
+				/ (std::max(yb - ya, 1) * grid_width);
+
+			const double length = std::sqrt(dz_dx * dz_dx + dz_dy * dz_dy + 1.0);
+			float *const normal = &normals[(size_t)(x + y * width) * 3];
+
+			normal[0] = (float)(-dz_dx / length);
+			normal[1] = (float)(-dz_dy / length);
+			normal[2] = (float)(1.0 / length);
+		}
+	}
+}
+
+void TerrainLight::BakeOcclusion(int x0, int y0, int x1, int y1) {
+	double dx[LIGHT_OCCLUSION_DIRECTIONS];
+	double dy[LIGHT_OCCLUSION_DIRECTIONS];
+
+	for (int k = 0; k < LIGHT_OCCLUSION_DIRECTIONS; ++k) {
+		const double angle = 2.0 * M_PI * k / LIGHT_OCCLUSION_DIRECTIONS;
+
+		dx[k] = std::cos(angle);
+		dy[k] = std::sin(angle);
+	}
+
+	#pragma omp parallel for if((y1 - y0 + 1) * (x1 - x0 + 1) > 4096)
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			double blocked = 0.0;
+
+			for (int k = 0; k < LIGHT_OCCLUSION_DIRECTIONS; ++k) {
+				const double tangent =
+					Horizon(x, y, dx[k], dy[k], LIGHT_OCCLUSION_RANGE);
+
+				// Sine of the horizon's elevation
+				blocked += tangent / std::sqrt(1.0 + tangent * tangent);
+			}
+
+			occlusion[x + y * width] =
+				(float)(1.0 - blocked / LIGHT_OCCLUSION_DIRECTIONS);
+		}
+	}
+}
+
+void TerrainLight::BakeHorizons(int x0, int y0, int x1, int y1) {
+	// Toward the sun in grid coordinates
+	const double dx = std::cos(sun.azimuth);
+	const double dy = -std::sin(sun.azimuth);
+
+	#pragma omp parallel for schedule(dynamic) \
+		if((y1 - y0 + 1) * (x1 - x0 + 1) > 4096)
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			horizons[x + y * width] =
+				(float)Horizon(x, y, dx, dy, LIGHT_HORIZON_RANGE);
+		}
+	}
+}
+
+void TerrainLight::BakeLevels(int x0, int y0, int x1, int y1) {
+	const double sun_x = std::cos(sun.azimuth) * std::cos(sun.elevation);
+	const double sun_y = std::sin(sun.azimuth) * std::cos(sun.elevation);
+	const double sun_z = std::sin(sun.elevation);
+
+	#pragma omp parallel for if((y1 - y0 + 1) * (x1 - x0 + 1) > 4096)
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			const int cell = x + y * width;
+			const float *const normal = &normals[(size_t)cell * 3];
+
+			const double diffuse = std::max(0.0,
+				normal[0] * sun_x + normal[1] * sun_y + normal[2] * sun_z);
+			const double lit = std::min(1.0, std::max(0.0,
+				(sun.elevation - std::atan(horizons[cell])) / LIGHT_PENUMBRA
+				+ 0.5));
+			const double light = std::min(1.0,
+				sun.ambient * occlusion[cell] + diffuse * lit);
+
+			levels[cell] = (unsigned char)std::floor(light * 255.0 + 0.5);
+		}
+	}
+}
+
+void TerrainLight::Build(
+	const double *h,
+	int w,
+	int ht,
+	double gw,
+	const struct Sun &s)
+{
+	heights = h;
+	width = w;
+	height = ht;
+	grid_width = gw;
+	sun = s;
+
+	const size_t count = (size_t)width * height;
+	max_height = *std::max_element(heights, heights + count);
+
+	normals.resize(count * 3);
+	occlusion.resize(count);
+	horizons.resize(count);
+	levels.resize(count);
+
+	BakeNormals(0, 0, width - 1, height - 1);
+	BakeOcclusion(0, 0, width - 1, height - 1);
+	BakeHorizons(0, 0, width - 1, height - 1);
+	BakeLevels(0, 0, width - 1, height - 1);
+}
+
+void TerrainLight::BuildRegion(
+	const double *h,
+	int w,
+	int ht,
+	int x0,
+	int y0,
+	int region_width,
+	int region_height,
+	double gw,
+	const struct Sun &s,
+	const double *region)
+{
+	heights = h;
+	width = w;
+	height = ht;
+	grid_width = gw;
+	sun = s;
+
+	const size_t count = (size_t)width * height;
+	max_height = *std::max_element(heights, heights + count);
+
+	normals.resize(count * 3);
+	occlusion.resize(count);
+	horizons.resize(count);
+	levels.resize(count);
+
+	const int x1 = x0 + region_width - 1;
+	const int y1 = y0 + region_height - 1;
+
+	BakeNormals(x0, y0, x1, y1);
+	BakeOcclusion(x0, y0, x1, y1);
+	BakeHorizons(x0, y0, x1, y1);
+	BakeLevels(x0, y0, x1, y1);
+
+	// Keep the region's cells only
+	const size_t region_count = (size_t)region_width * region_height;
+	std::vector<float> region_normals(region_count * 3);
+	std::vector<float> region_occlusion(region_count);
+	std::vector<float> region_horizons(region_count);
+	std::vector<unsigned char> region_levels(region_count);
+
+	for (int y = 0; y < region_height; ++y) {
+		for (int x = 0; x < region_width; ++x) {
+			const size_t from = (size_t)(x0 + x) + (size_t)(y0 + y) * width;
+			const size_t to = (size_t)x + (size_t)y * region_width;
+
+			for (int c = 0; c < 3; ++c) {
+				region_normals[to * 3 + c] = normals[from * 3 + c];
+			}
+
+			region_occlusion[to] = occlusion[from];
+			region_horizons[to] = horizons[from];
+			region_levels[to] = levels[from];
+		}
+	}
+
+	normals.swap(region_normals);
+	occlusion.swap(region_occlusion);
+	horizons.swap(region_horizons);
+	levels.swap(region_levels);
+
+	// Rebaking when the sun turns sees only the region
+	heights = region;
+	width = region_width;
+	height = region_height;
+	max_height = *std::max_element(heights, heights + region_count);
+}
+
+void TerrainLight::SetSun(const struct Sun &s) {
+	if (s.azimuth == sun.azimuth
+		&& s.elevation == sun.elevation
+		&& s.ambient == sun.ambient)
+	{
+		return;
+	}
+
+	const bool turned = s.azimuth != sun.azimuth;
+	sun = s;
+
+	if (turned) {
+		BakeHorizons(0, 0, width - 1, height - 1);
+	}
+
+	BakeLevels(0, 0, width - 1, height - 1);
+}
+
+void TerrainLight::Update(int x0, int y0, int x1, int y1) {
+	// Only raised, since a bound left too high is still a bound
+	for (int y = y0; y <= y1; ++y) {
+		const double *const row = heights + (size_t)y * width;
+		max_height = std::max(max_height,
+			*std::max_element(row + x0, row + x1 + 1));
+	}
+
+	// A cell's normal depends on its neighbors
+	const int nx0 = std::max(x0 - 1, 0);
+	const int ny0 = std::max(y0 - 1, 0);
+	const int nx1 = std::min(x1 + 1, width - 1);
+	const int ny1 = std::min(y1 + 1, height - 1);
+
+	const int ox0 = std::max(x0 - LIGHT_OCCLUSION_RANGE, 0);
+	const int oy0 = std::max(y0 - LIGHT_OCCLUSION_RANGE, 0);
+	const int ox1 = std::min(x1 + LIGHT_OCCLUSION_RANGE, width - 1);
+	const int oy1 = std::min(y1 + LIGHT_OCCLUSION_RANGE, height - 1);
+
+	// The cells that see the changed ones toward the sun
+	//  are on the other side of them
+	const int reach_x = (int)std::ceil(LIGHT_HORIZON_RANGE * std::cos(sun.azimuth));
+	const int reach_y = (int)std::ceil(-LIGHT_HORIZON_RANGE * std::sin(sun.azimuth));
+	const int hx0 = std::max(std::min(x0, x0 - reach_x) - 1, 0);
+	const int hy0 = std::max(std::min(y0, y0 - reach_y) - 1, 0);
+	const int hx1 = std::min(std::max(x1, x1 - reach_x) + 1, width - 1);
+	const int hy1 = std::min(std::max(y1, y1 - reach_y) + 1, height - 1);
+
+	BakeNormals(nx0, ny0, nx1, ny1);
+	BakeOcclusion(ox0, oy0, ox1, oy1);
+	BakeHorizons(hx0, hy0, hx1, hy1);
+	BakeLevels(
+		std::min(ox0, hx0), std::min(oy0, hy0),
+		std::max(ox1, hx1), std::max(oy1, hy1));
+}
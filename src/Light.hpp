@@ -0,0 +1,112 @@
+#ifndef LIGHT_HPP
+#define LIGHT_HPP
+
+#include <vector>
+
+// Cells farther than this along the sun's azimuth cannot shadow a cell
+#define LIGHT_HORIZON_RANGE 256
+// Cells farther than this cannot occlude a cell's ambient light
+#define LIGHT_OCCLUSION_RANGE 16
+
+// Direction of the sun and how much light comes from the rest of the sky
+struct Sun {
+	// Radians counterclockwise from the positive x axis
+	double azimuth;
+	// Radians above the xy plane
+	double elevation;
+	// Light of an unoccluded cell in shadow, in range [0, 1]
+	double ambient;
+};
+
+// Light of each cell of a heightmap, baked from its heights.
+// The normals and ambient occlusion do not depend on the sun
+//  and the horizons only on its azimuth,
+//  so moving the sun redoes as little as it can.
+class TerrainLight {
+public:
+	// Bake the light of `width` x `height` heights `grid_width` apart.
+	// The heights must outlive this and not move until the next Build.
+	void Build(
+		const double *heights,
+		int width,
+		int height,
+		double grid_width,
+		const struct Sun &sun);
+
+	// Bake the light of cells [x0, x0 + w) x [y0, y0 + h)
+	//  of `width` x `height` heights and keep only theirs,
+	//  so that the cells at the edges of the region are lit
+	//  by the heights around it rather than as if there were none.
+	// The light is then of `region`, the w x h heights of those cells,
+	//  which must outlive this like those passed to Build.
+	void BuildRegion(
+		const double *heights,
+		int width,
+		int height,
+		int x0,
+		int y0,
+		int w,
+		int h,
+		double grid_width,
+		const struct Sun &sun,
+		const double *region);
+
+	// Rebake what depends on the sun if it moved
+	void SetSun(const struct Sun &sun);
+
+	// Rebake the light that cells [x0, x1] x [y0, y1] affect
+	//  after their heights changed.
+	void Update(int x0, int y0, int x1, int y1);
+
+	// Light of the cell (gridx + gridy * width),
+	//  from 0 (black) to 255 (its full color)
+	unsigned char Level(int cell) const {
+		return levels[cell];
+	}
+
+	bool Empty() const;
+
+	// Whether this is baked from the given heights `grid_width` apart
+	bool BuiltFor(
+		const double *heights,
+		int width,
+		int height,
+		double grid_width) const;
+
+	// Make this empty, such as after the heights were converted again
+	void Clear();
+
+	// Exchange the light and the heights it is of with `other`'s,
+	//  such as after exchanging the buffers of the heights
+	void Swap(TerrainLight &other);
+
+	TerrainLight();
+
+private:
+	double Height(int x, int y) const;
+	// Tangent of the highest elevation of the cells in direction (dx, dy)
+	//  within `range` cells, seen from the top of cell (x, y)
+	double Horizon(int x, int y, double dx, double dy, int range) const;
+
+	void BakeNormals(int x0, int y0, int x1, int y1);
+	void BakeOcclusion(int x0, int y0, int x1, int y1);
+	void BakeHorizons(int x0, int y0, int x1, int y1);
+	void BakeLevels(int x0, int y0, int x1, int y1);
+
+	const double *heights;
+	int width;
+	int height;
+	double grid_width;
+	double max_height;
+	struct Sun sun;
+
+	// Unit surface normal, 3 per cell
+	std::vector<float> normals;
+	// Part of the sky each cell sees, in range [0, 1]
+	std::vector<float> occlusion;
+	// Tangent of the elevation of each cell's horizon toward the sun
+	std::vector<float> horizons;
+	std::vector<unsigned char> levels;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "MaxMip.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+MaxMip::MaxMip() {
+	heights = NULL;
+}
+
+bool MaxMip::Empty() const {
+	return heights == NULL;
+}
+
+void MaxMip::Swap(MaxMip &other) {
+	std::swap(heights, other.heights);
+	level_widths.swap(other.level_widths);
+	level_heights.swap(other.level_heights);
+	levels.swap(other.levels);
+}
+
+double MaxMip::Cell(int level, int x, int y) const {
+	if (level == 0) {
+		return heights[x + y * level_widths[0]];
+	}
+
+	return levels[level - 1][x + y * level_widths[level]];
+}
+
+// Recompute cells [x0, x1] x [y0, y1] of the level from the level below
+void MaxMip::BuildLevel(int level, int x0, int y0, int x1, int y1) {
+	const int below_width = level_widths[level - 1];
+	const int below_height = level_heights[level - 1];
+	std::vector<double> &cells = levels[level - 1];
+
+	#pragma omp parallel for if((y1 - y0 + 1) * (x1 - x0 + 1) > 4096)
+	for (int y = y0; y <= y1; ++y) {
+		// Odd dimensions leave the last block one cell wide or tall
+		const int by0 = y * 2;
+		const int by1 = std::min(by0 + 1, below_height - 1);
+
+		for (int x = x0; x <= x1; ++x) {
+			const int bx0 = x * 2;
+			const int bx1 = std::min(bx0 + 1, below_width - 1);
+
+			cells[x + y * level_widths[level]] = std::max(
+				std::max(Cell(level - 1, bx0, by0), Cell(level - 1, bx1, by0)),
+				std::max(Cell(level - 1, bx0, by1), Cell(level - 1, bx1, by1))
+			);
+		}
+	}
+}
+
+void MaxMip::Build(const double *h, int width, int height) {
+	heights = h;
+	level_widths.assign(1, width);
+	level_heights.assign(1, height);
+	levels.clear();
+
+	while (level_widths.back() > 1 || level_heights.back() > 1) {
+		level_widths.push_back((level_widths.back() + 1) / 2);
+		level_heights.push_back((level_heights.back() + 1) / 2);
+		levels.push_back(std::vector<double>(
+			(size_t)level_widths.back() * level_heights.back()));
+
+		const int level = (int)levels.size();
+		BuildLevel(level, 0, 0,
+			level_widths[level] - 1, level_heights[level] - 1);
+	}
+}
+
+void MaxMip::Update(int x0, int y0, int x1, int y1) {
+	for (int level = 1; level <= (int)levels.size(); ++level) {
+		x0 /= 2;
+		y0 /= 2;
+		x1 /= 2;
+		y1 /= 2;
+
+		BuildLevel(level, x0, y0, x1, y1);
+	}
+}
+
+double MaxMip::MaxHeight(int x0, int y0, int x1, int y1) const {
+	// The lowest level at which the range is at most 2x2 cells
+	int level = 0;
+	while (x1 - x0 > 1 || y1 - y0 > 1) {
+		x0 /= 2;
+		y0 /= 2;
+		x1 /= 2;
+		y1 /= 2;
+		level += 1;
+	}
+
+	return std::max(
+		std::max(Cell(level, x0, y0), Cell(level, x1, y0)),
+		std::max(Cell(level, x0, y1), Cell(level, x1, y1))
+	);
+}
@@ -0,0 +1,43 @@
+#ifndef MAXMIP_HPP
+#define MAXMIP_HPP
+
+#include <vector>
+
+// Maximum heights over blocks of a heightmap,
+//  each level halving the resolution of the one below.
+// Level 0 is the heightmap itself (referenced, not copied).
+class MaxMip {
+public:
+	// Build the levels over `width` x `height` heights.
+	// The heights must outlive this and not move until the next Build.
+	void Build(const double *heights, int width, int height);
+
+	// Recompute the levels above grid cells [x0, x1] x [y0, y1]
+	//  after their heights changed.
+	void Update(int x0, int y0, int x1, int y1);
+
+	// At least the highest height of grid cells [x0, x1] x [y0, y1],
+	//  which must be within the grid.
+	double MaxHeight(int x0, int y0, int x1, int y1) const;
+
+	bool Empty() const;
+
+	// Exchange the levels and the heights they are over with `other`'s,
+	//  such as after exchanging the buffers of the heights
+	void Swap(MaxMip &other);
+
+	MaxMip();
+
+private:
+	double Cell(int level, int x, int y) const;
+	void BuildLevel(int level, int x0, int y0, int x1, int y1);
+
+	const double *heights;
+	// Dimensions of each level, level 0 included
+	std::vector<int> level_widths;
+	std::vector<int> level_heights;
+	// levels[i] is level i + 1
+	std::vector<std::vector<double> > levels;
+};
+
+#endif
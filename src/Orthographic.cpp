@@ -1,25 +1,68 @@
-#include "Orthographic.hpp"
-
-Orthographic::Orthographic(glm::dvec3 pos, glm::vec3 lk, glm::vec3 u, double ow, int sw, int sh) {
-	cam_pos = pos;
-	look = lk;
-	up = u;
-	ortho_width = ow;
-	screen_width = sw;
-	screen_height = sh;
-
-	right = glm::cross(look, up);
-
-	upper_left = cam_pos - (screen_width / 2.0) * ortho_width * right + (screen_height / 2.0) * ortho_width * up;
-
-	plane_right = screen_width * ortho_width * right;
-	plane_down = screen_height * ortho_width * -up;
-}
-
-struct Ray Orthographic::GetRay(double w, double h) {
-	glm::dvec3 pos = upper_left + w * plane_right + h * plane_down;
-
-	struct Ray ray = {pos, look};
-
-	return ray;
-}
+#include "Orthographic.hpp"
+
+#include <algorithm>
+
+#include "AABB.hpp"
+
+Orthographic::Orthographic(glm::dvec3 pos, glm::vec3 lk, glm::vec3 u, double ow, int sw, int sh) {
+	cam_pos = pos;
+	look = lk;
+	up = u;
+	ortho_width = ow;
+	screen_width = sw;
+	screen_height = sh;
+
+	right = glm::cross(look, up);
+
+	upper_left = cam_pos - (screen_width / 2.0) * ortho_width * right + (screen_height / 2.0) * ortho_width * up;
+
+	plane_right = screen_width * ortho_width * right;
+	plane_down = screen_height * ortho_width * -up;
+}
+
+struct Ray Orthographic::GetRay(double w, double h) {
+	glm::dvec3 pos = upper_left + w * plane_right + h * plane_down;
+
+	struct Ray ray = {pos, look};
+
+	return ray;
+}
+
+bool Orthographic::GetBeam(double w0, double h0, double w1, double h1, struct Beam *beam) {
+	const double ws[4] = {w0, w1, w0, w1};
+	const double hs[4] = {h0, h0, h1, h1};
+
+	for (int i = 0; i < 4; ++i) {
+		beam->pos[i] = upper_left + ws[i] * plane_right + hs[i] * plane_down;
+		beam->dir[i] = look;
+	}
+
+	beam->axis = look;
+
+	return true;
+}
+
+// Projects the part of the box in front of the image plane onto it
+bool Orthographic::ScreenBounds(glm::dvec3 c0, glm::dvec3 c1, double *w0, double *h0, double *w1, double *h1) {
+	glm::dvec3 points[CLIP_BOX_MAX_POINTS];
+	const int count = clip_box(points, c0, c1, cam_pos, look);
+
+	*w0 = HUGE_VAL;
+	*h0 = HUGE_VAL;
+	*w1 = -HUGE_VAL;
+	*h1 = -HUGE_VAL;
+
+	for (int i = 0; i < count; ++i) {
+		const double w = glm::dot(points[i] - upper_left, plane_right)
+			/ glm::dot(plane_right, plane_right);
+		const double h = glm::dot(points[i] - upper_left, plane_down)
+			/ glm::dot(plane_down, plane_down);
+
+		*w0 = std::min(*w0, w);
+		*h0 = std::min(*h0, h);
+		*w1 = std::max(*w1, w);
+		*h1 = std::max(*h1, h);
+	}
+
+	return true;
+}
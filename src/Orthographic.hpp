@@ -1,30 +1,32 @@
-#ifndef ORTHOGRAPHIC_HPP
-#define ORTHOGRAPHIC_HPP
-
-#include <cmath>
-
-#include "glm/glm.hpp"
-
-#include "ImagePlane.hpp"
-
-class Orthographic: public ImagePlane {
-public:
-	struct Ray GetRay(double w, double h);
-
-	glm::dvec3 cam_pos;
-	glm::dvec3 look;
-	glm::dvec3 up;
-	double ortho_width;
-	int screen_width;
-	int screen_height;
-
-	glm::dvec3 right;
-
-	glm::dvec3 upper_left;
-	glm::dvec3 plane_right;
-	glm::dvec3 plane_down;
-
-	Orthographic(glm::dvec3 pos, glm::vec3 lk, glm::vec3 u, double ow, int sw, int sh);
-};
-
-#endif
+#ifndef ORTHOGRAPHIC_HPP
+#define ORTHOGRAPHIC_HPP
+
+#include <cmath>
+
+#include "glm/glm.hpp"
+
+#include "ImagePlane.hpp"
+
+class Orthographic: public ImagePlane {
+public:
+	struct Ray GetRay(double w, double h);
+	bool GetBeam(double w0, double h0, double w1, double h1, struct Beam *beam);
+	bool ScreenBounds(glm::dvec3 c0, glm::dvec3 c1, double *w0, double *h0, double *w1, double *h1);
+
+	glm::dvec3 cam_pos;
+	glm::dvec3 look;
+	glm::dvec3 up;
+	double ortho_width;
+	int screen_width;
+	int screen_height;
+
+	glm::dvec3 right;
+
+	glm::dvec3 upper_left;
+	glm::dvec3 plane_right;
+	glm::dvec3 plane_down;
+
+	Orthographic(glm::dvec3 pos, glm::vec3 lk, glm::vec3 u, double ow, int sw, int sh);
+};
+
+#endif
@@ -1,32 +1,90 @@
-#include "Perspective.hpp"
-
-Perspective::Perspective(glm::dvec3 pos, glm::dvec3 lk, glm::dvec3 u, double hf, double ar) {
-	cam_pos = pos;
-	look = lk;
-	up = u;
-	hfov = hf;
-	aspect_ratio = ar;
-
-	double half_plane_width = tan(hfov / 2.0);
-	double half_plane_height = half_plane_width / ar;
-
-	right = glm::cross(look, up);
-	right = glm::normalize(right);
-
-	upper_left = cam_pos + look + half_plane_height * up - half_plane_width * right;
-
-	glm::dvec3 lower_left = cam_pos + look - half_plane_height * up - half_plane_width * right;
-	glm::dvec3 upper_right = cam_pos + look + half_plane_height * up + half_plane_width * right;
-
-	plane_right = upper_right - upper_left;
-	plane_down = lower_left - upper_left;
-}
-
-struct Ray Perspective::GetRay(double w, double h) {
-	glm::dvec3 pos = cam_pos;
-	glm::dvec3 dir = glm::normalize((upper_left + w * plane_right + h * plane_down) - cam_pos);
-
-	struct Ray ray = {pos, dir};
-
-	return ray;
-}
+#include "Perspective.hpp"
+
+#include <algorithm>
+
+#include "AABB.hpp"
+
+Perspective::Perspective(glm::dvec3 pos, glm::dvec3 lk, glm::dvec3 u, double hf, double ar) {
+	cam_pos = pos;
+	look = lk;
+	up = u;
+	hfov = hf;
+	aspect_ratio = ar;
+
+	double half_plane_width = tan(hfov / 2.0);
+	double half_plane_height = half_plane_width / ar;
+
+	right = glm::cross(look, up);
+	right = glm::normalize(right);
+
+	upper_left = cam_pos + look + half_plane_height * up - half_plane_width * right;
+
+	glm::dvec3 lower_left = cam_pos + look - half_plane_height * up - half_plane_width * right;
+	glm::dvec3 upper_right = cam_pos + look + half_plane_height * up + half_plane_width * right;
+
+	plane_right = upper_right - upper_left;
+	plane_down = lower_left - upper_left;
+}
+
+struct Ray Perspective::GetRay(double w, double h) {
+	glm::dvec3 pos = cam_pos;
+	glm::dvec3 dir = glm::normalize((upper_left + w * plane_right + h * plane_down) - cam_pos);
+
+	struct Ray ray = {pos, dir};
+
+	return ray;
+}
+
+// The corner rays are not normalized so that every ray's point at s is
+//  the same combination of the corner rays' points at s
+//  as its point on the image plane is of theirs.
+bool Perspective::GetBeam(double w0, double h0, double w1, double h1, struct Beam *beam) {
+	const double ws[4] = {w0, w1, w0, w1};
+	const double hs[4] = {h0, h0, h1, h1};
+
+	for (int i = 0; i < 4; ++i) {
+		beam->pos[i] = cam_pos;
+		beam->dir[i] = (upper_left + ws[i] * plane_right + hs[i] * plane_down) - cam_pos;
+	}
+
+	beam->axis = look;
+
+	return true;
+}
+
+// The image plane is one unit along `look`,
+//  so a ray's unnormalized direction is 1 / dot(dir, look) long.
+double Perspective::BeamDistance(struct Ray ray, double s) {
+	return s / glm::dot(ray.dir, look);
+}
+
+// Projects the part of the box in front of the camera onto the image plane
+bool Perspective::ScreenBounds(glm::dvec3 c0, glm::dvec3 c1, double *w0, double *h0, double *w1, double *h1) {
+	// Anything nearer projects too far out to matter
+	const double near = 1e-6;
+
+	glm::dvec3 points[CLIP_BOX_MAX_POINTS];
+	const int count = clip_box(points, c0, c1, cam_pos + near * look, look);
+
+	*w0 = HUGE_VAL;
+	*h0 = HUGE_VAL;
+	*w1 = -HUGE_VAL;
+	*h1 = -HUGE_VAL;
+
+	for (int i = 0; i < count; ++i) {
+		const glm::dvec3 v = points[i] - cam_pos;
+		const glm::dvec3 on_plane = cam_pos + v / glm::dot(v, look);
+
+		const double w = glm::dot(on_plane - upper_left, plane_right)
+			/ glm::dot(plane_right, plane_right);
+		const double h = glm::dot(on_plane - upper_left, plane_down)
+			/ glm::dot(plane_down, plane_down);
+
+		*w0 = std::min(*w0, w);
+		*h0 = std::min(*h0, h);
+		*w1 = std::max(*w1, w);
+		*h1 = std::max(*h1, h);
+	}
+
+	return true;
+}
@@ -0,0 +1,402 @@
+#include "Procedural.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// Proportion of the height range under water, which is flat
+#define PROCEDURAL_WATER 0.4
+
+bool operator==(
+	const struct ProceduralParams &a,
+	const struct ProceduralParams &b)
+{
+	return a.seed == b.seed
+	    && a.octaves == b.octaves
+	    && a.feature_size == b.feature_size
+	    && a.min_height == b.min_height
+	    && a.max_height == b.max_height
+	    && a.tile_cells == b.tile_cells
+	    && a.grid_width == b.grid_width;
+}
+
+static unsigned int Hash(unsigned int seed, int x, int y) {
+	unsigned int h = seed * 0x9e3779b9u
+		^ (unsigned int)x * 0x85ebca6bu
+		^ (unsigned int)y * 0xc2b2ae35u;
+
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+
+	return h;
+}
+
+// Dot product of the gradient at lattice point (x, y)
+//  and the offset (dx, dy) from it
+static double Gradient(unsigned int seed, int x, int y, double dx, double dy) {
+	static const double gx[8] = {
+		1.0, -1.0, 0.0, 0.0, M_SQRT1_2, -M_SQRT1_2, M_SQRT1_2, -M_SQRT1_2
+	};
+	static const double gy[8] = {
+		0.0, 0.0, 1.0, -1.0, M_SQRT1_2, M_SQRT1_2, -M_SQRT1_2, -M_SQRT1_2
+	};
+
+	const unsigned int g = Hash(seed, x, y) & 7;
+
+	return gx[g] * dx + gy[g] * dy;
+}
+
+static double Fade(double t) {
+	return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+}
+
+// Gradient noise with a lattice spacing of 1, in about [-0.7, 0.7]
+static double Noise(unsigned int seed, double x, double y) {
+	const double fx = std::floor(x);
+	const double fy = std::floor(y);
+	const int ix = (int)fx;
+	const int iy = (int)fy;
+	const double dx = x - fx;
+	const double dy = y - fy;
+
+	const double g00 = Gradient(seed, ix, iy, dx, dy);
+	const double g10 = Gradient(seed, ix + 1, iy, dx - 1.0, dy);
+	const double g01 = Gradient(seed, ix, iy + 1, dx, dy - 1.0);
+	const double g11 = Gradient(seed, ix + 1, iy + 1, dx - 1.0, dy - 1.0);
+
+	const double u = Fade(dx);
+	const double v = Fade(dy);
+	const double top = g00 + (g10 - g00) * u;
+	const double bottom = g01 + (g11 - g01) * u;
+
+	return top + (bottom - top) * v;
+}
+
+// Height at world point (x, y) as a proportion of the height range,
+//  before the water is flattened
+static double Elevation(const struct ProceduralParams &params,
+	double x, double y)
+{
+	double sum = 0.0;
+	double amplitude = 1.0;
+	double amplitudes = 0.0;
+	double frequency = 1.0 / params.feature_size;
+
+	for (int octave = 0; octave < params.octaves; ++octave) {
+		// Each octave from noise of its own so that the lattices do not line up
+		const unsigned int seed = Hash(params.seed, octave, 0);
+
+		sum += amplitude * Noise(seed, x * frequency, y * frequency);
+		amplitudes += amplitude;
+
+		amplitude *= 0.5;
+		frequency *= 2.0;
+	}
+
+	const double n = amplitudes > 0.0 ? sum / amplitudes : 0.0;
+
+	return std::min(std::max(0.5 + n, 0.0), 1.0);
+}
+
+// World space height of land (or water) at `elevation`
+static double ElevationHeight(
+	const struct ProceduralParams &params,
+	double elevation)
+{
+	return params.min_height + std::max(elevation, PROCEDURAL_WATER)
+		* (params.max_height - params.min_height);
+}
+
+// Write to `rgb` the color of land (or water) at `elevation`
+static void ElevationColor(double elevation, unsigned char *rgb) {
+	static const double keys[] = {
+		0.0, PROCEDURAL_WATER, PROCEDURAL_WATER + 0.001,
+		PROCEDURAL_WATER + 0.04, 0.6, 0.7, 0.8, 0.84, 1.0
+	};
+	static const unsigned char colors[][3] = {
+		{15, 40, 100}, {50, 100, 170}, {194, 178, 128},
+		{80, 130, 55}, {50, 90, 40}, {115, 105, 95},
+		{150, 145, 140}, {240, 240, 245}, {255, 255, 255}
+	};
+	const int count = sizeof(keys) / sizeof(keys[0]);
+
+	int k = 1;
+	while (k < count - 1 && elevation > keys[k]) {
+		k += 1;
+	}
+
+	const double t = std::min(std::max(
+		(elevation - keys[k - 1]) / (keys[k] - keys[k - 1]), 0.0), 1.0);
+
+	for (int c = 0; c < 3; ++c) {
+		rgb[c] = (unsigned char)(
+			colors[k - 1][c] + (colors[k][c] - colors[k - 1][c]) * t + 0.5);
+	}
+}
+
+void GenerateTile(
+	const struct ProceduralParams &params,
+	int x,
+	int y,
+	int cells,
+	struct ProceduralTile *tile)
+{
+	const double tile_size = params.tile_cells * params.grid_width;
+	const double cell_size = tile_size / cells;
+	const double x0 = x * tile_size;
+	const double y0 = -y * tile_size;
+
+	tile->x = x;
+	tile->y = y;
+	tile->cells = cells;
+	tile->heights.resize((size_t)cells * cells);
+	tile->colors.resize((size_t)cells * cells * 4);
+
+	double max_z = params.min_height;
+
+	for (int gy = 0; gy < cells; ++gy) {
+		for (int gx = 0; gx < cells; ++gx) {
+			const double wx = x0 + (gx + 0.5) * cell_size;
+			const double wy = y0 - (gy + 0.5) * cell_size;
+			const double elevation = Elevation(params, wx, wy);
+			const double z = ElevationHeight(params, elevation);
+			const size_t i = (size_t)gy * cells + gx;
+
+			tile->heights[i] = z - params.min_height;
+			max_z = std::max(max_z, z);
+
+			unsigned char *const rgba = &tile->colors[i * 4];
+			ElevationColor(elevation, rgba);
+			rgba[3] = 255;
+
+			// Vary the brightness of cells a little to give flat ground detail
+			const int grain = (int)(Hash(params.seed,
+				(int)std::floor(wx / params.grid_width),
+				(int)std::floor(wy / params.grid_width)) & 15) - 8;
+
+			for (int c = 0; c < 3; ++c) {
+				rgba[c] = (unsigned char)std::min(std::max(
+					rgba[c] + grain, 0), 255);
+			}
+		}
+	}
+
+	tile->max_z = max_z;
+	tile->mip.Build(&tile->heights[0], cells, cells);
+	tile->light.Clear();
+	tile->light_azimuth = std::numeric_limits<double>::quiet_NaN();
+}
+
+void BakeTileLight(
+	const struct ProceduralParams &params,
+	const struct Sun &sun,
+	struct ProceduralTile *tile)
+{
+	const int cells = tile->cells;
+	const double tile_size = params.tile_cells * params.grid_width;
+	const double cell_size = tile_size / cells;
+
+	// The ranges are in cells of a full tile
+	const int occlusion_margin =
+		(LIGHT_OCCLUSION_RANGE * cells + params.tile_cells - 1)
+		/ params.tile_cells;
+	const int horizon_margin =
+		(LIGHT_HORIZON_RANGE * cells + params.tile_cells - 1)
+		/ params.tile_cells;
+
+	// Toward the sun in grid coordinates
+	const double sun_x = std::cos(sun.azimuth);
+	const double sun_y = -std::sin(sun.azimuth);
+	const int left = occlusion_margin
+		+ (sun_x < 0.0 ? (int)std::ceil(-sun_x * horizon_margin) : 0);
+	const int right = occlusion_margin
+		+ (sun_x > 0.0 ? (int)std::ceil(sun_x * horizon_margin) : 0);
+	const int top = occlusion_margin
+		+ (sun_y < 0.0 ? (int)std::ceil(-sun_y * horizon_margin) : 0);
+	const int bottom = occlusion_margin
+		+ (sun_y > 0.0 ? (int)std::ceil(sun_y * horizon_margin) : 0);
+
+	const int width = left + cells + right;
+	const int height = top + cells + bottom;
+	const double x0 = tile->x * tile_size - left * cell_size;
+	const double y0 = -tile->y * tile_size + top * cell_size;
+
+	std::vector<double> heights((size_t)width * height);
+
+	for (int gy = 0; gy < height; ++gy) {
+		for (int gx = 0; gx < width; ++gx) {
+			const size_t i = (size_t)gy * width + gx;
+			const int tx = gx - left;
+			const int ty = gy - top;
+
+			// The tile's own as they are, the rest as GenerateTile would
+			if (tx >= 0 && ty >= 0 && tx < cells && ty < cells) {
+				heights[i] = tile->heights[(size_t)ty * cells + tx];
+				continue;
+			}
+
+			const double wx = x0 + (gx + 0.5) * cell_size;
+			const double wy = y0 - (gy + 0.5) * cell_size;
+			const double z =
+				ElevationHeight(params, Elevation(params, wx, wy));
+
+			heights[i] = z - params.min_height;
+		}
+	}
+
+	tile->light.BuildRegion(&heights[0], width, height,
+		left, top, cells, cells, cell_size, sun, &tile->heights[0]);
+	tile->light_azimuth = sun.azimuth;
+}
+
+void TilesInRange(
+	const struct ProceduralParams &params,
+	double x,
+	double y,
+	double range,
+	std::vector<std::pair<int, int> > *tiles)
+{
+	const double tile_size = params.tile_cells * params.grid_width;
+
+	// In tile space, where y increases along the negative y axis
+	const double ty = -y;
+	const int x0 = (int)std::floor((x - range) / tile_size);
+	const int x1 = (int)std::floor((x + range) / tile_size);
+	const int y0 = (int)std::floor((ty - range) / tile_size);
+	const int y1 = (int)std::floor((ty + range) / tile_size);
+
+	tiles->clear();
+
+	for (int j = y0; j <= y1; ++j) {
+		for (int i = x0; i <= x1; ++i) {
+			// Nearest point of the tile
+			const double nx = std::min(std::max(x, i * tile_size),
+				(i + 1) * tile_size);
+			const double ny = std::min(std::max(ty, j * tile_size),
+				(j + 1) * tile_size);
+
+			if ((nx - x) * (nx - x) + (ny - ty) * (ny - ty) <= range * range) {
+				tiles->push_back(std::make_pair(i, j));
+			}
+		}
+	}
+}
+
+ProceduralCache::ProceduralCache() {
+	full_count = 0;
+	evicted = 0;
+}
+
+struct ProceduralTile *ProceduralCache::Find(
+	int x, int y, bool full, long long now)
+{
+	std::map<std::pair<int, int>, struct Entry>::iterator it =
+		entries.find(std::make_pair(x, y));
+
+	if (it == entries.end()) {
+		return NULL;
+	}
+
+	it->second.used = now;
+
+	if (full) {
+		return it->second.has_full ? &it->second.full : NULL;
+	}
+
+	return it->second.has_coarse ? &it->second.coarse : NULL;
+}
+
+bool ProceduralCache::Add(
+	struct ProceduralTile *tile, bool full, long long now)
+{
+	const std::pair<int, int> key(tile->x, tile->y);
+	std::map<std::pair<int, int>, struct Entry>::iterator it =
+		entries.find(key);
+
+	if (it == entries.end()) {
+		struct Entry entry;
+		entry.has_full = false;
+		entry.has_coarse = false;
+		it = entries.insert(std::make_pair(key, entry)).first;
+	}
+
+	struct Entry &entry = it->second;
+	struct ProceduralTile &kept = full ? entry.full : entry.coarse;
+	bool &has = full ? entry.has_full : entry.has_coarse;
+	const bool replaced = has;
+
+	if (full && !has) {
+		full_count += 1;
+	}
+
+	kept.x = tile->x;
+	kept.y = tile->y;
+	kept.cells = tile->cells;
+	kept.max_z = tile->max_z;
+	kept.light_azimuth = tile->light_azimuth;
+	kept.heights.swap(tile->heights);
+	kept.colors.swap(tile->colors);
+	kept.mip.Swap(tile->mip);
+	kept.light.Swap(tile->light);
+	tile->heights.clear();
+	tile->colors.clear();
+	tile->mip = MaxMip();
+	tile->light.Clear();
+
+	has = true;
+	entry.used = now;
+
+	return replaced;
+}
+
+void ProceduralCache::Trim(int capacity, long long now) {
+	while ((int)entries.size() > capacity) {
+		std::map<std::pair<int, int>, struct Entry>::iterator oldest =
+			entries.end();
+
+		for (std::map<std::pair<int, int>, struct Entry>::iterator it =
+			entries.begin(); it != entries.end(); ++it)
+		{
+			if (it->second.used < now
+				&& (oldest == entries.end()
+					|| it->second.used < oldest->second.used))
+			{
+				oldest = it;
+			}
+		}
+
+		// All in use
+		if (oldest == entries.end()) {
+			return;
+		}
+
+		if (oldest->second.has_full) {
+			full_count -= 1;
+		}
+
+		entries.erase(oldest);
+		evicted += 1;
+	}
+}
+
+void ProceduralCache::Clear() {
+	entries.clear();
+	full_count = 0;
+	evicted = 0;
+}
+
+int ProceduralCache::Count() const {
+	return (int)entries.size();
+}
+
+int ProceduralCache::FullCount() const {
+	return full_count;
+}
+
+int ProceduralCache::Evicted() const {
+	return evicted;
+}
@@ -0,0 +1,128 @@
+#ifndef PROCEDURAL_HPP
+#define PROCEDURAL_HPP
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Light.hpp"
+#include "MaxMip.hpp"
+
+// Cells of a full tile per cell of its coarse version
+#define PROCEDURAL_COARSE 8
+
+// Endless terrain of fractal (fBm) noise, generated in square tiles.
+// Tile (x, y) has its upper left corner at world (x, -y) * tile size,
+//  so that tile y increases along the negative y axis like grid y.
+struct ProceduralParams {
+	unsigned int seed;
+	// Layers of noise, each of half the size and height of the one before
+	int octaves;
+	// World space size of the largest features
+	double feature_size;
+	double min_height;
+	double max_height;
+
+	// Grid cells along each side of a tile, a multiple of PROCEDURAL_COARSE,
+	//  and their world space size
+	int tile_cells;
+	double grid_width;
+};
+
+bool operator==(
+	const struct ProceduralParams &a,
+	const struct ProceduralParams &b);
+
+// A tile generated at full detail or coarsely
+struct ProceduralTile {
+	int x;
+	int y;
+	// Cells along each side
+	int cells;
+	// Highest height in the tile, for bounds tighter than max_height
+	double max_z;
+	// Heights above params.min_height
+	std::vector<double> heights;
+	std::vector<unsigned char> colors;
+	// Max mip of `heights`
+	MaxMip mip;
+	// Light of `heights`, empty until baked,
+	//  and the sun azimuth that BakeTileLight baked it for (NaN if not)
+	TerrainLight light;
+	double light_azimuth;
+};
+
+// Generate tile (x, y) with `cells` cells along each side,
+//  params.tile_cells for full detail.
+// Each cell takes the height at its center.
+// Also builds the tile's max mip, so that nothing of it is left to do
+//  on the thread that draws it.
+void GenerateTile(
+	const struct ProceduralParams &params,
+	int x,
+	int y,
+	int cells,
+	struct ProceduralTile *tile);
+
+// Bake the light of `tile` from heights generated around it as well,
+//  as far as LIGHT_OCCLUSION_RANGE cells of a full tile on every side
+//  and LIGHT_HORIZON_RANGE toward the sun,
+//  so that its edges are shaded and shadowed like its middle
+void BakeTileLight(
+	const struct ProceduralParams &params,
+	const struct Sun &sun,
+	struct ProceduralTile *tile);
+
+// Write to `tiles` the tiles within `range` of world point (x, y),
+//  in order of y then x
+void TilesInRange(
+	const struct ProceduralParams &params,
+	double x,
+	double y,
+	double range,
+	std::vector<std::pair<int, int> > *tiles);
+
+// Tiles generated so far, at most a given number at full detail,
+//  dropping those used least recently
+class ProceduralCache {
+public:
+	// The tile at full detail (or coarse if not `full`), or NULL if missing.
+	// Marks it as used at time `now`.
+	struct ProceduralTile *Find(int x, int y, bool full, long long now);
+
+	// Take the contents of `tile`, which are left empty.
+	// Returns whether that replaced the contents of a tile kept already,
+	//  which are freed.
+	bool Add(struct ProceduralTile *tile, bool full, long long now);
+
+	// Drop the least recently used tiles not used at time `now`
+	//  until there are at most `capacity`
+	void Trim(int capacity, long long now);
+
+	void Clear();
+
+	// Tiles kept, and those of them at full detail
+	int Count() const;
+	int FullCount() const;
+	// Tiles dropped since the last Clear
+	int Evicted() const;
+
+	ProceduralCache();
+
+private:
+	struct Entry {
+		struct ProceduralTile full;
+		struct ProceduralTile coarse;
+		bool has_full;
+		bool has_coarse;
+		long long used;
+	};
+
+	// The entries do not move while in the map,
+	//  so terrains can reference their tiles
+	std::map<std::pair<int, int>, struct Entry> entries;
+	int full_count;
+	int evicted;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "Process.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+bool SpawnChild(
+	const std::string &path,
+	const std::vector<std::string> &args,
+	struct ChildProcess *child)
+{
+	int fds[2];
+
+	// Close-on-exec so that other children do not hold this socket open,
+	//  which would hide the end of file when this child exits.
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+		std::perror("socketpair");
+		return false;
+	}
+
+	// Build argv before forking
+	std::stringstream ss;
+	ss << fds[1];
+	const std::string fd_arg = ss.str();
+
+	std::vector<char*> argv;
+	for (size_t i = 0; i < args.size(); ++i) {
+		argv.push_back(const_cast<char*>(args[i].c_str()));
+	}
+	argv.push_back(const_cast<char*>(fd_arg.c_str()));
+	argv.push_back(NULL);
+
+	const pid_t pid = fork();
+
+	if (pid < 0) {
+		std::perror("fork");
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	if (pid == 0) {
+		// Keep the child's end open across exec
+		fcntl(fds[1], F_SETFD, 0);
+		execv(path.c_str(), &argv[0]);
+		std::perror("execv");
+		_exit(127);
+	}
+
+	close(fds[1]);
+
+	child->pid = pid;
+	child->fd = fds[0];
+
+	return true;
+}
+
+void EndChild(struct ChildProcess *child) {
+	if (child->fd >= 0) {
+		close(child->fd);
+		child->fd = -1;
+	}
+
+	if (child->pid > 0) {
+		// Closing the socket asks the child to exit.
+		// Only kill it if it has not.
+		int status;
+		if (waitpid(child->pid, &status, WNOHANG) == 0) {
+			usleep(100000);
+
+			if (waitpid(child->pid, &status, WNOHANG) == 0) {
+				kill(child->pid, SIGKILL);
+				waitpid(child->pid, &status, 0);
+			}
+		}
+
+		child->pid = -1;
+	}
+}
+
+bool ReadAll(int fd, void *buf, size_t size) {
+	char *p = (char*)buf;
+
+	while (size > 0) {
+		const ssize_t n = read(fd, p, size);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			return false;
+		}
+
+		p += n;
+		size -= (size_t)n;
+	}
+
+	return true;
+}
+
+bool WriteAll(int fd, const void *buf, size_t size) {
+	const char *p = (const char*)buf;
+
+	while (size > 0) {
+		const ssize_t n = write(fd, p, size);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			return false;
+		}
+
+		p += n;
+		size -= (size_t)n;
+	}
+
+	return true;
+}
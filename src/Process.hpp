@@ -0,0 +1,31 @@
+#ifndef PROCESS_HPP
+#define PROCESS_HPP
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+// A child process connected to this one by a socket
+struct ChildProcess {
+	pid_t pid;
+	// This process's end of the socket
+	int fd;
+};
+
+// Run the program at `path` with the given argv (starting with argv[0])
+//  followed by the file descriptor number of the child's end of the socket.
+bool SpawnChild(
+	const std::string &path,
+	const std::vector<std::string> &args,
+	struct ChildProcess *child);
+
+// Close the socket, kill the child if still running, and wait for it.
+void EndChild(struct ChildProcess *child);
+
+// Read/write exactly `size` bytes, retrying short transfers.
+// Return false on error or end of file.
+bool ReadAll(int fd, void *buf, size_t size);
+bool WriteAll(int fd, const void *buf, size_t size);
+
+#endif
@@ -0,0 +1,630 @@
+#include "Raster.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Most triangles across a chunk
+#define RASTER_CHUNK 32
+// Pixels across a tile of the screen
+#define RASTER_TILE 32
+// Distance along `look` in front of which triangles are clipped
+#define RASTER_NEAR 1e-4
+
+// Where the view's pixels are
+struct RasterView {
+	glm::dvec3 cam_pos;
+	glm::dvec3 look;
+
+	// The pixel x of a point at v from the camera, z along `look`,
+	//  is dot(v, to_x) / z - off_x, and the same for y
+	glm::dvec3 to_x;
+	glm::dvec3 to_y;
+	double off_x;
+	double off_y;
+
+	// Pixels across a unit one unit in front of the camera
+	double focal;
+	double lod_pixels;
+
+	int width;
+	int height;
+	// Rows [y0, y1] are drawn
+	int y0;
+	int y1;
+};
+
+// What is drawn nearest in a tile
+struct TileBuffer {
+	// Reciprocal of the depth, 0 for nothing
+	double inv_z[RASTER_TILE * RASTER_TILE];
+	int terrain[RASTER_TILE * RASTER_TILE];
+	int cell[RASTER_TILE * RASTER_TILE];
+
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+};
+
+static int ClampToInt(double v, int min, int max) {
+	if (v < min) {
+		return min;
+	}
+
+	if (v > max) {
+		return max;
+	}
+
+	return (int)v;
+}
+
+static void Project(const struct RasterView &view, struct RasterVertex *vertex) {
+	vertex->px = glm::dot(vertex->v, view.to_x) / vertex->z - view.off_x;
+	vertex->py = glm::dot(vertex->v, view.to_y) / vertex->z - view.off_y;
+}
+
+static struct RasterVertex MakeVertex(
+	const struct RasterView &view,
+	const glm::dvec3 &p,
+	double u,
+	double gv)
+{
+	struct RasterVertex vertex;
+
+	vertex.v = p - view.cam_pos;
+	vertex.z = glm::dot(vertex.v, view.look);
+	vertex.px = 0.0;
+	vertex.py = 0.0;
+	vertex.u = u;
+	vertex.gv = gv;
+
+	if (vertex.z >= RASTER_NEAR) {
+		Project(view, &vertex);
+	}
+
+	return vertex;
+}
+
+// Box around the chunk of vertices [x0, x1] x [y0, y1] and their skirts
+static void ChunkBox(
+	const struct Terrain &terrain,
+	const MaxMip &mip,
+	int x0,
+	int y0,
+	int x1,
+	int y1,
+	glm::dvec3 *lo,
+	glm::dvec3 *hi)
+{
+	const double gw = terrain.grid_width;
+
+	*lo = glm::dvec3(
+		terrain.c0.x + (x0 + 0.5) * gw,
+		terrain.c0.y - (y1 + 0.5) * gw,
+		terrain.c0.z);
+	*hi = glm::dvec3(
+		terrain.c0.x + (x1 + 0.5) * gw,
+		terrain.c0.y - (y0 + 0.5) * gw,
+		terrain.c0.z + mip.MaxHeight(x0, y0, x1, y1));
+}
+
+// Add the chunks of the quadtree node of vertices [x0, x1] x [y0, y1]
+//  that are in view to `chunks`
+static void VisitNode(
+	const struct RasterView &view,
+	Perspective &camera,
+	const struct Terrain &terrain,
+	const MaxMip &mip,
+	int index,
+	int x0,
+	int y0,
+	int x1,
+	int y1,
+	std::vector<struct RasterChunk> *chunks)
+{
+	// No triangles
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	glm::dvec3 lo;
+	glm::dvec3 hi;
+	ChunkBox(terrain, mip, x0, y0, x1, y1, &lo, &hi);
+
+	double w0;
+	double h0;
+	double w1;
+	double h1;
+	camera.ScreenBounds(lo, hi, &w0, &h0, &w1, &h1);
+
+	// To pixels with one to spare for rounding
+	const double max_x = view.width - 1;
+	const double px0 = std::floor(w0 * max_x) - 1.0;
+	const double px1 = std::ceil(w1 * max_x) + 1.0;
+	const double py0 = std::floor(h0 * (view.height - 1)) - 1.0;
+	const double py1 = std::ceil(h1 * (view.height - 1)) + 1.0;
+
+	if (w0 > w1 || px1 < 0.0 || px0 > max_x
+		|| py1 < view.y0 || py0 > view.y1)
+	{
+		return;
+	}
+
+	// Coarsest stride whose triangles are at most `lod_pixels` across
+	//  at the nearest point of the box
+	const glm::dvec3 outside = glm::max(
+		glm::max(lo - view.cam_pos, view.cam_pos - hi), glm::dvec3(0.0, 0.0, 0.0));
+	const double distance = glm::length(outside);
+	const double cell_pixels = terrain.grid_width * view.focal / distance;
+
+	const int span = std::max(x1 - x0, y1 - y0);
+	int stride = 1;
+	while (stride * 2 <= span && stride * 2 * cell_pixels <= view.lod_pixels) {
+		stride *= 2;
+	}
+
+	// Small on the screen too, so that few tiles draw all of its triangles
+	const bool few_tiles = span <= 4 * stride
+		|| (px1 - px0 <= 2 * RASTER_TILE && py1 - py0 <= 2 * RASTER_TILE);
+
+	if (span <= stride * RASTER_CHUNK && few_tiles) {
+		struct RasterChunk chunk;
+		chunk.terrain = index;
+		chunk.x0 = x0;
+		chunk.y0 = y0;
+		chunk.x1 = x1;
+		chunk.y1 = y1;
+		chunk.stride = stride;
+		chunk.nx = (x1 - x0 + stride - 1) / stride + 1;
+		chunk.ny = (y1 - y0 + stride - 1) / stride + 1;
+		chunk.px0 = ClampToInt(px0, 0, view.width - 1);
+		chunk.px1 = ClampToInt(px1, 0, view.width - 1);
+		chunk.py0 = ClampToInt(py0, view.y0, view.y1);
+		chunk.py1 = ClampToInt(py1, view.y0, view.y1);
+		chunk.first = 0;
+
+		chunks->push_back(chunk);
+		return;
+	}
+
+	const int xm = (x0 + x1) / 2;
+	const int ym = (y0 + y1) / 2;
+
+	VisitNode(view, camera, terrain, mip, index, x0, y0, xm, ym, chunks);
+	VisitNode(view, camera, terrain, mip, index, xm, y0, x1, ym, chunks);
+	VisitNode(view, camera, terrain, mip, index, x0, ym, xm, y1, chunks);
+	VisitNode(view, camera, terrain, mip, index, xm, ym, x1, y1, chunks);
+}
+
+// Write the chunk's vertices to `vertices` from chunk.first
+static void MakeChunkVertices(
+	const struct RasterView &view,
+	const struct Terrain &terrain,
+	const struct RasterChunk &chunk,
+	struct RasterVertex *vertices)
+{
+	const double gw = terrain.grid_width;
+	const int nx = chunk.nx;
+	const int ny = chunk.ny;
+
+	struct RasterVertex *const surface = vertices + chunk.first;
+	struct RasterVertex *const skirt = surface + nx * ny;
+
+	for (int j = 0; j < ny; ++j) {
+		const int gy = std::min(chunk.y0 + j * chunk.stride, chunk.y1);
+
+		for (int i = 0; i < nx; ++i) {
+			const int gx = std::min(chunk.x0 + i * chunk.stride, chunk.x1);
+
+			const glm::dvec3 p(
+				terrain.c0.x + (gx + 0.5) * gw,
+				terrain.c0.y - (gy + 0.5) * gw,
+				terrain.c0.z + terrain.heights[gx + gy * terrain.width]);
+
+			surface[i + j * nx] = MakeVertex(view, p, gx, gy);
+		}
+	}
+
+	// Skirts hang from the edges to fill the gaps
+	//  next to chunks with other strides.
+	// Both sides of a gap are between heights of the cells on the edge,
+	//  so the skirt only needs to reach the lowest of them.
+	// On the terrain's border it reaches the bottom,
+	//  giving the terrain sides like the marched columns'.
+	const int edges[4][2] = {
+		{0, 0}, {(ny - 1) * nx, 0}, {0, 1}, {nx - 1, 1}
+	};
+	const int edge_cells[4][4] = {
+		{chunk.x0, chunk.y0, chunk.x1, chunk.y0},
+		{chunk.x0, chunk.y1, chunk.x1, chunk.y1},
+		{chunk.x0, chunk.y0, chunk.x0, chunk.y1},
+		{chunk.x1, chunk.y0, chunk.x1, chunk.y1}
+	};
+	const bool border[4] = {
+		chunk.y0 == 0, chunk.y1 == terrain.height - 1,
+		chunk.x0 == 0, chunk.x1 == terrain.width - 1
+	};
+	int k = 0;
+
+	for (int e = 0; e < 4; ++e) {
+		const int count = edges[e][1] ? ny : nx;
+		const int step = edges[e][1] ? nx : 1;
+
+		double bottom = terrain.c0.z;
+		if (!border[e]) {
+			double lowest = HUGE_VAL;
+
+			for (int gy = edge_cells[e][1]; gy <= edge_cells[e][3]; ++gy) {
+				for (int gx = edge_cells[e][0]; gx <= edge_cells[e][2]; ++gx) {
+					lowest = std::min(lowest,
+						terrain.heights[gx + gy * terrain.width]);
+				}
+			}
+
+			bottom += lowest;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			const struct RasterVertex &top = surface[edges[e][0] + i * step];
+
+			const glm::dvec3 p(
+				top.v.x + view.cam_pos.x,
+				top.v.y + view.cam_pos.y,
+				bottom);
+
+			skirt[k] = MakeVertex(view, p, top.u, top.gv);
+			k += 1;
+		}
+	}
+}
+
+// Draw a triangle whose vertices are all in front of the near plane
+static void DrawProjected(
+	const struct RasterVertex &a,
+	const struct RasterVertex &b,
+	const struct RasterVertex &c,
+	const struct Terrain &terrain,
+	int index,
+	struct TileBuffer *tile)
+{
+	const double area =
+		(b.px - a.px) * (c.py - a.py) - (b.py - a.py) * (c.px - a.px);
+
+	if (std::fabs(area) < 1e-12) {
+		return;
+	}
+
+	const int x0 = ClampToInt(std::ceil(std::min(std::min(a.px, b.px), c.px)),
+		tile->x0, tile->x1 + 1);
+	const int x1 = ClampToInt(std::floor(std::max(std::max(a.px, b.px), c.px)),
+		tile->x0 - 1, tile->x1);
+	const int y0 = ClampToInt(std::ceil(std::min(std::min(a.py, b.py), c.py)),
+		tile->y0, tile->y1 + 1);
+	const int y1 = ClampToInt(std::floor(std::max(std::max(a.py, b.py), c.py)),
+		tile->y0 - 1, tile->y1);
+
+	if (x0 > x1 || y0 > y1) {
+		return;
+	}
+
+	const double inv_area = 1.0 / area;
+	// Let pixels exactly on a shared edge through despite rounding
+	const double slack = -1e-9;
+
+	// Barycentric weights of a and b are linear across the screen
+	const double la_dx = (b.py - c.py) * inv_area;
+	const double la_dy = (c.px - b.px) * inv_area;
+	const double lb_dx = (c.py - a.py) * inv_area;
+	const double lb_dy = (a.px - c.px) * inv_area;
+
+	const double la_00 =
+		((b.px - x0) * (c.py - y0) - (b.py - y0) * (c.px - x0)) * inv_area;
+	const double lb_00 =
+		((c.px - x0) * (a.py - y0) - (c.py - y0) * (a.px - x0)) * inv_area;
+
+	// For perspective correct interpolation
+	const double inv_za = 1.0 / a.z;
+	const double inv_zb = 1.0 / b.z;
+	const double inv_zc = 1.0 / c.z;
+
+	for (int y = y0; y <= y1; ++y) {
+		double la = la_00 + (y - y0) * la_dy;
+		double lb = lb_00 + (y - y0) * lb_dy;
+
+		for (int x = x0; x <= x1; ++x, la += la_dx, lb += lb_dx) {
+			const double lc = 1.0 - la - lb;
+
+			if (la < slack || lb < slack || lc < slack) {
+				continue;
+			}
+
+			const double wa = la * inv_za;
+			const double wb = lb * inv_zb;
+			const double wc = lc * inv_zc;
+			const double inv_z = wa + wb + wc;
+
+			const int p = (x - tile->x0) + (y - tile->y0) * RASTER_TILE;
+
+			if (inv_z <= tile->inv_z[p]) {
+				continue;
+			}
+
+			const double u = (wa * a.u + wb * b.u + wc * c.u) / inv_z;
+			const double gv = (wa * a.gv + wb * b.gv + wc * c.gv) / inv_z;
+
+			const int gx = ClampToInt(std::floor(u + 0.5), 0, terrain.width - 1);
+			const int gy = ClampToInt(std::floor(gv + 0.5), 0, terrain.height - 1);
+
+			tile->inv_z[p] = inv_z;
+			tile->terrain[p] = index;
+			tile->cell[p] = gx + gy * terrain.width;
+		}
+	}
+}
+
+// Point where the edge from a to b crosses the near plane
+static struct RasterVertex NearCrossing(
+	const struct RasterView &view,
+	const struct RasterVertex &a,
+	const struct RasterVertex &b)
+{
+	const double t = (RASTER_NEAR - a.z) / (b.z - a.z);
+
+	struct RasterVertex vertex;
+	vertex.v = a.v + t * (b.v - a.v);
+	vertex.z = RASTER_NEAR;
+	vertex.u = a.u + t * (b.u - a.u);
+	vertex.gv = a.gv + t * (b.gv - a.gv);
+	Project(view, &vertex);
+
+	return vertex;
+}
+
+// Draw a triangle, clipping away what is behind the near plane
+static void DrawTriangle(
+	const struct RasterView &view,
+	const struct RasterVertex &a,
+	const struct RasterVertex &b,
+	const struct RasterVertex &c,
+	const struct Terrain &terrain,
+	int index,
+	struct TileBuffer *tile)
+{
+	const bool in_a = a.z >= RASTER_NEAR;
+	const bool in_b = b.z >= RASTER_NEAR;
+	const bool in_c = c.z >= RASTER_NEAR;
+
+	if (in_a && in_b && in_c) {
+		DrawProjected(a, b, c, terrain, index, tile);
+		return;
+	}
+
+	if (!in_a && !in_b && !in_c) {
+		return;
+	}
+
+	const struct RasterVertex *const in[3] = {&a, &b, &c};
+	struct RasterVertex clipped[4];
+	int count = 0;
+
+	for (int i = 0; i < 3; ++i) {
+		const struct RasterVertex &p = *in[i];
+		const struct RasterVertex &q = *in[(i + 1) % 3];
+		const bool in_p = p.z >= RASTER_NEAR;
+		const bool in_q = q.z >= RASTER_NEAR;
+
+		if (in_p) {
+			clipped[count] = p;
+			count += 1;
+		}
+
+		if (in_p != in_q) {
+			clipped[count] = NearCrossing(view, p, q);
+			count += 1;
+		}
+	}
+
+	for (int i = 2; i < count; ++i) {
+		DrawProjected(clipped[0], clipped[i - 1], clipped[i],
+			terrain, index, tile);
+	}
+}
+
+static void DrawChunk(
+	const struct RasterView &view,
+	const struct Terrain &terrain,
+	const struct RasterChunk &chunk,
+	const struct RasterVertex *vertices,
+	struct TileBuffer *tile)
+{
+	const int nx = chunk.nx;
+	const int ny = chunk.ny;
+	const struct RasterVertex *const surface = vertices + chunk.first;
+	const struct RasterVertex *const skirt = surface + nx * ny;
+
+	for (int j = 0; j + 1 < ny; ++j) {
+		for (int i = 0; i + 1 < nx; ++i) {
+			const struct RasterVertex &v00 = surface[i + j * nx];
+			const struct RasterVertex &v10 = surface[i + 1 + j * nx];
+			const struct RasterVertex &v01 = surface[i + (j + 1) * nx];
+			const struct RasterVertex &v11 = surface[i + 1 + (j + 1) * nx];
+
+			DrawTriangle(view, v00, v10, v11, terrain, chunk.terrain, tile);
+			DrawTriangle(view, v00, v11, v01, terrain, chunk.terrain, tile);
+		}
+	}
+
+	// Top and bottom edges, then left and right
+	const struct RasterVertex *edges[4];
+	edges[0] = surface;
+	edges[1] = surface + (ny - 1) * nx;
+	edges[2] = surface;
+	edges[3] = surface + nx - 1;
+
+	int k = 0;
+
+	for (int e = 0; e < 4; ++e) {
+		const int count = e < 2 ? nx : ny;
+		const int step = e < 2 ? 1 : nx;
+
+		for (int i = 0; i + 1 < count; ++i) {
+			const struct RasterVertex &t0 = edges[e][i * step];
+			const struct RasterVertex &t1 = edges[e][(i + 1) * step];
+			const struct RasterVertex &b0 = skirt[k + i];
+			const struct RasterVertex &b1 = skirt[k + i + 1];
+
+			DrawTriangle(view, t0, t1, b1, terrain, chunk.terrain, tile);
+			DrawTriangle(view, t0, b1, b0, terrain, chunk.terrain, tile);
+		}
+
+		k += count;
+	}
+}
+
+void RasterTerrains(
+	Perspective &camera,
+	const std::vector<struct Terrain> &terrains,
+	double lod_pixels,
+	int width,
+	int height,
+	int y0,
+	int rows,
+	int *hit_terrain,
+	int *hit_cell,
+	struct RasterBuffers *buffers)
+{
+	struct RasterView view;
+	view.cam_pos = camera.cam_pos;
+	view.look = camera.look;
+	view.to_x = camera.plane_right
+		* ((width - 1) / glm::dot(camera.plane_right, camera.plane_right));
+	view.to_y = camera.plane_down
+		* ((height - 1) / glm::dot(camera.plane_down, camera.plane_down));
+	view.off_x = glm::dot(camera.upper_left - camera.cam_pos, view.to_x);
+	view.off_y = glm::dot(camera.upper_left - camera.cam_pos, view.to_y);
+	view.focal = (width - 1) / glm::length(camera.plane_right);
+	view.lod_pixels = lod_pixels;
+	view.width = width;
+	view.height = height;
+	view.y0 = y0;
+	view.y1 = y0 + rows - 1;
+
+	std::vector<struct RasterChunk> &chunks = buffers->chunks;
+	chunks.clear();
+
+	for (size_t i = 0; i < terrains.size(); ++i) {
+		const struct Terrain &t = terrains[i];
+		const glm::dvec3 p = camera.cam_pos;
+
+		// BVH::Trace takes rays starting inside a terrain's box
+		//  as not hitting it
+		if (p.x >= t.c0.x && p.x <= t.c1.x
+			&& p.y <= t.c0.y && p.y >= t.c1.y
+			&& p.z >= t.c0.z && p.z <= t.c1.z)
+		{
+			continue;
+		}
+
+		VisitNode(view, camera, terrains[i], *terrains[i].mip, (int)i,
+			0, 0, terrains[i].width - 1, terrains[i].height - 1, &chunks);
+	}
+
+	size_t vertex_count = 0;
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		chunks[i].first = vertex_count;
+		vertex_count += chunks[i].nx * chunks[i].ny
+			+ 2 * (chunks[i].nx + chunks[i].ny);
+	}
+
+	std::vector<struct RasterVertex> &vertices = buffers->vertices;
+
+	if (vertices.size() < vertex_count) {
+		vertices.resize(vertex_count);
+	}
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)chunks.size(); ++i) {
+		MakeChunkVertices(view, terrains[chunks[i].terrain], chunks[i],
+			&vertices[0]);
+	}
+
+	// Chunks that may cover each tile
+	const int tiles_x = (width + RASTER_TILE - 1) / RASTER_TILE;
+	const int tiles_y = (rows + RASTER_TILE - 1) / RASTER_TILE;
+	std::vector<int> &bin_start = buffers->bin_start;
+	std::vector<int> &bins = buffers->bins;
+
+	// Count the chunks of each tile, then place them after the counts
+	//  of the tiles before it
+	bin_start.assign(tiles_x * tiles_y + 1, 0);
+
+	for (int pass = 0; pass < 2; ++pass) {
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			const struct RasterChunk &chunk = chunks[i];
+
+			for (int ty = (chunk.py0 - y0) / RASTER_TILE;
+			     ty <= (chunk.py1 - y0) / RASTER_TILE; ++ty)
+			{
+				for (int tx = chunk.px0 / RASTER_TILE;
+				     tx <= chunk.px1 / RASTER_TILE; ++tx)
+				{
+					const int t = tx + ty * tiles_x;
+
+					if (pass == 0) {
+						bin_start[t + 1] += 1;
+					}
+					else {
+						bins[bin_start[t]++] = (int)i;
+					}
+				}
+			}
+		}
+
+		if (pass == 0) {
+			for (int t = 0; t < tiles_x * tiles_y; ++t) {
+				bin_start[t + 1] += bin_start[t];
+			}
+
+			if ((int)bins.size() < bin_start[tiles_x * tiles_y]) {
+				bins.resize(bin_start[tiles_x * tiles_y]);
+			}
+		}
+	}
+
+	// Placing moved each start to the next tile's
+	for (int t = tiles_x * tiles_y; t > 0; --t) {
+		bin_start[t] = bin_start[t - 1];
+	}
+
+	bin_start[0] = 0;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int t = 0; t < tiles_x * tiles_y; ++t) {
+		struct TileBuffer tile;
+		tile.x0 = (t % tiles_x) * RASTER_TILE;
+		tile.y0 = y0 + (t / tiles_x) * RASTER_TILE;
+		tile.x1 = std::min(tile.x0 + RASTER_TILE, width) - 1;
+		tile.y1 = std::min(tile.y0 + RASTER_TILE - 1, view.y1);
+
+		std::fill(tile.inv_z, tile.inv_z + RASTER_TILE * RASTER_TILE, 0.0);
+		std::fill(tile.terrain, tile.terrain + RASTER_TILE * RASTER_TILE, -1);
+		std::fill(tile.cell, tile.cell + RASTER_TILE * RASTER_TILE, 0);
+
+		for (int i = bin_start[t]; i < bin_start[t + 1]; ++i) {
+			const struct RasterChunk &chunk = chunks[bins[i]];
+
+			DrawChunk(view, terrains[chunk.terrain], chunk, &vertices[0], &tile);
+		}
+
+		for (int y = tile.y0; y <= tile.y1; ++y) {
+			for (int x = tile.x0; x <= tile.x1; ++x) {
+				const int p = (x - tile.x0) + (y - tile.y0) * RASTER_TILE;
+				const size_t out = (size_t)(y - y0) * width + x;
+
+				hit_terrain[out] = tile.terrain[p];
+				hit_cell[out] = tile.cell[p];
+			}
+		}
+	}
+}
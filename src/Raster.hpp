@@ -0,0 +1,81 @@
+#ifndef RASTER_HPP
+#define RASTER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "Perspective.hpp"
+#include "Terrain.hpp"
+
+// A block of a terrain's vertices drawn at one level of detail.
+// There is a vertex at the center of every grid cell.
+struct RasterChunk {
+	int terrain;
+	// Vertices [x0, x1] x [y0, y1], every `stride`-th
+	//  and the last ones of the block
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	int stride;
+	int nx;
+	int ny;
+
+	// Pixels that it can cover
+	int px0;
+	int py0;
+	int px1;
+	int py1;
+
+	// Index of its first vertex in the vertex buffer.
+	// nx * ny vertices on the surface are followed by
+	//  the bottoms of its skirt below the top, bottom, left and right edges.
+	size_t first;
+};
+
+struct RasterVertex {
+	// Position relative to the camera
+	glm::dvec3 v;
+	// Distance along `look`
+	double z;
+	// Pixel coordinates if z >= RASTER_NEAR
+	double px;
+	double py;
+	// Grid coordinates
+	double u;
+	double gv;
+};
+
+// What RasterTerrains draws with, kept by the caller between views
+//  so that drawing one does not allocate once they are big enough
+struct RasterBuffers {
+	std::vector<struct RasterChunk> chunks;
+	std::vector<struct RasterVertex> vertices;
+	// Indices of the chunks that may cover each tile of the screen,
+	//  those of tile t in [bin_start[t], bin_start[t + 1])
+	std::vector<int> bin_start;
+	std::vector<int> bins;
+};
+
+// Find the grid cell of a terrain that each pixel
+//  of rows [y0, y0 + rows) of the perspective view sees
+//  by drawing the terrains' heights as a triangle mesh with a depth buffer.
+// Each terrain is split into a quadtree of chunks, skipping those outside
+//  the view and drawing farther ones with fewer triangles,
+//  so that a triangle is about `lod_pixels` pixels across.
+// The screen is drawn in tiles in parallel.
+// Writes to hit_terrain and hit_cell as SplatTerrains does.
+// `buffers` need not be cleared between calls.
+void RasterTerrains(
+	Perspective &camera,
+	const std::vector<struct Terrain> &terrains,
+	double lod_pixels,
+	int width,
+	int height,
+	int y0,
+	int rows,
+	int *hit_terrain,
+	int *hit_cell,
+	struct RasterBuffers *buffers);
+
+#endif
@@ -1,11 +1,11 @@
-#ifndef RAY_HPP
-#define RAY_HPP
-
-#include "glm/glm.hpp"
-
-struct Ray {
-	glm::dvec3 pos;
-	glm::dvec3 dir;
-};
-
-#endif
+#ifndef RAY_HPP
+#define RAY_HPP
+
+#include "glm/glm.hpp"
+
+struct Ray {
+	glm::dvec3 pos;
+	glm::dvec3 dir;
+};
+
+#endif
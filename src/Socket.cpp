@@ -0,0 +1,119 @@
+#include "Socket.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Connections waiting to be accepted at most
+#define LISTEN_BACKLOG 16
+
+static int ListenUnix(const std::string &path) {
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (path.size() >= sizeof(addr.sun_path)) {
+		std::cerr << "Socket path is too long: " << path << "\n";
+		return -1;
+	}
+
+	std::strcpy(addr.sun_path, path.c_str());
+
+	// Only remove what is a socket, not a file given by mistake
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(path.c_str());
+	}
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		std::perror("socket");
+		return -1;
+	}
+
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		std::perror("bind");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int ListenTcp(const std::string &port_text) {
+	char *end;
+	const long port = std::strtol(port_text.c_str(), &end, 10);
+
+	if (*end != '\0' || port <= 0 || port > 65535) {
+		std::cerr << "Not a port or socket path: " << port_text << "\n";
+		return -1;
+	}
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		std::perror("socket");
+		return -1;
+	}
+
+	// Restarting the server does not wait for old connections to time out
+	const int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		std::perror("bind");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ListenLocal(const std::string &address) {
+	const int fd = address.find('/') != std::string::npos
+		? ListenUnix(address)
+		: ListenTcp(address);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (listen(fd, LISTEN_BACKLOG) != 0) {
+		std::perror("listen");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int AcceptLocal(int listener) {
+	while (true) {
+		const int fd = accept(listener, NULL, NULL);
+
+		if (fd < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (fd < 0) {
+			std::perror("accept");
+		}
+
+		return fd;
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef SOCKET_HPP
+#define SOCKET_HPP
+
+#include <string>
+
+// Listen for connections on `address`:
+//  the path of a Unix socket if it contains a '/',
+//  otherwise a TCP port that only accepts connections from this machine.
+// A Unix socket left at the path by an earlier run is replaced.
+// Returns the listening socket, or -1 after printing why it failed.
+int ListenLocal(const std::string &address);
+
+// Accept a connection on `listener`, returning its socket or -1
+int AcceptLocal(int listener);
+
+#endif
@@ -0,0 +1,235 @@
+#include "Splat.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// A column of pixels, in the vertical plane that its rays lie in.
+// s is the horizontal distance along `dir` from the start of row 0's ray.
+struct PixelColumn {
+	// Start of row 0's ray
+	glm::dvec3 top;
+	// Unit horizontal direction of increasing s
+	double dir_x;
+	double dir_y;
+	// Change in the ray's start per row
+	glm::dvec3 row;
+	double row_s;
+	// The rays' direction
+	double look_s;
+	double look_z;
+};
+
+// Row whose ray passes through (s, z), in fractional pixels
+static double RowAt(const struct PixelColumn &col, double s, double z) {
+	const double det = col.row_s * col.look_z - col.row.z * col.look_s;
+
+	return (s * col.look_z - (z - col.top.z) * col.look_s) / det;
+}
+
+// Narrow [*s0, *s1] to where c0 + s * dc is within [0, size]
+static void ClipToGrid(double c0, double dc, int size, double *s0, double *s1) {
+	if (dc == 0.0) {
+		if (c0 < 0.0 || c0 >= size) {
+			*s1 = -HUGE_VAL;
+		}
+
+		return;
+	}
+
+	double a = (0.0 - c0) / dc;
+	double b = (size - c0) / dc;
+
+	if (a > b) {
+		std::swap(a, b);
+	}
+
+	*s0 = std::max(*s0, a);
+	*s1 = std::min(*s1, b);
+}
+
+// Whether the ray of `row` starts inside the terrain's box,
+//  which BVH::Trace takes as not hitting it
+static bool StartsInside(
+	const struct PixelColumn &col,
+	const struct Terrain &terrain,
+	int row)
+{
+	const glm::dvec3 p = col.top + (double)row * col.row;
+
+	return p.x >= terrain.c0.x && p.x <= terrain.c1.x
+		&& p.y <= terrain.c0.y && p.y >= terrain.c1.y
+		&& p.z >= terrain.c0.z && p.z <= terrain.c1.z;
+}
+
+// Walk the terrain's cells under the column front to back,
+//  covering rows [y0, y1] nearer than `depth` (indexed from y0).
+static void SplatTerrain(
+	const struct PixelColumn &col,
+	const struct Terrain &terrain,
+	int index,
+	int y0,
+	int y1,
+	double *depth,
+	int *hit_terrain,
+	int *hit_cell,
+	int stride)
+{
+	const double gw = terrain.grid_width;
+	const glm::dvec3 c0 = terrain.c0;
+	const glm::dvec3 c1 = terrain.c1;
+
+	// Grid coordinates along the column: (u0 + s * du, v0 + s * dv)
+	const double u0 = (col.top.x - c0.x) / gw;
+	const double v0 = (c0.y - col.top.y) / gw;
+	const double du = col.dir_x / gw;
+	const double dv = -col.dir_y / gw;
+
+	// No ray of the rows starts behind the farthest back one
+	double s = std::min(col.row_s * y0, col.row_s * y1);
+	double s_end = HUGE_VAL;
+	ClipToGrid(u0, du, terrain.width, &s, &s_end);
+	ClipToGrid(v0, dv, terrain.height, &s, &s_end);
+
+	if (s >= s_end) {
+		return;
+	}
+
+	int gx = std::min(std::max(
+		(int)std::floor(u0 + s * du), 0), terrain.width - 1);
+	int gy = std::min(std::max(
+		(int)std::floor(v0 + s * dv), 0), terrain.height - 1);
+
+	const int step_x = du > 0.0 ? 1 : -1;
+	const int step_y = dv > 0.0 ? 1 : -1;
+	const double delta_x = du != 0.0 ? 1.0 / std::fabs(du) : HUGE_VAL;
+	const double delta_y = dv != 0.0 ? 1.0 / std::fabs(dv) : HUGE_VAL;
+
+	// Where the column crosses into the next grid column and row
+	double next_x = HUGE_VAL;
+	if (du != 0.0) {
+		next_x = (gx + (du > 0.0 ? 1 : 0) - u0) / du;
+	}
+
+	double next_y = HUGE_VAL;
+	if (dv != 0.0) {
+		next_y = (gy + (dv > 0.0 ? 1 : 0) - v0) / dv;
+	}
+
+	// Every row from `covered` down is seen through a nearer cell
+	//  or passes below where the farther cells can reach
+	//  (their bottoms only get higher on the screen).
+	int covered = y1 + 1;
+
+	while (s < s_end && covered > y0) {
+		const double s_out = std::min(std::min(next_x, next_y), s_end);
+		const int cell = gx + gy * terrain.width;
+		const double top = std::min(terrain.heights[cell] + c0.z, c1.z);
+
+		if (top > c0.z) {
+			// From the far top corner of the cell to its near bottom corner
+			const int ha = std::max(y0,
+				(int)std::ceil(RowAt(col, s_out, top)));
+			const int hb = std::min(covered - 1,
+				(int)std::floor(RowAt(col, s, c0.z)));
+
+			for (int h = ha; h <= hb; ++h) {
+				const double ps = col.row_s * h;
+				const double pz = col.top.z + col.row.z * h;
+
+				double t_front = -HUGE_VAL;
+				double t_back = HUGE_VAL;
+				if (col.look_s > 0.0) {
+					t_front = (s - ps) / col.look_s;
+					t_back = (s_out - ps) / col.look_s;
+				}
+
+				const double entry = std::max(t_front, (top - pz) / col.look_z);
+				const double exit = std::min(t_back, (c0.z - pz) / col.look_z);
+
+				// Starts past the cell, so a farther one may still be seen
+				if (exit < 0.0) {
+					continue;
+				}
+
+				covered = std::min(covered, h);
+
+				if (StartsInside(col, terrain, h) || entry >= depth[h - y0]) {
+					continue;
+				}
+
+				depth[h - y0] = entry;
+				hit_terrain[(h - y0) * stride] = index;
+				hit_cell[(h - y0) * stride] = cell;
+			}
+		}
+
+		s = s_out;
+
+		if (next_x <= next_y) {
+			gx += step_x;
+			next_x += delta_x;
+		}
+		else {
+			gy += step_y;
+			next_y += delta_y;
+		}
+
+		if (gx < 0 || gy < 0 || gx >= terrain.width || gy >= terrain.height) {
+			break;
+		}
+	}
+}
+
+bool SplatTerrains(
+	const Orthographic &ortho,
+	const std::vector<struct Terrain> &terrains,
+	int width,
+	int height,
+	int y0,
+	int rows,
+	int *hit_terrain,
+	int *hit_cell,
+	double *depth)
+{
+	const glm::dvec3 look = ortho.look;
+	const glm::dvec3 row = ortho.plane_down / (double)(height - 1);
+
+	// Horizontal direction in which rows going up the screen move
+	const double up_length = std::sqrt(row.x * row.x + row.y * row.y);
+
+	// Rows going down the screen must start farther back and no higher
+	//  for the nearer cells to be the lower ones
+	if (look.z >= 0.0 || row.z > 0.0 || up_length == 0.0
+		|| look.x * -row.x + look.y * -row.y < 0.0)
+	{
+		return false;
+	}
+
+	struct PixelColumn col;
+	col.dir_x = -row.x / up_length;
+	col.dir_y = -row.y / up_length;
+	col.row = row;
+	col.row_s = -up_length;
+	col.look_s = look.x * col.dir_x + look.y * col.dir_y;
+	col.look_z = look.z;
+
+	#pragma omp parallel for schedule(dynamic) firstprivate(col)
+	for (int w = 0; w < width; ++w) {
+		col.top = ortho.upper_left
+			+ ((double)w / (width - 1)) * ortho.plane_right;
+
+		double *const column_depth = depth + (size_t)w * rows;
+
+		for (int r = 0; r < rows; ++r) {
+			hit_terrain[r * width + w] = -1;
+			column_depth[r] = HUGE_VAL;
+		}
+
+		for (size_t i = 0; i < terrains.size(); ++i) {
+			SplatTerrain(col, terrains[i], (int)i, y0, y0 + rows - 1,
+				column_depth, hit_terrain + w, hit_cell + w, width);
+		}
+	}
+
+	return true;
+}
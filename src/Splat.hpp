@@ -0,0 +1,33 @@
+#ifndef SPLAT_HPP
+#define SPLAT_HPP
+
+#include <vector>
+
+#include "Orthographic.hpp"
+#include "Terrain.hpp"
+
+// Find the grid cell of a terrain that each pixel
+//  of rows [y0, y0 + rows) of the orthographic view sees,
+//  without marching the pixels' rays.
+// All the rays of a column of pixels lie in one vertical plane,
+//  so the cells under the column are walked front to back
+//  and each cell's column of heights is projected onto the rows it covers,
+//  skipping the rows a nearer cell already covers.
+// For pixel (w, h), writes the index of the terrain seen (or -1)
+//  to hit_terrain[(h - y0) * width + w]
+//  and the index of its cell (gridx + gridy * terrain width) to hit_cell.
+// `depth` is scratch space for rows * width distances.
+// Returns false if the view is not looking down,
+//  in which case the nearer cells are not the lower ones on the screen.
+bool SplatTerrains(
+	const Orthographic &ortho,
+	const std::vector<struct Terrain> &terrains,
+	int width,
+	int height,
+	int y0,
+	int rows,
+	int *hit_terrain,
+	int *hit_cell,
+	double *depth);
+
+#endif
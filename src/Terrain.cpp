@@ -0,0 +1,291 @@
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+void SetTerrainBounds(
+	struct Terrain *terrain,
+	double x,
+	double y,
+	double min_height,
+	double max_height)
+{
+	terrain->c0 = glm::dvec3(x, y, min_height);
+	terrain->c1 = glm::dvec3(
+		x + terrain->width  * terrain->grid_width,
+		y - terrain->height * terrain->grid_width,
+		max_height
+	);
+}
+
+// Write to `rgba` the color of texel (x, y) of the terrain's colors
+static void Texel(
+	const struct Terrain &terrain,
+	int x,
+	int y,
+	unsigned char *rgba)
+{
+	if (terrain.colors != NULL) {
+		std::memcpy(rgba,
+			terrain.colors + ((size_t)y * terrain.color_width + x) * 4, 4);
+	}
+	else {
+		terrain.color_blocks->Texel(x, y, rgba);
+	}
+}
+
+void TerrainColor(
+	const struct Terrain &terrain,
+	double u,
+	double v,
+	bool bilinear,
+	unsigned char *rgba)
+{
+	const int cw = terrain.color_width;
+	const int ch = terrain.color_height;
+
+	// To color texels, whose centers are at +0.5
+	const double x = u * cw / terrain.width;
+	const double y = v * ch / terrain.height;
+
+	if (!bilinear) {
+		const int ix = std::min(std::max((int)std::floor(x), 0), cw - 1);
+		const int iy = std::min(std::max((int)std::floor(y), 0), ch - 1);
+
+		Texel(terrain, ix, iy, rgba);
+		return;
+	}
+
+	const double fx = x - 0.5 - std::floor(x - 0.5);
+	const double fy = y - 0.5 - std::floor(y - 0.5);
+	const int x0 = (int)std::floor(x - 0.5);
+	const int y0 = (int)std::floor(y - 0.5);
+
+	const int xs[2] = {
+		std::min(std::max(x0, 0), cw - 1),
+		std::min(std::max(x0 + 1, 0), cw - 1)
+	};
+	const int ys[2] = {
+		std::min(std::max(y0, 0), ch - 1),
+		std::min(std::max(y0 + 1, 0), ch - 1)
+	};
+	const double weights[4] = {
+		(1.0 - fx) * (1.0 - fy), fx * (1.0 - fy),
+		(1.0 - fx) * fy, fx * fy
+	};
+
+	double sum[3] = {0.0, 0.0, 0.0};
+	double opaque = 0.0;
+
+	for (int k = 0; k < 4; ++k) {
+		unsigned char texel[4];
+		Texel(terrain, xs[k % 2], ys[k / 2], texel);
+
+		// Transparent texels do not bleed their colors into opaque ones
+		if (texel[3] == 0) {
+			continue;
+		}
+
+		for (int c = 0; c < 3; ++c) {
+			sum[c] += weights[k] * texel[c];
+		}
+
+		opaque += weights[k];
+	}
+
+	if (opaque <= 0.5) {
+		std::memset(rgba, 0, 4);
+		return;
+	}
+
+	for (int c = 0; c < 3; ++c) {
+		rgba[c] = (unsigned char)(sum[c] / opaque + 0.5);
+	}
+
+	rgba[3] = 255;
+}
+
+bool MarchTerrain(
+	const struct Terrain &terrain,
+	struct Ray ray,
+	double entry,
+	const struct MarchParams &march,
+	double max_t,
+	struct TerrainHit *hit)
+{
+	long long skipped = 0;
+	long long steps = 0;
+
+	return MarchTerrain(terrain, ray, entry, entry, march, max_t, hit,
+		&skipped, &steps);
+}
+
+// Write to `*gridx` and `*gridy` the cell under `point` the way
+//  the fixed steps find it. Returns false if it is off the grid.
+static bool GridCell(
+	const struct Terrain &terrain,
+	const glm::dvec3 &point,
+	int *gridx,
+	int *gridy)
+{
+	*gridx = (int)( (point.x - terrain.c0.x) / terrain.grid_width);
+	*gridy = (int)(-(point.y - terrain.c0.y) / terrain.grid_width);
+
+	return *gridx >= 0 && *gridy >= 0
+		&& *gridx < terrain.width
+		&& *gridy < terrain.height;
+}
+
+static bool MarchAdaptive(
+	const struct Terrain &terrain,
+	struct Ray ray,
+	double entry,
+	double start,
+	const struct MarchParams &march,
+	double max_t,
+	struct TerrainHit *hit,
+	long long *skipped,
+	long long *steps)
+{
+	double t = entry + terrain.grid_width * 0.01;
+
+	if (start > t) {
+		*skipped += (long long)((start - t) / march.step_dist);
+		t = start;
+	}
+
+	const double step_min = march.step_min > 0.0
+		? march.step_min : 0.5 * terrain.grid_width;
+
+	// Where the ray was last seen above the surface
+	double above = t;
+	long long taken = 0;
+
+	while (t < max_t) {
+		const glm::dvec3 point = ray.pos + t * ray.dir;
+		int gridx;
+		int gridy;
+
+		if (!GridCell(terrain, point, &gridx, &gridy)) {
+			*steps += taken;
+			return false;
+		}
+
+		taken += 1;
+
+		if (point.z >= terrain.heights[gridx + gridy * terrain.width]
+			+ terrain.c0.z)
+		{
+			above = t;
+			t += step_min + march.step_growth * t;
+			continue;
+		}
+
+		// The surface is crossed somewhere in (above, t]
+		for (int i = 0; i < march.refine_iters; ++i) {
+			const double mid = 0.5 * (above + t);
+			int mid_x;
+			int mid_y;
+
+			taken += 1;
+
+			if (GridCell(terrain, ray.pos + mid * ray.dir, &mid_x, &mid_y)
+				&& (ray.pos.z + mid * ray.dir.z)
+					< terrain.heights[mid_x + mid_y * terrain.width]
+						+ terrain.c0.z)
+			{
+				t = mid;
+				gridx = mid_x;
+				gridy = mid_y;
+			}
+			else {
+				above = mid;
+			}
+		}
+
+		hit->t = t;
+		hit->gridx = gridx;
+		hit->gridy = gridy;
+
+		*steps += taken;
+		return true;
+	}
+
+	*steps += taken;
+	return false;
+}
+
+bool MarchTerrain(
+	const struct Terrain &terrain,
+	struct Ray ray,
+	double entry,
+	double start,
+	const struct MarchParams &march,
+	double max_t,
+	struct TerrainHit *hit,
+	long long *skipped,
+	long long *steps)
+{
+	if (march.adaptive) {
+		return MarchAdaptive(terrain, ray, entry, start, march, max_t, hit,
+			skipped, steps);
+	}
+
+	const double step_dist = march.step_dist;
+	const double grid_width = terrain.grid_width;
+	const glm::dvec3 c0 = terrain.c0;
+
+	glm::dvec3 point(
+		ray.pos.x + entry * ray.dir.x,
+		ray.pos.y + entry * ray.dir.y,
+		ray.pos.z + entry * ray.dir.z
+	);
+
+	point += grid_width * 0.01 * ray.dir;
+	double t = entry + grid_width * 0.01;
+
+	if (start > t) {
+		const double steps = std::floor((start - t) / step_dist);
+
+		point += (steps * step_dist) * ray.dir;
+		t += steps * step_dist;
+		*skipped += (long long)steps;
+	}
+
+	// Counted locally so that it can stay in a register
+	long long taken = 0;
+
+	while (t < max_t) {
+		const int gridx = (int)( (point.x - c0.x) / grid_width);
+		const int gridy = (int)(-(point.y - c0.y) / grid_width);
+
+		if (gridx < 0 || gridy < 0
+			|| gridx >= terrain.width
+			|| gridy >= terrain.height)
+		{
+			*steps += taken;
+			return false;
+		}
+
+		taken += 1;
+
+		const double heightmap_z =
+			terrain.heights[gridx + gridy * terrain.width];
+
+		if (point.z < heightmap_z + c0.z) {
+			hit->t = t;
+			hit->gridx = gridx;
+			hit->gridy = gridy;
+
+			*steps += taken;
+			return true;
+		}
+
+		point += step_dist * ray.dir;
+		t += step_dist;
+	}
+
+	*steps += taken;
+	return false;
+}
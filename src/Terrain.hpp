@@ -0,0 +1,114 @@
+#ifndef TERRAIN_HPP
+#define TERRAIN_HPP
+
+#include "glm/glm.hpp"
+
+#include "ColorBlocks.hpp"
+#include "Light.hpp"
+#include "MaxMip.hpp"
+#include "Ray.hpp"
+
+// A heightmap placed in world space.
+// Grid x increases along the positive x axis from c0
+//  and grid y increases along the negative y axis from c0.
+struct Terrain {
+	// Array of heights in range [min_height, max_height]
+	const double *heights;
+	// Array of RGBA unsigned char values covering the same area
+	//  as the heights at a resolution of its own,
+	//  or NULL if they are only kept compressed in `color_blocks`
+	const unsigned char *colors;
+	const ColorBlocks *color_blocks;
+	// Max mip of the heights, built along with them
+	const MaxMip *mip;
+	// Light baked from the heights, if lighting was on when they were loaded.
+	// Empty until baked.
+	TerrainLight *light;
+	int width;
+	int height;
+	int color_width;
+	int color_height;
+
+	// World space grid square size
+	double grid_width;
+
+	// Upper left bottom corner
+	glm::dvec3 c0;
+	// Lower right top corner
+	glm::dvec3 c1;
+};
+
+// Where a ray marched into a Terrain
+struct TerrainHit {
+	// Distance along the ray
+	double t;
+	int gridx;
+	int gridy;
+};
+
+// How MarchTerrain steps along a ray
+struct MarchParams {
+	// Length of each step, unless `adaptive`
+	double step_dist;
+
+	// Whether steps are step_min + step_growth * (distance along the ray),
+	//  and the point where a step crosses the surface is then refined
+	//  with `refine_iters` bisections between it and the step before
+	bool adaptive;
+	// Half the terrain's grid width if 0
+	double step_min;
+	double step_growth;
+	int refine_iters;
+};
+
+// Set `c0` and `c1` of the terrain
+//  with its upper left corner at (x, y)
+//  and its heights in range [min_height, max_height].
+// `width`, `height` and `grid_width` must already be set.
+void SetTerrainBounds(
+	struct Terrain *terrain,
+	double x,
+	double y,
+	double min_height,
+	double max_height);
+
+// Write to `rgba` the color of the terrain at grid coordinates (u, v),
+//  where cell (gridx, gridy) covers [gridx, gridx + 1) x [gridy, gridy + 1).
+// With `bilinear`, the four nearest colors are blended,
+//  and the result is transparent (alpha 0)
+//  if most of the weight is on transparent ones.
+void TerrainColor(
+	const struct Terrain &terrain,
+	double u,
+	double v,
+	bool bilinear,
+	unsigned char *rgba);
+
+// March the ray from distance `entry` (where it enters the terrain's box)
+//  until it goes below the surface, leaves the grid,
+//  or reaches distance `max_t`.
+bool MarchTerrain(
+	const struct Terrain &terrain,
+	struct Ray ray,
+	double entry,
+	const struct MarchParams &march,
+	double max_t,
+	struct TerrainHit *hit);
+
+// Same as above but skip the steps before distance `start`
+//  (where the ray is known to be above the surface),
+//  still sampling the same points as from `entry` unless adaptive.
+// Adds the number of steps of step_dist skipped to `*skipped`
+//  and the number of samples taken to `*steps`.
+bool MarchTerrain(
+	const struct Terrain &terrain,
+	struct Ray ray,
+	double entry,
+	double start,
+	const struct MarchParams &march,
+	double max_t,
+	struct TerrainHit *hit,
+	long long *skipped,
+	long long *steps);
+
+#endif